@@ -0,0 +1,958 @@
+/*********************************************************************************************************
+〇 線分レンダリングのベンチマーク（ウィンドウ無し）
+renderLine / renderLineAA / renderDecayLine / renderLineWu / renderDecayLineWu / renderPolyline を s3d::Image に対して計測し、結果をJSONで書き出す。
+System::Update()を呼ばないので、ウィンドウは表示されない（マウス操作も不要）。
+結果は kotsubu_bench.json（実行時のカレントディレクトリ）に書き出し、バージョン間の比較に使う。
+
+・計測する項目
+線分の長さの分布（短い, 中くらい, 長い, 指数分布）, 向き（8方向の各象限）, AA部分の割合, 減衰区間の割合,
+色の型（ColorF版とColor版）, バッチ描画（renderLines, renderLinesParallel）,
+つながった線分（trace。線分ごとのrenderDecayLineと、renderPolylineの比較）
+
+・出力する値
+Mpixels/s（線分本体の点の数 / 時間）, ns/line, キャッシュミス数（Linuxでperf_eventが使えるときだけ。他はnull）
+
+・差分テスト（計測の前に行い、kotsubu_diff.json に書き出す）
+同じ線分をいろいろな描き方で描き、イメージを比べる。基準は2つ。
+  最初の版 --- 最初の版のMain.cppの renderLine / renderLineAA / renderDecayLine を写したもの（bench/kotsubu_baseline.h。固定）。
+              上書きしかないので、線分を上書きにしてから、ColorF版と整数版（Color版）を比べる
+  整数版   --- Color版の renderLine / renderLineAA / renderDecayLine を線分ごとに呼んだ結果。FixedPoint版, renderLines,
+              renderLinesParallel, 疎なボード, KotsubuCommandBuffer, KotsubuGpuLineRendererを、すべての合成の方式で比べる
+許容範囲は比べ方ごとに決めてある（"tolerance"）。
+  exact      --- すべてのチャンネルが同じ（整数版同士と、減衰の無い項目）
+  decayAlpha --- rgbは同じで、アルファの差が1以内（減衰のある項目の、最初の版・ColorF版と整数版の比較。上書きだけ。
+                 減衰のアルファを、ColorF版は小数で、整数版は16.16固定小数点で求めるので、四捨五入がずれることがある）
+  report     --- 数えるだけで合否に含めない（減衰のある項目の、合成する線分を含むColorF版と整数版の比較。
+                 アルファの1の差が合成で色にも広がるので、差は1より大きくなる。上書きにした比較で確かめている）
+線分は8方向の各象限の乱数と、端の場合（減衰の分割点の境目, イメージの外を通る線分, 長さ0～2, 重なる線分）。
+項目ごとに、許容範囲を超えた点と違う点の数、最初に超えた点、ns/line、ColorF版に対する速さの比を描き方ごとに並べる
+（"passed"が全体の合否。reportの比較は含めない）。
+KotsubuGpuLineRendererは、シェーダ（shader/）を読み込めなければCPUで描く（"gpu": false。そのときはCPU同士の比較になる）
+***********************************************************************************************************/
+
+#include <Siv3D.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include "../kotsubu_line_renderer.h"
+#include "../kotsubu_polyline_renderer.h"
+#include "../kotsubu_tile_renderer.h"
+#include "../kotsubu_command_buffer.h"
+#include "../kotsubu_gpu_line_renderer.h"
+#include "kotsubu_baseline.h"
+
+#if defined(__linux__)
+#   include <linux/perf_event.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+
+
+namespace
+{
+    // 【定数】計測の設定
+    constexpr s3d::int32  BenchWidth    = 1024;   // 描画先イメージの大きさ
+    constexpr s3d::int32  BenchHeight   = 768;
+    constexpr size_t      LinesPerCase  = 20000;  // 1回の計測で描く線分の数
+    constexpr double      MinCaseTimeMs = 200.0;  // 1つの項目の最低計測時間（これを超えるまで繰り返す）
+    constexpr s3d::uint32 RandomSeed    = 12345;  // 線分の生成に使う乱数の種（毎回同じ線分になる）
+    const char* const     ResultPath    = "kotsubu_bench.json";
+
+
+
+    // 【型】線分の長さの分布
+    enum class LengthDist { Short, Medium, Long, Exponential };
+
+    const char* toString(LengthDist dist)
+    {
+        switch (dist) {
+        case LengthDist::Short:  return "short";
+        case LengthDist::Medium: return "medium";
+        case LengthDist::Long:   return "long";
+        default:                 return "exponential";
+        }
+    }
+
+
+
+    // 【型】描き方
+    enum class Renderer { Line, LineAA, DecayLine, LineWu, DecayLineWu, Batch, Parallel, Polyline };
+
+    const char* toString(Renderer renderer)
+    {
+        switch (renderer) {
+        case Renderer::Line:        return "renderLine";
+        case Renderer::LineAA:      return "renderLineAA";
+        case Renderer::DecayLine:   return "renderDecayLine";
+        case Renderer::LineWu:      return "renderLineWu";
+        case Renderer::DecayLineWu: return "renderDecayLineWu";
+        case Renderer::Batch:       return "renderLines";
+        case Renderer::Polyline:    return "renderPolyline";
+        default:                    return "renderLinesParallel";
+        }
+    }
+
+
+
+    // 【型】計測する項目
+    struct BenchCase
+    {
+        Renderer   renderer;
+        bool       colorF;        // ColorF版（基準の実装）ならtrue
+        LengthDist lengthDist;
+        s3d::int32 octant;        // 0～7なら向きをその象限に限る。-1なら全方向
+        double     aaColorRate;
+        double     decaySectionRate;
+        bool       trace = false;  // 線分の始点を前の線分の終点にする（つながった線分。入らなければ新しく始める）
+    };
+
+
+
+    // 【型】計測結果
+    struct BenchResult
+    {
+        double     mpixelsPerSec;
+        double     nsPerLine;
+        double     cacheMissesPerLine;  // 負なら計測できなかった
+        size_t     repeats;
+    };
+
+
+
+    // 【クラス】キャッシュミス数の計測（Linuxのperf_event。使えない環境では常に無効）
+    class CacheMissCounter
+    {
+    public:
+        CacheMissCounter()
+        {
+#if defined(__linux__)
+            perf_event_attr attr{};
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.size           = sizeof(attr);
+            attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled       = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            mFd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+
+        ~CacheMissCounter()
+        {
+#if defined(__linux__)
+            if (mFd >= 0) close(mFd);
+#endif
+        }
+
+        CacheMissCounter(const CacheMissCounter&)            = delete;
+        CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+        bool available() const { return mFd >= 0; }
+
+        void start()
+        {
+#if defined(__linux__)
+            if (mFd < 0) return;
+            ioctl(mFd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(mFd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+        }
+
+        // 開始からのキャッシュミス数。使えなければ0
+        s3d::uint64 stop()
+        {
+            s3d::uint64 count = 0;
+#if defined(__linux__)
+            if (mFd < 0) return 0;
+            ioctl(mFd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(mFd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) count = 0;
+#endif
+            return count;
+        }
+
+    private:
+        int mFd = -1;
+    };
+
+
+
+    // 【関数】長さを1つ選ぶ
+    double pickLength(LengthDist dist, std::mt19937& rng)
+    {
+        switch (dist) {
+        case LengthDist::Short:  return std::uniform_real_distribution<double>(2.0, 8.0)(rng);
+        case LengthDist::Medium: return std::uniform_real_distribution<double>(16.0, 64.0)(rng);
+        case LengthDist::Long:   return std::uniform_real_distribution<double>(200.0, 600.0)(rng);
+        default:                 return 1.0 + std::exponential_distribution<double>(1.0 / 48.0)(rng);
+        }
+    }
+
+
+
+    // 【関数】計測する線分を作る（イメージの範囲に収まるように始点を選ぶ）
+    s3d::Array<LineSegment> makeSegments(const BenchCase& bc, s3d::uint64& mainPixels)
+    {
+        std::mt19937 rng(RandomSeed);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        const double pi = 3.14159265358979323846;
+
+        s3d::Array<LineSegment> segments;
+        segments.reserve(LinesPerCase);
+        mainPixels = 0;
+        s3d::Point prevEnd(-1, -1);
+        for (size_t i = 0; i < LinesPerCase; ++i) {
+            const double octant = (bc.octant < 0) ? unit(rng) * 8.0 : (bc.octant + unit(rng));
+            const double angle  = octant * pi / 4.0;
+            const double len    = std::min(pickLength(bc.lengthDist, rng), BenchHeight - 1.0);
+            const s3d::int32 dx = static_cast<s3d::int32>(std::lround(std::cos(angle) * len));
+            const s3d::int32 dy = static_cast<s3d::int32>(std::lround(std::sin(angle) * len));
+
+            const s3d::int32 x0 = std::max(0, -dx), x1 = BenchWidth  - 1 - std::max(0, dx);
+            const s3d::int32 y0 = std::max(0, -dy), y1 = BenchHeight - 1 - std::max(0, dy);
+            s3d::Point start(std::uniform_int_distribution<s3d::int32>(x0, x1)(rng),
+                             std::uniform_int_distribution<s3d::int32>(y0, y1)(rng));
+            if (bc.trace && prevEnd.x >= x0 && prevEnd.x <= x1 && prevEnd.y >= y0 && prevEnd.y <= y1) start = prevEnd;
+            prevEnd = start + s3d::Point(dx, dy);
+
+            LineSegment seg;
+            seg.startPos         = start;
+            seg.endPos           = start + s3d::Point(dx, dy);
+            seg.col              = s3d::ColorF(0.4, 0.8, 1.0, 1.0);
+            seg.mode             = (bc.renderer == Renderer::Line)        ? LineMode::Line
+                                 : (bc.renderer == Renderer::LineAA)      ? LineMode::AA
+                                 : (bc.renderer == Renderer::LineWu)      ? LineMode::Wu
+                                 : (bc.renderer == Renderer::DecayLineWu) ? LineMode::WuDecay : LineMode::Decay;
+            seg.aaColorRate      = bc.aaColorRate;
+            seg.decaySectionRate = bc.decaySectionRate;
+            segments << seg;
+
+            mainPixels += std::max(std::abs(dx), std::abs(dy)) + 1;
+        }
+        return segments;
+    }
+
+
+
+    // 【関数】線分をすべて描く（1回分）
+    void renderAll(const BenchCase& bc, s3d::Image& img, const s3d::Array<LineSegment>& segments)
+    {
+        if (bc.renderer == Renderer::Batch)    { renderLines(img, segments);         return; }
+        if (bc.renderer == Renderer::Parallel) { renderLinesParallel(img, segments); return; }
+        if (bc.renderer == Renderer::Polyline) {
+            // つながっている線分ごとに1本の折れ線にする
+            static s3d::Array<s3d::Point> points;
+            for (size_t i = 0; i < segments.size(); ) {
+                points.clear();
+                points << segments[i].startPos.asPoint();
+                do { points << segments[i].endPos.asPoint(); ++i; }
+                while (i < segments.size() && segments[i].startPos == segments[i - 1].endPos);
+                renderPolyline(img, points, s3d::Color(segments[0].col), 1, LineJoin::Miter, segments[0].decaySectionRate);
+            }
+            return;
+        }
+
+        for (const auto& seg : segments) {
+            if (bc.colorF) {
+                switch (bc.renderer) {
+                case Renderer::Line:   renderLine(img, seg.startPos.asPoint(), seg.endPos.asPoint(), seg.col); break;
+                case Renderer::LineAA: renderLineAA(img, seg.startPos.asPoint(), seg.endPos.asPoint(), seg.col, seg.aaColorRate); break;
+                case Renderer::LineWu: renderLineWu(img, seg.startPos.asPoint(), seg.endPos.asPoint(), seg.col); break;
+                case Renderer::DecayLineWu: renderDecayLineWu(img, seg.startPos.asPoint(), seg.endPos.asPoint(), seg.col, seg.decaySectionRate); break;
+                default: renderDecayLine(img, seg.startPos.asPoint(), seg.endPos.asPoint(), seg.col, seg.decaySectionRate, seg.aaColorRate);
+                }
+            }
+            else {
+                const s3d::Color col(seg.col);
+                switch (bc.renderer) {
+                case Renderer::Line:   renderLine(img, seg.startPos.asPoint(), seg.endPos.asPoint(), col); break;
+                case Renderer::LineAA: renderLineAA(img, seg.startPos.asPoint(), seg.endPos.asPoint(), col, seg.aaColorRate); break;
+                case Renderer::LineWu: renderLineWu(img, seg.startPos.asPoint(), seg.endPos.asPoint(), col); break;
+                case Renderer::DecayLineWu: renderDecayLineWu(img, seg.startPos.asPoint(), seg.endPos.asPoint(), col, seg.decaySectionRate); break;
+                default: renderDecayLine(img, seg.startPos.asPoint(), seg.endPos.asPoint(), col, seg.decaySectionRate, seg.aaColorRate);
+                }
+            }
+        }
+    }
+
+
+
+    // 【関数】1つの項目を計測する（慣らしに1回描いてから、最低計測時間を超えるまで繰り返す）
+    BenchResult runCase(const BenchCase& bc, s3d::Image& img, CacheMissCounter& counter)
+    {
+        s3d::uint64 mainPixels;
+        const s3d::Array<LineSegment> segments = makeSegments(bc, mainPixels);
+        renderAll(bc, img, segments);
+
+        using Clock = std::chrono::steady_clock;
+        size_t repeats = 0;
+        double elapsedMs = 0.0;
+        s3d::uint64 misses = 0;
+        while (elapsedMs < MinCaseTimeMs) {
+            counter.start();
+            const auto t0 = Clock::now();
+            renderAll(bc, img, segments);
+            const auto t1 = Clock::now();
+            misses    += counter.stop();
+            elapsedMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            ++repeats;
+        }
+
+        const double lines = static_cast<double>(segments.size()) * repeats;
+        BenchResult r;
+        r.mpixelsPerSec      = static_cast<double>(mainPixels) * repeats / (elapsedMs * 1000.0);
+        r.nsPerLine          = elapsedMs * 1.0e6 / lines;
+        r.cacheMissesPerLine = counter.available() ? static_cast<double>(misses) / lines : -1.0;
+        r.repeats            = repeats;
+        return r;
+    }
+
+
+
+    // 【関数】計測する項目の一覧
+    s3d::Array<BenchCase> makeCases()
+    {
+        s3d::Array<BenchCase> cases;
+        const LengthDist dists[] = { LengthDist::Short, LengthDist::Medium, LengthDist::Long, LengthDist::Exponential };
+
+        // 長さの分布ごと（すべての描き方, 両方の色の型）
+        for (const LengthDist dist : dists) {
+            for (const bool colorF : { true, false }) {
+                cases << BenchCase{ Renderer::Line,        colorF, dist, -1, 0.3, 0.5 };
+                cases << BenchCase{ Renderer::LineAA,      colorF, dist, -1, 0.3, 0.5 };
+                cases << BenchCase{ Renderer::DecayLine,   colorF, dist, -1, 0.3, 0.5 };
+                cases << BenchCase{ Renderer::LineWu,      colorF, dist, -1, 0.3, 0.5 };
+                cases << BenchCase{ Renderer::DecayLineWu, colorF, dist, -1, 0.3, 0.5 };
+            }
+        }
+
+        // 向きごと（x基準とy基準、進む方向の違い）
+        for (s3d::int32 octant = 0; octant < 8; ++octant) {
+            cases << BenchCase{ Renderer::LineAA,    false, LengthDist::Medium, octant, 0.3, 0.5 };
+            cases << BenchCase{ Renderer::DecayLine, false, LengthDist::Medium, octant, 0.3, 0.5 };
+        }
+
+        // AA部分の割合と減衰区間の割合
+        for (const double rate : { 0.0, 0.3, 1.0 })
+            cases << BenchCase{ Renderer::LineAA, false, LengthDist::Medium, -1, rate, 0.5 };
+        for (const double rate : { 0.0, 0.5, 1.0 })
+            cases << BenchCase{ Renderer::DecayLine, false, LengthDist::Medium, -1, 0.3, rate };
+
+        // バッチ描画（Decayで比較）
+        for (const LengthDist dist : dists) {
+            cases << BenchCase{ Renderer::Batch,    false, dist, -1, 0.3, 0.5 };
+            cases << BenchCase{ Renderer::Parallel, false, dist, -1, 0.3, 0.5 };
+        }
+
+        // つながった線分（線分ごとの減衰と、折れ線全体での減衰）
+        for (const LengthDist dist : { LengthDist::Short, LengthDist::Medium }) {
+            cases << BenchCase{ Renderer::DecayLine, false, dist, -1, 0.3, 0.5, true };
+            cases << BenchCase{ Renderer::Polyline,  false, dist, -1, 0.3, 0.5, true };
+        }
+        return cases;
+    }
+
+
+
+    // 【関数】数値をJSONの値にする（負ならnull）
+    std::string jsonNumber(double value)
+    {
+        if (value < 0.0) return "null";
+        std::ostringstream os;
+        os.precision(6);
+        os << value;
+        return os.str();
+    }
+
+
+
+    // ◎◎ 差分テスト（速い描き方が、基準と同じ点を描くかの確認と、速さの比較）
+    // 基準は、最初の版の実装（上書きだけ）と、整数版（Color版）を線分ごとに呼んだ結果。
+    // 比べ方（DiffChecks）ごとに同じ線分を描いてイメージを比べ、許容範囲を超えた点の数と最初の点、ColorF版に対する速さの比を書き出す。
+    // 組ごとに並べ替える描き方（renderLines, renderLinesParallel）は、基準も同じ順番（安定な並べ替え）で描いて比べる
+
+    // 【定数】差分テストの設定（イメージはタイルの大きさの倍数にしない。端のタイルも確かめるため）
+    constexpr s3d::int32  DiffWidth     = 300;
+    constexpr s3d::int32  DiffHeight    = 200;
+    constexpr size_t      DiffLines     = 2000;   // 乱数の項目の線分の数
+    constexpr double      DiffMinTimeMs = 20.0;   // 1つの項目の、描き方ごとの最低計測時間
+    constexpr s3d::uint32 DiffSeed      = 2024;
+    const char* const     DiffResultPath = "kotsubu_diff.json";
+
+
+
+    // 【型】描き方
+    // Baselineは最初の版の実装（上書きだけ）、ReferenceはColorF版、Colorは整数版の基準
+    enum class Backend { Baseline, Reference, Color, FixedPoint, Batch, Parallel, Sparse, CommandBuffer, Gpu };
+
+    const char* toString(Backend backend)
+    {
+        switch (backend) {
+        case Backend::Baseline:      return "baseline";
+        case Backend::Reference:     return "ColorF";
+        case Backend::Color:         return "Color";
+        case Backend::FixedPoint:    return "FixedPoint";
+        case Backend::Batch:         return "renderLines";
+        case Backend::Parallel:      return "renderLinesParallel";
+        case Backend::Sparse:        return "sparseBoard";
+        case Backend::CommandBuffer: return "KotsubuCommandBuffer";
+        default:                     return "KotsubuGpuLineRenderer";
+        }
+    }
+
+    // 組ごとに並べ替えてから描くか
+    bool isBucketed(Backend backend)
+    {
+        return (backend == Backend::Batch) || (backend == Backend::Parallel);
+    }
+
+
+
+    // 【型】比べ方。backendで描いたイメージを、againstで描いたイメージと比べる
+    // overwriteなら、線分をすべて上書きにしてから描く（最初の版には合成の方式が無い）
+    struct DiffCheck
+    {
+        Backend backend;
+        Backend against;
+        bool    overwrite;
+    };
+
+    constexpr DiffCheck DiffChecks[] = {
+        { Backend::Reference,     Backend::Baseline, true  },
+        { Backend::Color,         Backend::Baseline, true  },
+        { Backend::Reference,     Backend::Color,    false },
+        { Backend::FixedPoint,    Backend::Color,    false },
+        { Backend::Batch,         Backend::Color,    false },
+        { Backend::Parallel,      Backend::Color,    false },
+        { Backend::Sparse,        Backend::Color,    false },
+        { Backend::CommandBuffer, Backend::Color,    false },
+        { Backend::Gpu,           Backend::Color,    false },
+    };
+
+
+
+    // 【型】許容範囲（ファイルの先頭の説明を参照）
+    enum class Tolerance { Exact, DecayAlpha, Report };
+
+    const char* toString(Tolerance tolerance)
+    {
+        switch (tolerance) {
+        case Tolerance::Exact:      return "exact";
+        case Tolerance::DecayAlpha: return "decayAlpha";
+        default:                    return "report";
+        }
+    }
+
+
+
+    // 【型】差分テストの1項目
+    struct DiffCase
+    {
+        std::string             name;
+        s3d::Array<LineSegment> segments;
+    };
+
+
+
+    // 【関数】項目と比べ方の許容範囲
+    // 整数版同士はexact。最初の版やColorF版と整数版の比較は、減衰する線分が無ければexact、
+    // あれば上書きだけならdecayAlpha、合成する線分を含めばreport
+    Tolerance toleranceOf(const DiffCase& dc, const DiffCheck& check)
+    {
+        const bool floating = (check.backend == Backend::Reference) || (check.against == Backend::Baseline);
+        if (!floating) return Tolerance::Exact;
+        const bool decay = std::any_of(dc.segments.begin(), dc.segments.end(),
+                                       [](const LineSegment& s) { return s.mode == LineMode::Decay; });
+        if (!decay) return Tolerance::Exact;
+        const bool blended = !check.overwrite && std::any_of(dc.segments.begin(), dc.segments.end(),
+                                                             [](const LineSegment& s) { return s.blend != BlendMode::Overwrite; });
+        return blended ? Tolerance::Report : Tolerance::DecayAlpha;
+    }
+
+
+
+    // 【型】描き方ごとの作業領域（ボードは項目をまたいで使い回す）
+    struct DiffContext
+    {
+        s3d::Image                              img{ DiffWidth, DiffHeight };
+        s3d::Image                              padded;  // 最初の版を描くイメージ（クリップしないので、線分がはみ出さない大きさ）
+        KotsubuPixelBoard                       sparse{ DiffWidth, DiffHeight };
+        KotsubuPixelBoard                       dense{ DiffWidth, DiffHeight };
+        KotsubuPixelBoard                       gpuBoard{ DiffWidth, DiffHeight };
+        std::unique_ptr<KotsubuGpuLineRenderer> gpu;
+
+        DiffContext()
+        {
+            sparse.setStorage(KotsubuPixelBoard::Storage::Sparse);
+            gpu = std::make_unique<KotsubuGpuLineRenderer>(gpuBoard);
+        }
+    };
+
+
+
+    // 【型】1つの比べ方の、1項目の結果
+    struct DiffResult
+    {
+        size_t     mismatches = 0;         // 許容範囲を超えて違う点の数
+        size_t     differing  = 0;         // 違う点の数（許容範囲の中も含む）
+        s3d::Point firstPos{ -1, -1 };     // 最初に許容範囲を超えた点（左上から行ごとに探す）
+        s3d::Color expected, actual;
+        s3d::int32 maxDelta   = 0;         // チャンネルごとの差の最大（減衰の丸めなら1。合成で広がると大きくなる）
+        double     nsPerLine  = 0.0;
+    };
+
+
+
+    // 【関数】乱数の色（ColorFにしても8bitの値が変わらないように、1/255単位にする）
+    s3d::ColorF randomColor(std::mt19937& rng)
+    {
+        std::uniform_int_distribution<s3d::int32> byte(0, 255);
+        const s3d::int32 a = (rng() % 4 == 0) ? 255 : byte(rng);
+        return s3d::ColorF(byte(rng) / 255.0, byte(rng) / 255.0, byte(rng) / 255.0, a / 255.0);
+    }
+
+
+
+    // 【関数】割合を1つ選ぶ（端の0と1を多めに）
+    double randomRate(std::mt19937& rng)
+    {
+        switch (rng() % 4) {
+        case 0:  return 0.0;
+        case 1:  return 1.0;
+        default: return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        }
+    }
+
+
+
+    // 【関数】線分を1本作る（合成の方式は4種類から選ぶ）
+    LineSegment makeDiffSegment(s3d::Point startPos, s3d::Point endPos, LineMode mode, std::mt19937& rng)
+    {
+        LineSegment seg;
+        seg.startPos         = startPos;
+        seg.endPos           = endPos;
+        seg.col              = randomColor(rng);
+        seg.mode             = mode;
+        seg.aaColorRate      = randomRate(rng);
+        seg.decaySectionRate = randomRate(rng);
+        seg.blend            = static_cast<BlendMode>(rng() % kotsubu_detail::BlendModeCount);
+        return seg;
+    }
+
+
+
+    // 【関数】差分テストの項目の一覧
+    // ・向き（8方向の各象限）× 種類（Line, AA, Decay）ごとの乱数の線分（一部はイメージからはみ出す）
+    // ・減衰の分割点の境目（減衰区間の長さがちょうど整数になる割合と、その前後。0と1）
+    // ・イメージの外を通る線分と、端に沿う線分
+    // ・長さ0～2の線分、水平、垂直、ちょうど45度の線分
+    // ・1点から放射状に重なる線分（重なる点を書く順番の確認）
+    s3d::Array<DiffCase> makeDiffCases()
+    {
+        std::mt19937 rng(DiffSeed);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        const double pi = 3.14159265358979323846;
+        const LineMode modes[] = { LineMode::Line, LineMode::AA, LineMode::Decay };
+        const char* const modeNames[] = { "Line", "AA", "Decay" };
+        auto randomPoint = [&](s3d::int32 margin) {
+            return s3d::Point(std::uniform_int_distribution<s3d::int32>(-margin, DiffWidth  - 1 + margin)(rng),
+                              std::uniform_int_distribution<s3d::int32>(-margin, DiffHeight - 1 + margin)(rng));
+        };
+        auto randomMode = [&] { return modes[rng() % 3]; };
+
+        s3d::Array<DiffCase> cases;
+        for (s3d::int32 octant = 0; octant < 8; ++octant) {
+            for (size_t m = 0; m < 3; ++m) {
+                DiffCase dc{ "octant" + std::to_string(octant) + "/" + modeNames[m], {} };
+                for (size_t i = 0; i < DiffLines; ++i) {
+                    const double angle = (octant + unit(rng)) * pi / 4.0;
+                    const double len   = std::min(1.0 + std::exponential_distribution<double>(1.0 / 48.0)(rng), 600.0);
+                    const s3d::Point start = randomPoint(32);
+                    const s3d::Point end   = start + s3d::Point(static_cast<s3d::int32>(std::lround(std::cos(angle) * len)),
+                                                                static_cast<s3d::int32>(std::lround(std::sin(angle) * len)));
+                    dc.segments << makeDiffSegment(start, end, modes[m], rng);
+                }
+                cases << dc;
+            }
+        }
+
+        // 減衰の分割点の境目。底辺dに対して、減衰区間の長さがkになる割合k / dと、そのすぐ前後
+        {
+            DiffCase dc{ "decaySplit", {} };
+            for (s3d::int32 octant = 0; octant < 8; ++octant) {
+                for (s3d::int32 d = 1; d <= 24; ++d) {
+                    const s3d::int32 k   = static_cast<s3d::int32>(rng() % (d + 1));
+                    const s3d::int32 sub = static_cast<s3d::int32>(rng() % (d + 1));
+                    const s3d::int32 maj = ((octant & 1) ? -d : d), mnr = ((octant & 2) ? -sub : sub);
+                    const s3d::Point delta = (octant & 4) ? s3d::Point(mnr, maj) : s3d::Point(maj, mnr);
+                    for (const double rate : { k / static_cast<double>(d), std::nextafter(k / static_cast<double>(d), 0.0),
+                                               std::nextafter(k / static_cast<double>(d), 2.0), 0.0, 1.0 }) {
+                        const s3d::Point start = randomPoint(-2);
+                        LineSegment seg = makeDiffSegment(start, start + delta, LineMode::Decay, rng);
+                        seg.decaySectionRate = rate;
+                        dc.segments << seg;
+                    }
+                }
+            }
+            cases << dc;
+        }
+
+        // イメージの外を通る線分（端点が遠く離れたもの、角をかすめるもの）と、端に沿う線分
+        {
+            DiffCase dc{ "clipped", {} };
+            for (size_t i = 0; i < DiffLines / 2; ++i)
+                dc.segments << makeDiffSegment(randomPoint(DiffWidth * 4), randomPoint(DiffWidth * 4), randomMode(), rng);
+            const s3d::int32 r = DiffWidth - 1, b = DiffHeight - 1;
+            const s3d::Point edges[][2] = {
+                { { 0, 0 }, { r, 0 } }, { { r, b }, { 0, b } }, { { 0, b }, { 0, 0 } }, { { r, 0 }, { r, b } },
+                { { -1, -1 }, { r + 1, b + 1 } }, { { -40, 20 }, { 20, -40 } }, { { r - 20, b + 40 }, { r + 40, b - 20 } },
+                { { -1, 0 }, { r + 1, 0 } }, { { 0, -1 }, { 0, b + 1 } }, { { -300, b }, { r + 300, b } },
+            };
+            for (const auto& e : edges)
+                for (const LineMode mode : modes)
+                    dc.segments << makeDiffSegment(e[0], e[1], mode, rng) << makeDiffSegment(e[1], e[0], mode, rng);
+            cases << dc;
+        }
+
+        // 長さ0～2の線分、水平、垂直、ちょうど45度の線分（すべての向き）
+        {
+            DiffCase dc{ "degenerate", {} };
+            const s3d::Point dirs[] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+            for (size_t i = 0; i < DiffLines / 4; ++i) {
+                const s3d::Point start = randomPoint(2);
+                const s3d::int32 len   = (i % 2 == 0) ? static_cast<s3d::int32>(rng() % 3)
+                                                      : static_cast<s3d::int32>(rng() % 200);
+                dc.segments << makeDiffSegment(start, start + dirs[rng() % 8] * len, randomMode(), rng);
+            }
+            cases << dc;
+        }
+
+        // 1点から放射状に重なる線分（中心の点は、すべての線分の終点として合成される）
+        {
+            DiffCase dc{ "fan", {} };
+            const s3d::Point center(DiffWidth / 2, DiffHeight / 2);
+            for (size_t i = 0; i < 256; ++i) {
+                const double angle = 2.0 * pi * i / 256.0;
+                const s3d::Point end = center + s3d::Point(static_cast<s3d::int32>(std::lround(std::cos(angle) * 90.0)),
+                                                           static_cast<s3d::int32>(std::lround(std::sin(angle) * 90.0)));
+                dc.segments << makeDiffSegment(end, center, randomMode(), rng);
+            }
+            cases << dc;
+        }
+        return cases;
+    }
+
+
+
+    // 【関数】線分を組の番号順に安定に並べ替える（renderLines()が描く順番）
+    s3d::Array<LineSegment> sortByBucket(const s3d::Array<LineSegment>& segments)
+    {
+        s3d::Array<LineSegment> sorted = segments;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const LineSegment& a, const LineSegment& b) {
+            return kotsubu_detail::makeBatchEntry(a).bucket < kotsubu_detail::makeBatchEntry(b).bucket;
+        });
+        return sorted;
+    }
+
+
+
+    // 【関数】線分をすべて上書きにする（最初の版と比べるため）
+    s3d::Array<LineSegment> overwriteOnly(const s3d::Array<LineSegment>& segments)
+    {
+        s3d::Array<LineSegment> result = segments;
+        for (auto& s : result)
+            s.blend = BlendMode::Overwrite;
+        return result;
+    }
+
+
+
+    // 【関数】白紙から線分をすべて描き、結果のイメージを返す（1回分。白紙にするのと、結果を取り出すまでを含む）
+    const s3d::Image& renderBackend(Backend backend, DiffContext& ctx, const s3d::Array<LineSegment>& segments)
+    {
+        switch (backend) {
+        case Backend::Baseline: {
+            // 最初の版はクリップしないので、線分（と疑似AAの点）がはみ出さない大きさに広げて描き、元の範囲を切り出す。合成は無視する
+            s3d::int32 pad = 1;
+            for (const auto& s : segments) {
+                for (const s3d::Point p : { s.startPos.asPoint(), s.endPos.asPoint() })
+                    pad = std::max({ pad, 1 - p.x, 1 - p.y, p.x - DiffWidth + 2, p.y - DiffHeight + 2 });
+            }
+            const size_t width = static_cast<size_t>(DiffWidth + 2 * pad), height = static_cast<size_t>(DiffHeight + 2 * pad);
+            if (ctx.padded.width() != static_cast<s3d::int32>(width) || ctx.padded.height() != static_cast<s3d::int32>(height))
+                ctx.padded = s3d::Image(width, height);
+            ctx.padded.fill(s3d::Color(0, 0, 0, 0));
+
+            const s3d::Point offset(pad, pad);
+            for (const auto& s : segments) {
+                const s3d::Point p0 = s.startPos.asPoint() + offset, p1 = s.endPos.asPoint() + offset;
+                if      (s.mode == LineMode::Line) kotsubu_baseline::renderLine(ctx.padded, p0, p1, s.col);
+                else if (s.mode == LineMode::AA)   kotsubu_baseline::renderLineAA(ctx.padded, p0, p1, s.col, s.aaColorRate);
+                else kotsubu_baseline::renderDecayLine(ctx.padded, p0, p1, s.col, s.decaySectionRate, s.aaColorRate);
+            }
+            for (s3d::int32 y = 0; y < DiffHeight; ++y)
+                std::copy_n(ctx.padded[y + pad] + pad, DiffWidth, ctx.img[y]);
+            return ctx.img;
+        }
+
+        case Backend::Reference:
+            ctx.img.fill(s3d::Color(0, 0, 0, 0));
+            for (const auto& s : segments) {
+                const s3d::Point p0 = s.startPos.asPoint(), p1 = s.endPos.asPoint();
+                if      (s.mode == LineMode::Line) renderLine(ctx.img, p0, p1, s.col, s.blend);
+                else if (s.mode == LineMode::AA)   renderLineAA(ctx.img, p0, p1, s.col, s.aaColorRate, s.blend);
+                else renderDecayLine(ctx.img, p0, p1, s.col, s.decaySectionRate, s.aaColorRate, s.blend);
+            }
+            return ctx.img;
+
+        case Backend::Color:
+        case Backend::FixedPoint:
+            ctx.img.fill(s3d::Color(0, 0, 0, 0));
+            for (const auto& s : segments) {
+                const s3d::Color col(s.col);
+                if (backend == Backend::Color) {
+                    const s3d::Point p0 = s.startPos.asPoint(), p1 = s.endPos.asPoint();
+                    if      (s.mode == LineMode::Line) renderLine(ctx.img, p0, p1, col, s.blend);
+                    else if (s.mode == LineMode::AA)   renderLineAA(ctx.img, p0, p1, col, s.aaColorRate, s.blend);
+                    else renderDecayLine(ctx.img, p0, p1, col, s.decaySectionRate, s.aaColorRate, s.blend);
+                }
+                else {
+                    if      (s.mode == LineMode::Line) renderLine(ctx.img, s.startPos, s.endPos, col, s.blend);
+                    else if (s.mode == LineMode::AA)   renderLineAA(ctx.img, s.startPos, s.endPos, col, s.aaColorRate, s.blend);
+                    else renderDecayLine(ctx.img, s.startPos, s.endPos, col, s.decaySectionRate, s.aaColorRate, s.blend);
+                }
+            }
+            return ctx.img;
+
+        case Backend::Batch:
+        case Backend::Parallel:
+            ctx.img.fill(s3d::Color(0, 0, 0, 0));
+            if (backend == Backend::Batch) renderLines(ctx.img, segments);
+            else                           renderLinesParallel(ctx.img, segments);
+            return ctx.img;
+
+        case Backend::Sparse:
+            // 線分ごとに描く（renderLines()のボード版は組ごとに並べ替えるため）
+            ctx.sparse.clear();
+            for (const auto& s : segments)
+                renderLines(ctx.sparse, &s, 1);
+            ctx.sparse.mSparse.copyTo(s3d::Rect(0, 0, DiffWidth, DiffHeight), ctx.img, s3d::Point(0, 0));
+            return ctx.img;
+
+        case Backend::CommandBuffer: {
+            ctx.dense.clear();
+            KotsubuCommandBuffer commands(ctx.dense);
+            for (const auto& s : segments)
+                commands.line(s);
+            commands.flush();
+            return ctx.dense.mImg;
+        }
+
+        default:
+            ctx.gpu->clear();
+            ctx.gpu->lines(segments);
+            ctx.gpu->flush();
+            return ctx.gpu->readback();
+        }
+    }
+
+
+
+    // 【関数】最低計測時間を超えるまで繰り返し描き、1本あたりの時間を返す
+    double timeBackend(Backend backend, DiffContext& ctx, const s3d::Array<LineSegment>& segments)
+    {
+        using Clock = std::chrono::steady_clock;
+        size_t repeats = 0;
+        double elapsedMs = 0.0;
+        while (elapsedMs < DiffMinTimeMs) {
+            const auto t0 = Clock::now();
+            renderBackend(backend, ctx, segments);
+            const auto t1 = Clock::now();
+            elapsedMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            ++repeats;
+        }
+        return elapsedMs * 1.0e6 / (static_cast<double>(std::max<size_t>(segments.size(), 1)) * repeats);
+    }
+
+
+
+    // 【関数】2つのイメージを許容範囲で比べる
+    void compareImages(const s3d::Image& expected, const s3d::Image& actual, Tolerance tolerance, DiffResult& r)
+    {
+        for (s3d::int32 y = 0; y < DiffHeight; ++y) {
+            for (s3d::int32 x = 0; x < DiffWidth; ++x) {
+                const s3d::Color e = expected[y][x], a = actual[y][x];
+                if ((e.r == a.r) && (e.g == a.g) && (e.b == a.b) && (e.a == a.a)) continue;
+                ++r.differing;
+                for (const s3d::int32 d : { e.r - a.r, e.g - a.g, e.b - a.b, e.a - a.a })
+                    r.maxDelta = std::max(r.maxDelta, std::abs(d));
+                if ((tolerance == Tolerance::DecayAlpha) && (e.r == a.r) && (e.g == a.g) && (e.b == a.b) &&
+                    (std::abs(e.a - a.a) <= 1)) continue;
+                if (r.mismatches++ == 0) {
+                    r.firstPos = s3d::Point(x, y);
+                    r.expected = e;
+                    r.actual   = a;
+                }
+            }
+        }
+    }
+
+
+
+    // 【関数】色をJSONの配列にする
+    std::string jsonColor(const s3d::Color& col)
+    {
+        std::ostringstream os;
+        os << "[" << static_cast<int>(col.r) << ", " << static_cast<int>(col.g) << ", "
+           << static_cast<int>(col.b) << ", " << static_cast<int>(col.a) << "]";
+        return os.str();
+    }
+
+
+
+    // 【関数】差分テストをすべて行い、結果をJSONで書き出す。reportでない比べ方がすべて許容範囲に収まればtrue
+    // 項目ごとに比べ方を横に並べ（許容範囲, 超えた点と違う点の数, ns/line, ColorF版に対する速さの比）、最後に比べ方ごとの合計を書く
+    bool runDifferential()
+    {
+        DiffContext ctx;
+        const s3d::Array<DiffCase> cases = makeDiffCases();
+        constexpr size_t CheckCount = std::size(DiffChecks);
+        size_t totalMismatches[CheckCount] = {};
+        size_t reportedPixels[CheckCount]  = {};
+        size_t failedCases[CheckCount]     = {};
+        s3d::int32 maxDelta[CheckCount]    = {};
+        double totalNs[CheckCount]         = {};
+        double referenceNs = 0.0;
+        size_t totalLines  = 0;
+
+        std::ostringstream json;
+        json << "{\n"
+             << "  \"image\": { \"width\": " << DiffWidth << ", \"height\": " << DiffHeight << " },\n"
+             << "  \"seed\": " << DiffSeed << ",\n"
+             << "  \"threads\": " << (kotsubu_detail::workerPool().workerCount() + 1) << ",\n"
+             << "  \"gpu\": " << (ctx.gpu->usesGpu() ? "true" : "false") << ",\n"
+             << "  \"cases\": [\n";
+
+        for (size_t c = 0; c < cases.size(); ++c) {
+            const DiffCase& dc = cases[c];
+            const s3d::Array<LineSegment> overwritten = overwriteOnly(dc.segments);
+            const s3d::Array<LineSegment> bucketed    = sortByBucket(dc.segments);
+            const s3d::Image baseline       = renderBackend(Backend::Baseline, ctx, overwritten);
+            const s3d::Image expected       = renderBackend(Backend::Color, ctx, dc.segments);
+            const s3d::Image expectedBucket = renderBackend(Backend::Color, ctx, bucketed);
+            const double refNs = timeBackend(Backend::Reference, ctx, dc.segments);
+            const double lines = static_cast<double>(dc.segments.size());
+            referenceNs += refNs * lines;
+            totalLines  += dc.segments.size();
+
+            json << "    { \"name\": \"" << dc.name << "\", \"lines\": " << dc.segments.size()
+                 << ", \"referenceNsPerLine\": " << jsonNumber(refNs) << ", \"checks\": [\n";
+            for (size_t k = 0; k < CheckCount; ++k) {
+                const DiffCheck& check = DiffChecks[k];
+                const Tolerance tolerance = toleranceOf(dc, check);
+                const s3d::Array<LineSegment>& segments = check.overwrite ? overwritten : dc.segments;
+                const s3d::Image& against = (check.against == Backend::Baseline) ? baseline
+                                          : (isBucketed(check.backend) ? expectedBucket : expected);
+                DiffResult r;
+                compareImages(against, renderBackend(check.backend, ctx, segments), tolerance, r);
+                r.nsPerLine = timeBackend(check.backend, ctx, segments);
+                if (tolerance == Tolerance::Report) {
+                    reportedPixels[k] += r.differing;
+                }
+                else {
+                    totalMismatches[k] += r.mismatches;
+                    failedCases[k]     += (r.mismatches > 0) ? 1 : 0;
+                }
+                maxDelta[k] = std::max(maxDelta[k], r.maxDelta);
+                totalNs[k] += r.nsPerLine * lines;
+
+                json << "      { \"backend\": \"" << toString(check.backend) << "\""
+                     << ", \"against\": \"" << toString(check.against) << "\""
+                     << ", \"overwrite\": " << (check.overwrite ? "true" : "false")
+                     << ", \"tolerance\": \"" << toString(tolerance) << "\""
+                     << ", \"mismatches\": " << r.mismatches
+                     << ", \"differing\": " << r.differing
+                     << ", \"maxDelta\": " << r.maxDelta
+                     << ", \"nsPerLine\": " << jsonNumber(r.nsPerLine)
+                     << ", \"speedup\": " << jsonNumber(refNs / r.nsPerLine);
+                if (r.mismatches > 0) {
+                    json << ", \"firstMismatch\": { \"x\": " << r.firstPos.x << ", \"y\": " << r.firstPos.y
+                         << ", \"expected\": " << jsonColor(r.expected) << ", \"actual\": " << jsonColor(r.actual) << " }";
+                }
+                json << " }" << ((k + 1 < CheckCount) ? ",\n" : "\n");
+            }
+            json << "    ] }" << ((c + 1 < cases.size()) ? ",\n" : "\n");
+        }
+
+        // mismatchesとfailedCasesは合否に含める比べ方（exact, decayAlpha）だけ、reportedPixelsはreportの項目で違った点の数
+        bool passed = true;
+        json << "  ],\n"
+             << "  \"referenceNsPerLine\": " << jsonNumber(referenceNs / totalLines) << ",\n"
+             << "  \"summary\": [\n";
+        for (size_t k = 0; k < CheckCount; ++k) {
+            passed = passed && (totalMismatches[k] == 0);
+            json << "    { \"backend\": \"" << toString(DiffChecks[k].backend) << "\""
+                 << ", \"against\": \"" << toString(DiffChecks[k].against) << "\""
+                 << ", \"mismatches\": " << totalMismatches[k]
+                 << ", \"failedCases\": " << failedCases[k]
+                 << ", \"reportedPixels\": " << reportedPixels[k]
+                 << ", \"maxDelta\": " << maxDelta[k]
+                 << ", \"nsPerLine\": " << jsonNumber(totalNs[k] / totalLines)
+                 << ", \"speedup\": " << jsonNumber(referenceNs / totalNs[k]) << " }"
+                 << ((k + 1 < CheckCount) ? ",\n" : "\n");
+        }
+        json << "  ],\n"
+             << "  \"passed\": " << (passed ? "true" : "false") << "\n}\n";
+
+        std::ofstream(DiffResultPath) << json.str();
+        return passed;
+    }
+}
+
+
+
+void Main()
+{
+    // 先に差分テスト（速い描き方が基準と違う点を描くなら、計測の意味が無いので結果に残す）
+    const bool passed = runDifferential();
+
+    s3d::Image img(BenchWidth, BenchHeight);
+    CacheMissCounter counter;
+    const s3d::Array<BenchCase> cases = makeCases();
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"image\": { \"width\": " << BenchWidth << ", \"height\": " << BenchHeight << " },\n"
+         << "  \"linesPerCase\": " << LinesPerCase << ",\n"
+         << "  \"seed\": " << RandomSeed << ",\n"
+         << "  \"threads\": " << (kotsubu_detail::workerPool().workerCount() + 1) << ",\n"
+         << "  \"cacheMisses\": " << (counter.available() ? "true" : "false") << ",\n"
+         << "  \"differentialPassed\": " << (passed ? "true" : "false") << ",\n"
+         << "  \"cases\": [\n";
+
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const BenchCase& bc = cases[i];
+        const BenchResult r = runCase(bc, img, counter);
+        json << "    { \"renderer\": \"" << toString(bc.renderer) << "\""
+             << ", \"color\": \"" << (bc.colorF ? "ColorF" : "Color") << "\""
+             << ", \"length\": \"" << toString(bc.lengthDist) << "\""
+             << ", \"octant\": " << bc.octant
+             << ", \"aaColorRate\": " << jsonNumber(bc.aaColorRate)
+             << ", \"decaySectionRate\": " << jsonNumber(bc.decaySectionRate)
+             << ", \"trace\": " << (bc.trace ? "true" : "false")
+             << ", \"mpixelsPerSec\": " << jsonNumber(r.mpixelsPerSec)
+             << ", \"nsPerLine\": " << jsonNumber(r.nsPerLine)
+             << ", \"cacheMissesPerLine\": " << jsonNumber(r.cacheMissesPerLine)
+             << ", \"repeats\": " << r.repeats << " }"
+             << ((i + 1 < cases.size()) ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+
+    std::ofstream(ResultPath) << json.str();
+}
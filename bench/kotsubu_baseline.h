@@ -0,0 +1,285 @@
+/*********************************************************************************************************
+〇 差分テストの基準（bench/Main.cpp 専用。固定）
+最初の版（baseline）のMain.cppにあった renderLine / renderLineAA / renderDecayLine を、そのまま写したもの。
+ライブラリ（kotsubu_line_renderer.h）の関数を変えても、この基準は変えないこと（変えると、最初の版との比較にならない）。
+名前がライブラリの関数とぶつからないように、kotsubu_baseline名前空間に入れ、inlineにしただけで、中身は元のまま。
+＜注意＞ 上書きだけ（合成の方式は無い）。クリップもしないので、線分がはみ出さない大きさのイメージに描くこと
+***********************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+
+
+
+namespace kotsubu_baseline
+{
+    // 【関数】線分をレンダリング
+    inline void renderLine(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col)
+    {
+        // 終点を初期位置として始める
+        s3d::Point now = endPos;
+        // xとyそれぞれの、距離（絶対値）と進むべき方向（正負）を求める
+        s3d::Point dist, step;
+        if (endPos.x >= startPos.x)
+            { dist.x = endPos.x - startPos.x; step.x = -1; }
+        else
+            { dist.x = startPos.x - endPos.x; step.x = 1; }
+        if (endPos.y >= startPos.y)
+            { dist.y = endPos.y - startPos.y; step.y = -1; }
+        else
+            { dist.y = startPos.y - endPos.y; step.y = 1; }
+        // 誤差の判定時に四捨五入する、かつ整数で扱うため、関連パラメータを2倍する
+        s3d::Point dist2 = dist * 2;
+
+
+        if (dist.x >= dist.y) {
+            // x基準
+            s3d::int32 e = dist.x;  // 誤差の初期値（四捨五入のために閾値/2とする）
+            for (;;) {
+                // 現在位置に点を描く
+                img[now.y][now.x].set(col);
+
+                // 始点なら終了
+                if (now.x == startPos.x) break;
+
+                // xを「1ドット」移動
+                now.x += step.x;
+
+                // 誤差を蓄積
+                e += dist2.y;
+
+                // 誤差がたまったら
+                if (e >= dist2.x) {
+                    // yを「1ドット」移動
+                    now.y += step.y;
+                    // 誤差をリセット。超過分を残すのがミソ
+                    e -= dist2.x;
+                }
+            }
+        }
+        else {
+            // y基準
+            s3d::int32 e = dist.y;
+            for (;;) {
+                img[now.y][now.x].set(col);
+
+                if (now.y == startPos.y) break;
+                now.y += step.y;
+                e += dist2.x;
+
+                if (e >= dist2.y) {
+                    now.x += step.x;
+                    e -= dist2.y;
+                }
+            }
+        }
+    }
+
+
+
+    // 【関数】線分をレンダリング。疑似アンチエイリアシング付き
+    inline void renderLineAA(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                             double aaColorRate = 0.3)
+    {
+        // 終点を初期位置として始める
+        s3d::Point now = endPos;
+        // xとyそれぞれの、距離（絶対値）と進むべき方向（正負）を求める
+        s3d::Point dist, step;
+        if (endPos.x >= startPos.x)
+            { dist.x = endPos.x - startPos.x; step.x = -1; }
+        else
+            { dist.x = startPos.x - endPos.x; step.x = 1; }
+        if (endPos.y >= startPos.y)
+            { dist.y = endPos.y - startPos.y; step.y = -1; }
+        else
+            { dist.y = startPos.y - endPos.y; step.y = 1; }
+        // 誤差の判定時に四捨五入する、かつ整数で扱うため、関連パラメータを2倍する
+        s3d::Point dist2 = dist * 2;
+        // AA部分の通常部分に対する色の割合
+        if (aaColorRate < 0.0) aaColorRate = 0.0;
+        if (aaColorRate > 1.0) aaColorRate = 1.0;
+        // AA部分の色
+        s3d::ColorF aaCol = s3d::ColorF(col, col.a * aaColorRate);
+
+
+        if (dist.x >= dist.y) {
+            // x基準
+            s3d::int32 e = dist.x;  // 誤差の初期値（四捨五入のために閾値/2とする）
+            for (;;) {
+                // 現在位置に点を描く
+                img[now.y][now.x].set(col);
+
+                // 始点なら終了
+                if (now.x == startPos.x) break;
+
+                // xを「1ドット」移動
+                now.x += step.x;
+
+                // 誤差を蓄積
+                e += dist2.y;
+
+                // 誤差がたまったら
+                if (e >= dist2.x) {
+                    img[now.y][now.x].set(aaCol);           // 疑似AA
+
+                    // yを「1ドット」移動
+                    now.y += step.y;
+
+                    img[now.y][now.x - step.x].set(aaCol);  // 疑似AA
+
+                    // 誤差をリセット。超過分を残すのがミソ
+                    e -= dist2.x;
+                }
+            }
+        }
+        else {
+            // y基準
+            s3d::int32 e = dist.y;
+            for (;;) {
+                img[now.y][now.x].set(col);
+
+                if (now.y == startPos.y) break;
+                now.y += step.y;
+                e += dist2.x;
+
+                if (e >= dist2.y) {
+                    img[now.y][now.x].set(aaCol);
+                    now.x += step.x;
+
+                    img[now.y - step.y][now.x].set(aaCol);
+                    e -= dist2.y;
+                }
+            }
+        }
+    }
+
+
+
+    // 【関数】減衰する線分をレンダリング。疑似アンチエイリアシング付き
+    inline void renderDecayLine(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                                double decaySectionRate = 0.5, double aaColorRate = 0.3)
+    {
+        // 終点を初期位置として始める
+        s3d::Point now = endPos;
+        // xとyそれぞれの、距離（絶対値）と進むべき方向（正負）を求める
+        s3d::Point dist, step;
+        if (endPos.x >= startPos.x)
+            { dist.x = endPos.x - startPos.x; step.x = -1; }
+        else
+            { dist.x = startPos.x - endPos.x; step.x = 1; }
+        if (endPos.y >= startPos.y)
+            { dist.y = endPos.y - startPos.y; step.y = -1; }
+        else
+            { dist.y = startPos.y - endPos.y; step.y = 1; }
+        // 誤差の判定時に四捨五入する、かつ整数で扱うため、関連パラメータを2倍する
+        s3d::Point dist2 = dist * 2;
+        // AA部分の通常部分に対する色の割合
+        if (aaColorRate < 0.0) aaColorRate = 0.0;
+        if (aaColorRate > 1.0) aaColorRate = 1.0;
+        // AA部分の色
+        s3d::ColorF aaCol = s3d::ColorF(col, col.a * aaColorRate);
+        // 減衰区間の割合
+        if (decaySectionRate < 0.0) decaySectionRate = 0.0;
+        if (decaySectionRate > 1.0) decaySectionRate = 1.0;
+
+
+        if (dist.x >= dist.y) {
+            // ◎◎ x基準
+            s3d::int32 e        = dist.x;  // 誤差の初期値（四捨五入のために閾値/2とする）
+            s3d::int32 decayLen = (endPos.x - startPos.x) * decaySectionRate;  // 減衰区間の長さ
+            s3d::int32 splitX   = startPos.x + decayLen;                       // 分割点x
+
+            // ◎ 終点xから分割点xまでループ（通常のAA付き線分の処理）
+            for (;;) {
+                // 現在位置に点を描く
+                img[now.y][now.x].set(col);
+
+                // 分割点ならループを抜ける
+                if (now.x == splitX) break;
+
+                // xを「1ドット」移動
+                now.x += step.x;
+
+                // 誤差を蓄積
+                e += dist2.y;
+
+                // 誤差がたまったら
+                if (e >= dist2.x) {
+                    img[now.y][now.x].set(aaCol);           // 疑似AA
+
+                    // yを「1ドット」移動
+                    now.y += step.y;
+
+                    img[now.y][now.x - step.x].set(aaCol);  // 疑似AA
+
+                    // 誤差をリセット。超過分を残すのがミソ
+                    e -= dist2.x;
+                }
+            }
+
+            // 始点なら終了
+            if (now.x == startPos.x) return;
+
+            // ◎ 分割点xから始点xまでループ（ここが減衰する）
+            double alphaFadeVol = col.a / (1 + std::abs(decayLen));  // アルファのフェード量
+            for (;;) {
+                // 初回の重複描画を避けるためフローを変更
+                now.x += step.x;
+                e += dist2.y;
+
+                col.a -= alphaFadeVol;  // アルファをフェードアウト
+
+                if (e >= dist2.x) {
+                    img[now.y][now.x].set(ColorF(col, col.a * aaColorRate));
+                    now.y += step.y;
+                    img[now.y][now.x - step.x].set(ColorF(col, col.a * aaColorRate));
+                    e -= dist2.x;
+                }
+
+                img[now.y][now.x].set(col);
+                if (now.x == startPos.x) break;
+            }
+        }
+
+        else {
+            // ◎◎ y基準
+            s3d::int32 e        = dist.y;
+            s3d::int32 decayLen = (endPos.y - startPos.y) * decaySectionRate;
+            s3d::int32 splitY   = startPos.y + decayLen;
+
+            for (;;) {
+                img[now.y][now.x].set(col);
+                if (now.y == splitY) break;
+
+                now.y += step.y;
+                e += dist2.x;
+
+                if (e >= dist2.y) {
+                    img[now.y][now.x].set(aaCol);
+                    now.x += step.x;
+                    img[now.y - step.y][now.x].set(aaCol);
+                    e -= dist2.y;
+                }
+            }
+            if (now.y == startPos.y) return;
+
+            double alphaFadeVol = col.a / (1 + std::abs(decayLen));
+            for (;;) {
+                now.y += step.y;
+                e += dist2.x;
+
+                col.a -= alphaFadeVol;
+
+                if (e >= dist2.y) {
+                    img[now.y][now.x].set(ColorF(col, col.a * aaColorRate));
+                    now.x += step.x;
+                    img[now.y - step.y][now.x].set(ColorF(col, col.a * aaColorRate));
+                    e -= dist2.y;
+                }
+
+                img[now.y][now.x].set(col);
+                if (now.y == startPos.y) break;
+            }
+        }
+    }
+}
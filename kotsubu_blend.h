@@ -0,0 +1,190 @@
+/**************************************************************************************************
+【ヘッダオンリー】kotsubu_blend v1.0
+
+・概要
+kotsubu_line_renderer.h の線分を、書き込み先の色と合成するための内部関数群。
+イメージの色はs3d::Imageと同じストレート（乗算済みでない）アルファのまま扱い、
+合成の計算だけを乗算済みアルファの整数演算で行う（除算は逆数の表で掛け算にする）。
+書き込み先が透明（アルファ0）なら、どの方式でも上書きと同じ結果になる。
+＜注意＞ 結果のアルファが小さいほど、ストレートアルファに戻すときの丸めで色の誤差が大きくなる
+
+・合成の方式（色はいずれも乗算済みアルファでの計算）
+Overwrite --- 上書き（Image::setと同じ）
+SrcOver   --- 通常の重ね合わせ。out = src + dst * (1 - srcA)
+Additive  --- 加算。out = min(src + dst, 1)
+Max       --- 比較（明）。out = max(src, dst)
+
+・使い方（通常はkotsubu_line_renderer.hから使われるので、直接使う必要はない）
+kotsubu_detail::blendPixel<BlendMode::Additive>(img[y][x], col);  // 1点を合成する
+kotsubu_detail::blendPixel<BlendMode::Additive>(img8[y][x], col); // 8bitの点には色のアルファを合成する
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+
+
+// 【型】書き込み先との合成の方式
+enum class BlendMode { Overwrite, SrcOver, Additive, Max };
+
+
+
+namespace kotsubu_detail
+{
+    // 【内部関数】色を32bitの並び（メモリ上のr, g, b, aの順）にする / 戻す
+    inline s3d::uint32 toBits(const s3d::Color& col)
+    {
+        s3d::uint32 bits;
+        std::memcpy(&bits, &col, sizeof(bits));
+        return bits;
+    }
+
+    inline s3d::Color fromBits(s3d::uint32 bits)
+    {
+        s3d::Color col;
+        std::memcpy(static_cast<void*>(&col), &bits, sizeof(bits));
+        return col;
+    }
+
+
+
+    // 【内部関数】a * b / 255（四捨五入。a, bは0～255）
+    inline s3d::uint32 mul255(s3d::uint32 a, s3d::uint32 b)
+    {
+        const s3d::uint32 t = a * b + 128;
+        return (t + (t >> 8)) >> 8;
+    }
+
+
+
+    // 【内部関数】16bitおきに並べた2つの値（0x00XX00YY）に、まとめてm / 255を掛ける（四捨五入。mは0～255）
+    // 1回の掛け算で2要素分を計算する。積は16bitに収まるので、隣の要素には繰り上がらない
+    inline s3d::uint32 mul255x2(s3d::uint32 lanes, s3d::uint32 m)
+    {
+        const s3d::uint32 t = lanes * m + 0x00800080;
+        return ((t + ((t >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    }
+
+
+
+    // 【内部型】乗算済みアルファの色。rとbは16bitおきに並べる（rb = r | (b << 16)）
+    struct PremulColor
+    {
+        s3d::uint32 rb;
+        s3d::uint32 g;
+        s3d::uint32 a;
+    };
+
+
+
+    // 【内部関数】乗算済みアルファにする
+    inline PremulColor premultiply(const s3d::Color& col)
+    {
+        const s3d::uint32 bits = toBits(col);
+        return PremulColor{ mul255x2(bits & 0x00FF00FF, col.a), mul255(col.g, col.a), col.a };
+    }
+
+
+
+    // 【内部型】乗算済みアルファを戻すための逆数の表。v[a] = 255 / a（16.16固定小数点）
+    struct UnpremulTable
+    {
+        s3d::uint32 v[256];
+
+        constexpr UnpremulTable() : v()
+        {
+            for (s3d::uint32 a = 1; a < 256; ++a)
+                v[a] = (255u * 65536u + a / 2) / a;
+        }
+    };
+
+    inline constexpr UnpremulTable unpremulTable{};
+
+
+
+    // 【内部関数】乗算済みアルファからストレートアルファに戻す（除算の代わりに逆数の表を掛ける）
+    inline s3d::Color unpremultiply(const PremulColor& p)
+    {
+        if (p.a == 0)   return s3d::Color(0, 0, 0, 0);
+        if (p.a == 255) return fromBits((p.rb) | (p.g << 8) | 0xFF000000u);
+        const s3d::uint32 inv = unpremulTable.v[p.a];
+        auto channel = [inv](s3d::uint32 c) {
+            return std::min<s3d::uint32>((c * inv + 0x8000) >> 16, 255);
+        };
+        return fromBits(channel(p.rb & 0xFF) | (channel(p.g) << 8) | (channel(p.rb >> 16) << 16) | (p.a << 24));
+    }
+
+
+
+    // 【内部関数】乗算済みアルファの色を、ストレートアルファの書き込み先に合成する
+    // srcStraightは同じ色のストレートアルファ版（書き込み先が透明なときはそのまま格納する）
+    template <BlendMode Blend>
+    inline void blendPremul(s3d::Color& dst, const PremulColor& src, const s3d::Color& srcStraight)
+    {
+        if (Blend == BlendMode::Overwrite || dst.a == 0) { dst = srcStraight; return; }
+        if (src.a == 0) return;  // 乗算済みでは0なので、どの方式でも書き込み先のまま
+
+        const s3d::uint32 bits = toBits(dst);
+        const s3d::uint32 da   = dst.a;
+        PremulColor out;
+        if (Blend == BlendMode::SrcOver) {
+            if (src.a == 255) { dst = srcStraight; return; }
+            // 書き込み先の重み w = dstA * (1 - srcA) を先に求め、書き込み先の色には1回だけ掛ける
+            const s3d::uint32 w = mul255(da, 255 - src.a);
+            out = PremulColor{ src.rb + mul255x2(bits & 0x00FF00FF, w), src.g + mul255(dst.g, w), src.a + w };
+        }
+        else if (Blend == BlendMode::Additive) {
+            // 要素ごとに255で飽和させる（9bit目が立った要素を255にする）
+            s3d::uint32 rb = src.rb + mul255x2(bits & 0x00FF00FF, da);
+            rb = (rb | (((rb >> 8) & 0x00010001) * 0xFF)) & 0x00FF00FF;
+            out = PremulColor{ rb, std::min<s3d::uint32>(src.g + mul255(dst.g, da), 255),
+                               std::min<s3d::uint32>(src.a + da, 255) };
+        }
+        else {
+            const s3d::uint32 rb = mul255x2(bits & 0x00FF00FF, da);
+            const s3d::uint32 g  = mul255(dst.g, da);
+            out = PremulColor{ std::max(src.rb & 0xFF, rb & 0xFF) | std::max(src.rb & 0x00FF0000, rb & 0x00FF0000),
+                               std::max(src.g, g), std::max(src.a, da) };
+            if (out.rb == rb && out.g == g && out.a == da) return;  // 書き込み先のまま
+        }
+        dst = unpremultiply(out);
+    }
+
+
+
+    // 【内部関数】1点を合成する
+    template <BlendMode Blend>
+    inline void blendPixel(s3d::Color& dst, const s3d::Color& src)
+    {
+        if (Blend == BlendMode::Overwrite) { dst = src; return; }
+        blendPremul<Blend>(dst, premultiply(src), src);
+    }
+
+    // 8bitの点（KotsubuImage8）に合成する。値は色のアルファで、結果はs3d::Colorの点に合成したときのアルファと同じ
+    template <BlendMode Blend>
+    inline void blendPixel(s3d::uint8& dst, const s3d::Color& src)
+    {
+        const s3d::uint32 s = src.a;
+        if      (Blend == BlendMode::Overwrite) dst = src.a;
+        else if (Blend == BlendMode::SrcOver)   dst = static_cast<s3d::uint8>(s + mul255(dst, 255 - s));
+        else if (Blend == BlendMode::Additive)  dst = static_cast<s3d::uint8>(std::min<s3d::uint32>(s + dst, 255));
+        else                                    dst = std::max(dst, src.a);
+    }
+
+
+
+    // 【内部関数】合成の方式をテンプレート引数にしてfを呼ぶ（f(std::integral_constant<BlendMode, 方式>)）
+    template <class F>
+    inline void withBlend(BlendMode blend, F&& f)
+    {
+        switch (blend) {
+        case BlendMode::SrcOver:  f(std::integral_constant<BlendMode, BlendMode::SrcOver>());   break;
+        case BlendMode::Additive: f(std::integral_constant<BlendMode, BlendMode::Additive>());  break;
+        case BlendMode::Max:      f(std::integral_constant<BlendMode, BlendMode::Max>());       break;
+        default:                  f(std::integral_constant<BlendMode, BlendMode::Overwrite>()); break;
+        }
+    }
+}
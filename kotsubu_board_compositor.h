@@ -0,0 +1,240 @@
+/**************************************************************************************************
+【ヘッダオンリークラス】kotsubu_board_compositor v1.0
+
+・概要
+複数のKotsubuPixelBoardを、1枚のテクスチャ（アトラス）にまとめてドローするクラス（OpenSiv3D v0.6以降専用）
+ボードごとのテクスチャの代わりに、各ボードのイメージをアトラスの別々の区画に詰めて置く。
+draw()は、変更範囲のあるボードだけをアトラスへ転送し、見えているボードを同じテクスチャで続けてドローする
+（同じテクスチャの連続したドローはまとめられるので、ボードの数によらず1回のドローコールになる）。
+ボードの位置、ズーム率、setTint()の色、mVisibleは、ボードごとのものが使われる。
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_board_compositor.h"
+KotsubuPixelBoard preview1(64, 48, 2.0), preview2(64, 48, 2.0);
+KotsubuBoardCompositor compositor;             // アトラスの幅は2048ドット（高さはボードに合わせて伸びる）
+compositor.add(preview1);                      // 追加した順にドローされる
+compositor.add(preview2);
+メインループ
+    renderLine(preview1, startPos, endPos, col);  // 書き込み方はそのまま（変更範囲の通知も同じ）
+    compositor.draw();                         // board.draw()の代わり。全ボードを転送・ドローする
+compositor.remove(preview2);                   // 外す（ボードのdraw()でまた個別にドローできる）
+＜注意＞ ボードはコンポジタより長く生存させるか、先にremove()すること（ポインタで持つ）
+＜注意＞ 8bitの形式のボード（Alpha8, Palette8）はシェーダが要り、疎な記憶方式のボードは見えている範囲だけを転送するので、
+どちらもアトラスに入れずにボードのdraw()でドローする。
+UploadMode::Asyncは使わない（アトラスへは常にそのまま転送する）
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include "kotsubu_pixel_board.h"
+
+
+
+class KotsubuBoardCompositor
+{
+private:
+    // 【内部型】ボード1枚分。区画はアトラスの中の位置と、確保した大きさ（ボードが区画に収まる限り使い回す）
+    struct Entry
+    {
+        KotsubuPixelBoard* board;
+        s3d::Rect          slot;
+    };
+
+    // 【内部フィールド】
+    s3d::Array<Entry>     mEntries;      // 追加した順（ドローの順）
+    s3d::Image            mAtlasImg;     // アトラスの転送元（各ボードの変更範囲を区画へ写す）
+    s3d::DynamicTexture   mAtlas;
+    s3d::Array<s3d::Rect> mUploadRects;  // 今回のdraw()でアトラスへ転送する範囲（アトラスの座標）
+    s3d::int32            mAtlasWidth;
+    bool                  mLayoutDirty;  // 次のdraw()で区画を詰め直すかどうか
+
+    // 区画の間の隙間（ドット）。線形補間でドローしても、隣のボードの色がにじまないようにする
+    static constexpr s3d::int32 SlotPadding = 1;
+
+    // 転送範囲の面積の合計がアトラスの面積×この割合を超えたら、アトラス全体を転送する
+    static constexpr double FullUploadRate = 0.5;
+
+
+
+public:
+    // 【コンストラクタ】atlasWidthはアトラスの幅（これより広いボードがあれば、その幅まで広げる）
+    explicit KotsubuBoardCompositor(s3d::int32 atlasWidth = 2048)
+    {
+        mAtlasWidth  = std::max(atlasWidth, 1);
+        mLayoutDirty = true;
+    }
+
+
+
+    // 【メソッド】ボードを追加する（追加済みなら何もしない）。次のdraw()で区画を詰め直す
+    // ボード自身のテクスチャは使わなくなるのでプールに返す（ボード自身でドローするものは除く）
+    void add(KotsubuPixelBoard& board)
+    {
+        if (find(board) != mEntries.end()) return;
+        if (!selfDrawn(board)) board.releaseTexture();
+        mEntries.push_back(Entry{ &board, s3d::Rect(0, 0, 0, 0) });
+        mLayoutDirty = true;
+    }
+
+
+
+    // 【メソッド】ボードを外す。ボード側は、次の自身のdraw()で全体を転送する
+    void remove(KotsubuPixelBoard& board)
+    {
+        const auto it = find(board);
+        if (it == mEntries.end()) return;
+        mEntries.erase(it);
+        board.markUploadAll();
+        mLayoutDirty = true;
+    }
+
+
+
+    // 【ゲッタ】ボードの数
+    size_t count() const
+    {
+        return mEntries.size();
+    }
+
+
+
+    // 【ゲッタ】アトラスのテクスチャ（確認用）
+    const s3d::DynamicTexture& atlas() const
+    {
+        return mAtlas;
+    }
+
+
+
+    // 【メソッド】ドロー
+    // 区画に収まらない大きさになったボードがあれば詰め直し、アトラス全体を転送する。
+    // それ以外は、見えているボードの変更範囲だけを区画へ写して転送する（見えていないボードの変更範囲は残しておく）
+    void draw()
+    {
+        for (const auto& e : mEntries) {
+            const KotsubuPixelBoard& b = *e.board;
+            if (!selfDrawn(b) && (static_cast<s3d::int32>(b.mWidth) > e.slot.w || static_cast<s3d::int32>(b.mHeight) > e.slot.h))
+                mLayoutDirty = true;
+        }
+        if (mLayoutDirty) pack();
+
+        // 変更範囲を区画へ写す
+        mUploadRects.clear();
+        for (auto& e : mEntries) {
+            KotsubuPixelBoard& b = *e.board;
+            if (selfDrawn(b) || !b.mVisible) continue;
+            if (b.mDirtyAll) copyToSlot(e, s3d::Rect(0, 0, static_cast<s3d::int32>(b.mWidth), static_cast<s3d::int32>(b.mHeight)));
+            else             for (const auto& rect : b.mDirtyRects) copyToSlot(e, rect);
+            b.mDirtyRects.clear();
+            b.mDirtyArea = 0;
+            b.mDirtyAll  = false;
+        }
+
+        // アトラスへ転送（初回や変更が広いときは全体）
+        s3d::int64 uploadArea = 0;
+        for (const auto& r : mUploadRects)
+            uploadArea += static_cast<s3d::int64>(r.w) * r.h;
+        const double atlasArea = static_cast<double>(mAtlasImg.width()) * mAtlasImg.height();
+        if (mAtlas.isEmpty() || (uploadArea > atlasArea * FullUploadRate)) {
+            if (!mAtlasImg.isEmpty()) mAtlas.fill(mAtlasImg);
+        }
+        else {
+            for (const auto& r : mUploadRects)
+                mAtlas.fillRegion(mAtlasImg, r);
+        }
+
+        // 追加した順にドロー。8bitの形式と疎な記憶方式のボードは、ボード自身でドローする（そこでドローコールが分かれる）
+        for (auto& e : mEntries) {
+            KotsubuPixelBoard& b = *e.board;
+            if (selfDrawn(b)) {
+                b.draw();
+                continue;
+            }
+            if (b.mVisible && !mAtlas.isEmpty()) {
+                const s3d::Rect used(e.slot.x, e.slot.y, static_cast<s3d::int32>(b.mWidth), static_cast<s3d::int32>(b.mHeight));
+                mAtlas(used).scaled(b.mScale).draw(b.mBoardPos, b.mTint);
+            }
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+            b.endStatsFrame();
+#endif
+        }
+    }
+
+
+
+private:
+    // 【内部関数】アトラスに入れずに、ボード自身でドローするか（8bitの形式と、疎な記憶方式）
+    static bool selfDrawn(const KotsubuPixelBoard& board)
+    {
+        return board.is8bit() || board.isSparse();
+    }
+
+
+
+    // 【内部メソッド】ボードの項目を探す
+    s3d::Array<Entry>::iterator find(const KotsubuPixelBoard& board)
+    {
+        return std::find_if(mEntries.begin(), mEntries.end(), [&](const Entry& e) { return e.board == &board; });
+    }
+
+
+
+    // 【内部メソッド】区画を詰め直す（棚詰め。高い順に、左から右へ並べ、幅を超えたら次の段にする）
+    // アトラスの大きさが変わったら作り直し、すべてのボードを全体転送の対象にする
+    void pack()
+    {
+        s3d::Array<size_t> order;
+        for (size_t i = 0; i < mEntries.size(); ++i) {
+            Entry& e = mEntries[i];
+            e.slot = s3d::Rect(0, 0, 0, 0);
+            if (!selfDrawn(*e.board)) order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return mEntries[a].board->mHeight > mEntries[b].board->mHeight;
+        });
+
+        s3d::int32 width = mAtlasWidth;
+        for (const size_t i : order)
+            width = std::max(width, static_cast<s3d::int32>(mEntries[i].board->mWidth));
+
+        s3d::int32 x = 0, y = 0, shelfHeight = 0;
+        for (const size_t i : order) {
+            Entry& e = mEntries[i];
+            const s3d::int32 w = static_cast<s3d::int32>(e.board->mWidth);
+            const s3d::int32 h = static_cast<s3d::int32>(e.board->mHeight);
+            if (x > 0 && x + w > width) {
+                x = 0;
+                y += shelfHeight + SlotPadding;
+                shelfHeight = 0;
+            }
+            e.slot = s3d::Rect(x, y, w, h);
+            x += w + SlotPadding;
+            shelfHeight = std::max(shelfHeight, h);
+        }
+        const s3d::int32 height = std::max(y + shelfHeight, 1);
+
+        if (mAtlasImg.width() != width || mAtlasImg.height() != height) {
+            mAtlasImg = s3d::Image(static_cast<size_t>(width), static_cast<size_t>(height), s3d::Color(0, 0, 0, 0));
+            mAtlas.release();
+        }
+        for (auto& e : mEntries)
+            e.board->markUploadAll();
+        mLayoutDirty = false;
+    }
+
+
+
+    // 【内部メソッド】ボードのイメージ（外部バッファのボードはそのバッファ）の範囲を、区画の同じ位置へ写して転送範囲に加える
+    void copyToSlot(const Entry& e, const s3d::Rect& rect)
+    {
+        for (s3d::int32 y = rect.y; y < rect.y + rect.h; ++y)
+            std::copy_n(e.board->uploadRow(y) + rect.x, rect.w, mAtlasImg[e.slot.y + y] + e.slot.x + rect.x);
+
+        const s3d::Rect atlasRect(e.slot.x + rect.x, e.slot.y + rect.y, rect.w, rect.h);
+        mUploadRects.push_back(atlasRect);
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+        e.board->countUpload(rect);
+#endif
+    }
+};
@@ -0,0 +1,323 @@
+/**************************************************************************************************
+【ヘッダオンリークラス】kotsubu_board_lod v1.0
+
+・概要
+ズームアウトしたボードに、縮小した段（詳細度）で線分を描くクラス（OpenSiv3D v0.6以降専用）
+ズーム率が1未満だと、ボードの何ドットかが画面の1ドットになる。そのまま原寸に描くと、点の処理もテクスチャへの転送も
+画面に出ない分まで払うことになる。このクラスは、ズーム率から段を選び（段が1つ上がるごとに縦横1/2。
+ズーム率0.5で1段、0.25で2段）、線分の端点を縮めて、その段のイメージに直接描く。点の処理と転送はズーム率の2乗に比例して減る。
+原寸のイメージへの書き込みは命令バッファ（kotsubu_command_buffer.h）に溜めておき、
+ズームインして原寸が要るとき（段を下げるとき）にまとめて書く。
+段を上げるときは、今の段（原寸なら溜めた書き込みを済ませた原寸）を縮小して作る（透明な点に引きずられないアルファ付きの平均）。
+縮小した段に描いた線分は、原寸を縮小したものより濃い（1ドットの線分は、段でも1ドット）。一覧の画面で線分が消えないための違い
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_board_lod.h"
+KotsubuPixelBoard board(4096, 4096, 0.2);
+KotsubuBoardLod lod(board);                    // ボードはこのクラスより長く生存させる（最大4段）
+メインループ
+    lod.clear();                               // board.clear()の代わり
+    lod.line(LineSegment{ startPos, endPos, ColorF(1.0), LineMode::Decay });  // 線分はこのクラスから描く
+    board.setScale(wheelScale);                // ズームはボードのまま（次のline()かdraw()で段を選び直す）
+    lod.draw();                                // board.draw()の代わり。原寸の段ならボードがドローする
+Print << lod.level();                          // 今の段（0なら原寸）
+lod.flush();                                   // 溜めた原寸への書き込みを今すぐ済ませる（mImgを読む前など）
+＜注意＞ 段を上げている間、原寸のmImgは溜めた分だけ古い。mImgへ直接書く、読むときは、その前にflush()を呼ぶこと。
+直接書いた分は、次に段を上げたときに縮小して反映される
+＜注意＞ 段を上げるのはRGBA8のボード（外部バッファを含む）だけ。8bitの形式と疎な記憶方式のボードは常に原寸に描く
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include <cmath>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_line_renderer.h"
+#include "kotsubu_command_buffer.h"
+
+
+
+class KotsubuBoardLod
+{
+private:
+    // 【内部フィールド】
+    KotsubuPixelBoard*    mBoard;
+    KotsubuCommandBuffer  mCommands;   // 原寸への書き込み（段を上げている間は、下げるまで溜めておく）
+    s3d::Image            mLevelImg;   // 縮小した段のイメージ（mLevel > 0のとき）
+    s3d::DynamicTexture   mLevelTex;   // 縮小した段のテクスチャ（プールから取り出す）
+    s3d::Rect             mDirty;      // 縮小した段の変更範囲（段の座標。無ければ幅0）
+    bool                  mDirtyAll;   // 縮小した段の全体を転送するかどうか
+    s3d::int32            mLevel;      // 今の段（0なら原寸）
+    s3d::int32            mMaxLevel;
+
+    // 原寸への書き込みを溜めておく命令の数の上限（超えたら、段を上げたままでも原寸に書く）
+    static constexpr size_t MaxPendingCommands = 1 << 16;
+
+
+
+public:
+    // 【コンストラクタ】書き込み先のボードと、段の上限（1つ上がるごとに縦横1/2。0なら常に原寸）
+    explicit KotsubuBoardLod(KotsubuPixelBoard& board, s3d::int32 maxLevel = 4)
+        : mCommands(board)
+    {
+        mBoard    = &board;
+        mDirty    = s3d::Rect(0, 0, 0, 0);
+        mDirtyAll = false;
+        mLevel    = 0;
+        mMaxLevel = std::clamp(maxLevel, 0, 16);
+    }
+
+
+
+    // 【デストラクタ】溜めた書き込みを済ませ、テクスチャをプールに返す
+    ~KotsubuBoardLod()
+    {
+        mCommands.flush();
+        if (mLevel > 0) mBoard->markUploadAll();
+        KotsubuBoardPool::shared().releaseTexture(mLevelTex);
+    }
+
+    KotsubuBoardLod(const KotsubuBoardLod&)            = delete;
+    KotsubuBoardLod& operator=(const KotsubuBoardLod&) = delete;
+
+
+
+    // 【ゲッタ】今の段（0なら原寸。line()、clear()、draw()のときにボードのズーム率から選び直す）
+    s3d::int32 level() const
+    {
+        return mLevel;
+    }
+
+
+
+    // 【ゲッタ】原寸にまだ書いていない命令の数
+    size_t pendingCount() const
+    {
+        return mCommands.size();
+    }
+
+
+
+    // 【メソッド】線分を描く（種類、合成の方式、減衰の指定はLineSegmentのまま）
+    // 原寸へは命令として溜め、段を上げていれば、端点を縮めてその段のイメージにすぐ描く
+    void line(const LineSegment& segment)
+    {
+        syncLevel();
+        mCommands.line(segment);
+        if (mLevel == 0) return;
+
+        LineSegment s = segment;
+        s.startPos = toLevel(segment.startPos);
+        s.endPos   = toLevel(segment.endPos);
+        renderLines(mLevelImg, &s, 1);
+        addDirty(s);
+
+        if (mCommands.size() >= MaxPendingCommands) mCommands.flush();
+    }
+
+    void lines(const LineSegment* segments, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+            line(segments[i]);
+    }
+
+    void lines(const s3d::Array<LineSegment>& segments)
+    {
+        lines(segments.data(), segments.size());
+    }
+
+
+
+    // 【メソッド】ボードを白紙にする（原寸へは全体クリアの命令を溜める。それより前に溜めた命令は捨てられる）
+    void clear()
+    {
+        syncLevel();
+        mCommands.clearAll();
+        if (mLevel == 0) return;
+        std::fill_n(mLevelImg.data(), mLevelImg.num_pixels(), s3d::Color(0, 0, 0, 0));
+        mDirtyAll = true;
+    }
+
+
+
+    // 【メソッド】溜めた原寸への書き込みを、今すぐ済ませる（段はそのまま）
+    // threadCountは呼び出し元を含むスレッド数（0なら使えるだけ使う）
+    void flush(size_t threadCount = 0)
+    {
+        mCommands.flush(threadCount);
+    }
+
+
+
+    // 【メソッド】ドロー（board.draw()の代わり）
+    // 原寸の段なら溜めた書き込みを済ませてボードがドローし、縮小した段なら、その段の変更範囲を転送して拡大してドローする
+    void draw(size_t threadCount = 0)
+    {
+        syncLevel();
+        if (mLevel == 0) {
+            mCommands.draw(threadCount);
+            return;
+        }
+
+        KotsubuPixelBoard& b = *mBoard;
+        if (b.mVisible) {
+            const s3d::Rect all(0, 0, mLevelImg.width(), mLevelImg.height());
+            if (mLevelTex.isEmpty()) {
+                mLevelTex = KotsubuBoardPool::shared().acquireTexture(static_cast<size_t>(all.w), static_cast<size_t>(all.h));
+                mDirtyAll = true;
+            }
+            // プールのテクスチャは段のイメージより大きいことがあるので、先頭と行の間隔を渡して転送する
+            // （イメージ版のfillRegion()は同じ大きさでないと転送しない）。転送できなければ次のdraw()でやり直す
+            bool filled = true;
+            if      (mDirtyAll)    filled = mLevelTex.fillRegion(mLevelImg.data(), mLevelImg.stride(), all);
+            else if (mDirty.w > 0) filled = mLevelTex.fillRegion(mLevelImg.data(), mLevelImg.stride(), mDirty);
+            if (filled) {
+                mDirty    = s3d::Rect(0, 0, 0, 0);
+                mDirtyAll = false;
+            }
+
+            // 段の1ドットはボードの2^段ドット（右端と下端の半端な点は、画面の1ドット未満はみ出す）
+            mLevelTex(all).scaled(b.mScale * (1 << mLevel)).draw(b.mBoardPos, b.mTint);
+        }
+
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+        b.endStatsFrame();
+#endif
+    }
+
+
+
+private:
+    // 【内部メソッド】ボードのズーム率から段を選び、変わっていれば（ボードのサイズが変わっていれば）段のイメージを作り直す
+    void syncLevel()
+    {
+        const s3d::int32 level = targetLevel();
+        if ((level == mLevel) && ((level == 0) || (mLevelImg.size() == levelSize(level)))) return;
+        changeLevel(level);
+    }
+
+
+
+    // 【内部メソッド】ズーム率に合う段（ズーム率×2^段が1以下になる一番上の段。RGBA8のボードだけ）
+    s3d::int32 targetLevel() const
+    {
+        KotsubuPixelBoard& b = *mBoard;
+        if (b.is8bit() || b.isSparse()) return 0;
+        const double scale = b.getScale();
+        if ((scale <= 0.0) || (scale >= 1.0)) return 0;
+        const s3d::int32 level = static_cast<s3d::int32>(std::floor(std::log2(1.0 / scale)));
+        return std::clamp(level, 0, mMaxLevel);
+    }
+
+
+
+    // 【内部メソッド】段のイメージのサイズ（ボードのサイズを2^段で割って切り上げ）
+    s3d::Size levelSize(s3d::int32 level) const
+    {
+        const s3d::int32 unit = 1 << level;
+        return s3d::Size((static_cast<s3d::int32>(mBoard->mWidth)  + unit - 1) >> level,
+                         (static_cast<s3d::int32>(mBoard->mHeight) + unit - 1) >> level);
+    }
+
+
+
+    // 【内部メソッド】段を切り替える
+    // 上げるときは今の段から縮小する（溜めた書き込みはそのまま）。下げるとき、原寸から作るときは、溜めた書き込みを済ませてから原寸を縮小する
+    void changeLevel(s3d::int32 level)
+    {
+        KotsubuPixelBoard& b = *mBoard;
+        const s3d::Size size = levelSize(level);
+        if ((level > mLevel) && (mLevel > 0) && (mLevelImg.size() == levelSize(mLevel))) {
+            s3d::Image next(static_cast<size_t>(size.x), static_cast<size_t>(size.y));
+            const s3d::Image& src = mLevelImg;
+            downsample(next, level - mLevel, src.width(), src.height(), [&src](s3d::int32 y) { return src[y]; });
+            mLevelImg = std::move(next);
+        }
+        else {
+            mCommands.flush();
+            if (level > 0) {
+                mLevelImg = s3d::Image(static_cast<size_t>(size.x), static_cast<size_t>(size.y));
+                downsample(mLevelImg, level, static_cast<s3d::int32>(b.mWidth), static_cast<s3d::int32>(b.mHeight),
+                           [&b](s3d::int32 y) { return b.uploadRow(y); });
+            }
+        }
+
+        // 原寸に戻るならボードが全体を転送し、原寸から離れるならボードのテクスチャは使わないのでプールに返す
+        if (level == 0) {
+            mLevelImg = s3d::Image();
+            KotsubuBoardPool::shared().releaseTexture(mLevelTex);
+            b.markUploadAll();
+        }
+        else {
+            if (mLevel == 0) b.releaseTexture();
+            if (!mLevelTex.isEmpty() && (mLevelTex.size() != size)) KotsubuBoardPool::shared().releaseTexture(mLevelTex);
+        }
+        mLevel    = level;
+        mDirty    = s3d::Rect(0, 0, 0, 0);
+        mDirtyAll = true;
+    }
+
+
+
+    // 【内部関数】縮小。dstの1ドットに、srcの2^shift四方の点のアルファ付きの平均を書く（srcの範囲外の点は数えない）
+    // 色はアルファで重み付けする（透明な点の色に引きずられない）。row(y)はsrcのy行目の先頭
+    template <class RowF>
+    static void downsample(s3d::Image& dst, s3d::int32 shift, s3d::int32 srcWidth, s3d::int32 srcHeight, RowF&& row)
+    {
+        const s3d::int32 unit = 1 << shift;
+        for (s3d::int32 y = 0; y < dst.height(); ++y) {
+            const s3d::int32 top    = y << shift;
+            const s3d::int32 bottom = std::min(top + unit, srcHeight);
+            for (s3d::int32 x = 0; x < dst.width(); ++x) {
+                const s3d::int32 left  = x << shift;
+                const s3d::int32 right = std::min(left + unit, srcWidth);
+                s3d::uint64 r = 0, g = 0, bl = 0, a = 0;
+                for (s3d::int32 sy = top; sy < bottom; ++sy) {
+                    const s3d::Color* p = row(sy);
+                    for (s3d::int32 sx = left; sx < right; ++sx) {
+                        const s3d::uint32 alpha = p[sx].a;
+                        r  += p[sx].r * alpha;
+                        g  += p[sx].g * alpha;
+                        bl += p[sx].b * alpha;
+                        a  += alpha;
+                    }
+                }
+                const s3d::uint64 count = static_cast<s3d::uint64>(right - left) * (bottom - top);
+                dst[y][x] = (a == 0) ? s3d::Color(0, 0, 0, 0)
+                                     : s3d::Color(static_cast<s3d::uint8>(r / a), static_cast<s3d::uint8>(g / a),
+                                                  static_cast<s3d::uint8>(bl / a), static_cast<s3d::uint8>(a / count));
+            }
+        }
+    }
+
+
+
+    // 【内部メソッド】イメージ座標の端点を、今の段の座標にする（1/256ドットの単位のまま2^段で割る）
+    FixedPoint toLevel(const FixedPoint& pos) const
+    {
+        return FixedPoint(pos.x >> mLevel, pos.y >> mLevel);
+    }
+
+
+
+    // 【内部メソッド】段に描いた線分の範囲を、段の変更範囲に加える（markDirtySegment()と同じく、サブピクセルとWuの分を広げる）
+    void addDirty(const LineSegment& s)
+    {
+        const s3d::Point p0 = s.startPos.asPoint(), p1 = s.endPos.asPoint();
+        const s3d::int32 margin = ((s.startPos.isCentered() && s.endPos.isCentered()) ? 0 : 1)
+                                + (kotsubu_detail::isWuMode(s.mode) ? 1 : 0);
+        const s3d::int32 left   = std::max(std::min(p0.x, p1.x) - margin, 0);
+        const s3d::int32 top    = std::max(std::min(p0.y, p1.y) - margin, 0);
+        const s3d::int32 right  = std::min(std::max(p0.x, p1.x) + margin + 1, mLevelImg.width());
+        const s3d::int32 bottom = std::min(std::max(p0.y, p1.y) + margin + 1, mLevelImg.height());
+        if ((left >= right) || (top >= bottom)) return;
+
+        if (mDirty.w == 0) {
+            mDirty = s3d::Rect(left, top, right - left, bottom - top);
+            return;
+        }
+        const s3d::int32 l = std::min(mDirty.x, left), t = std::min(mDirty.y, top);
+        const s3d::int32 r = std::max(mDirty.x + mDirty.w, right), btm = std::max(mDirty.y + mDirty.h, bottom);
+        mDirty = s3d::Rect(l, t, r - l, btm - t);
+    }
+};
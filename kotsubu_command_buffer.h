@@ -0,0 +1,417 @@
+/**************************************************************************************************
+【ヘッダオンリークラス】kotsubu_command_buffer v1.0
+
+・概要
+ボードへの書き込みを命令として記録しておき、draw()の前にまとめて実行するクラス（OpenSiv3D v0.6以降専用）
+記録は命令を配列に積むだけで、点の処理は無い。flush()で、
+  1. 後の矩形クリアに丸ごと覆われる命令を捨てる（どうせ消される書き込みはしない）
+  2. 命令を64x64ドットのタイルに振り分ける（タイル全体を覆う矩形クリアがあれば、そのタイルのそれより前の命令は捨てる）
+  3. タイルごとに、記録した順番で並列に実行する（kotsubu_tile_renderer.hの補助スレッドを使う）
+の順に処理する。1つのタイルの点は1つのスレッドが記録順に書くので、
+結果は記録した順番に個別の関数（整数版）で書いた場合とまったく同じになる（renderLines()と違い、組ごとの並べ替えは無い）。
+命令は、線分（LineModeのすべての種類。合成の方式も指定できる）、矩形クリア、円の上書き（Circle(...).overwrite()相当）
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_command_buffer.h"
+KotsubuPixelBoard board(640, 480, 1.0);
+KotsubuCommandBuffer commands(board);          // ボードは命令バッファより長く生存させる
+メインループ
+    commands.decayLine(startPos, endPos, Color(255), 0.5);   // どこからでも記録できる（点の処理は無い）
+    commands.line(LineSegment{ startPos, endPos, ColorF(1.0), LineMode::Wu, 0.5, 0.3, BlendMode::Additive });
+    commands.clearRect(s3d::Rect(0, 0, 64, 64));            // 0で埋める（それより前の、丸ごと覆われる命令は捨てる）
+    commands.circle(s3d::Circle(pos, 5.0), Palette::Red);     // 中心が円の内側にある点を上書き（アンチエイリアス無し）
+    commands.draw();                           // flush()してからboard.draw()
+Print << commands.droppedCount();             // 直前のflush()で捨てた命令の数
+＜注意＞ 記録した命令は、flush()までボードに書かれない。board.clear()やmImgへの直接の書き込み、
+renderLine()などの即時の関数と混ぜるときは、その前にflush()を呼ぶこと
+＜注意＞ 色はs3d::Colorで記録する（ColorFはrenderLines()と同じく変換してから描く）。
+8bitの形式のボードには色のアルファを値として書き、疎な記憶方式のボードには掛かるタイルにだけ書く
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_line_renderer.h"
+#include "kotsubu_tile_renderer.h"
+
+
+
+class KotsubuCommandBuffer
+{
+private:
+    // 【内部型】命令の種類
+    enum class Kind : s3d::uint8 { Line, ClearRect, Circle };
+
+    // 【内部型】命令1つ分
+    struct Command
+    {
+        Kind        kind;
+        LineSegment segment;  // Line
+        s3d::Rect   rect;     // ClearRect（イメージ座標）
+        double      cx;       // Circle（中心と半径。イメージ座標）
+        double      cy;
+        double      r;
+        s3d::Color  col;      // Circle
+    };
+
+    // 【内部フィールド】
+    KotsubuPixelBoard*                      mBoard;
+    s3d::Array<Command>                     mCommands;  // 記録した順
+    s3d::Array<kotsubu_detail::BatchEntry>  mEntries;   // flush()の作業用。線分の前準備の結果（命令と同じ番号）
+    s3d::Array<s3d::Rect>                   mBounds;    // flush()の作業用。命令の書き込む範囲（イメージの範囲にクリップ）
+    s3d::Array<bool>                        mAlive;     // flush()の作業用。捨てずに実行するかどうか
+    s3d::Array<s3d::Rect>                   mCovers;    // flush()の作業用。後ろから見て、それまでの矩形クリア
+    s3d::Array<s3d::Array<s3d::uint32>>     mBins;      // flush()の作業用。タイルごとの命令の番号（記録順）
+    size_t                                  mDropped;   // 直前のflush()で捨てた命令の数
+
+    // 覆われているかを調べる矩形クリアの数の上限（後ろから数えて。命令数×この数で済ませる）
+    static constexpr size_t MaxCovers = 64;
+
+
+
+public:
+    // 【コンストラクタ】書き込み先のボード
+    explicit KotsubuCommandBuffer(KotsubuPixelBoard& board)
+    {
+        mBoard   = &board;
+        mDropped = 0;
+    }
+
+
+
+    // 【メソッド】線分を記録する（種類、合成の方式、減衰の指定はLineSegmentのまま）
+    void line(const LineSegment& segment)
+    {
+        Command c{};
+        c.kind    = Kind::Line;
+        c.segment = segment;
+        mCommands.push_back(c);
+    }
+
+    void line(FixedPoint startPos, FixedPoint endPos, s3d::Color col, BlendMode blend = BlendMode::Overwrite)
+    {
+        line(LineSegment{ startPos, endPos, col, LineMode::Line, 0.5, 0.3, blend });
+    }
+
+
+
+    // 【メソッド】疑似AAの線分を記録する
+    void lineAA(FixedPoint startPos, FixedPoint endPos, s3d::Color col, double aaColorRate = 0.3,
+                BlendMode blend = BlendMode::Overwrite)
+    {
+        line(LineSegment{ startPos, endPos, col, LineMode::AA, 0.5, aaColorRate, blend });
+    }
+
+
+
+    // 【メソッド】アルファ減衰の線分を記録する
+    void decayLine(FixedPoint startPos, FixedPoint endPos, s3d::Color col, double decaySectionRate = 0.5,
+                   double aaColorRate = 0.3, BlendMode blend = BlendMode::Overwrite)
+    {
+        line(LineSegment{ startPos, endPos, col, LineMode::Decay, decaySectionRate, aaColorRate, blend });
+    }
+
+
+
+    // 【メソッド】Wuの線分を記録する
+    void lineWu(FixedPoint startPos, FixedPoint endPos, s3d::Color col, BlendMode blend = BlendMode::Overwrite)
+    {
+        line(LineSegment{ startPos, endPos, col, LineMode::Wu, 0.5, 0.3, blend });
+    }
+
+
+
+    // 【メソッド】Wuのアルファ減衰の線分を記録する
+    void decayLineWu(FixedPoint startPos, FixedPoint endPos, s3d::Color col, double decaySectionRate = 0.5,
+                     BlendMode blend = BlendMode::Overwrite)
+    {
+        line(LineSegment{ startPos, endPos, col, LineMode::WuDecay, decaySectionRate, 0.3, blend });
+    }
+
+
+
+    // 【メソッド】矩形の範囲を0（白紙）で埋める命令を記録する
+    void clearRect(const s3d::Rect& rect)
+    {
+        Command c{};
+        c.kind = Kind::ClearRect;
+        c.rect = rect;
+        mCommands.push_back(c);
+    }
+
+    // ボード全体
+    void clearAll()
+    {
+        clearRect(s3d::Rect(0, 0, std::numeric_limits<s3d::int32>::max(), std::numeric_limits<s3d::int32>::max()));
+    }
+
+
+
+    // 【メソッド】円を上書きする命令を記録する（Circle(...).overwrite()相当）
+    // 点の中心（x + 0.5, y + 0.5）が円の内側（境界を含む）にある点を、colで上書きする（アンチエイリアス無し）
+    void circle(const s3d::Circle& circle, s3d::Color col)
+    {
+        Command c{};
+        c.kind = Kind::Circle;
+        c.cx   = circle.x;
+        c.cy   = circle.y;
+        c.r    = std::max(circle.r, 0.0);
+        c.col  = col;
+        mCommands.push_back(c);
+    }
+
+
+
+    // 【ゲッタ】記録してまだ実行していない命令の数
+    size_t size() const
+    {
+        return mCommands.size();
+    }
+
+
+
+    // 【ゲッタ】直前のflush()で、覆われていたために捨てた命令の数
+    size_t droppedCount() const
+    {
+        return mDropped;
+    }
+
+
+
+    // 【メソッド】記録した命令を、実行せずに捨てる
+    void discard()
+    {
+        mCommands.clear();
+    }
+
+
+
+    // 【メソッド】記録した命令をまとめて実行し、書いた範囲をボードに通知する（命令は空になる）
+    // threadCountは呼び出し元を含むスレッド数（0なら使えるだけ使う。1なら呼び出し元だけで実行する）
+    void flush(size_t threadCount = 0)
+    {
+        mDropped = 0;
+        if (mCommands.empty()) return;
+        KotsubuPixelBoard& board = *mBoard;
+        KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+
+        mAlive.assign(mCommands.size(), false);
+        kotsubu_detail::withBoardImage(board, [&](auto& img) {
+            if (img.width() > 0 && img.height() > 0) {
+                prepare(img.width(), img.height());
+                dropCovered();
+                execute(img, threadCount);
+            }
+        });
+
+        // 実行した命令の範囲を通知する
+        for (size_t i = 0; i < mCommands.size(); ++i) {
+            if (!mAlive[i]) continue;
+            const Command& c = mCommands[i];
+            if (c.kind == Kind::Line)
+                kotsubu_detail::markDirtySegment(board, c.segment.startPos, c.segment.endPos,
+                                                 kotsubu_detail::isWuMode(c.segment.mode));
+            else
+                board.markDirty(mBounds[i]);
+        }
+        mCommands.clear();
+    }
+
+
+
+    // 【メソッド】flush()してからボードをドローする（board.draw()の代わり）
+    void draw(size_t threadCount = 0)
+    {
+        flush(threadCount);
+        mBoard->draw();
+    }
+
+
+
+private:
+    // 【内部メソッド】線分の前準備と、命令ごとの書き込む範囲（イメージの範囲に掛からない命令は捨てる）
+    void prepare(s3d::int32 width, s3d::int32 height)
+    {
+        const size_t count = mCommands.size();
+        mEntries.resize(count);
+        mBounds.resize(count);
+        mAlive.assign(count, true);  // 範囲に掛からない命令はfalseにする
+
+        for (size_t i = 0; i < count; ++i) {
+            const Command& c = mCommands[i];
+            s3d::int32 left, top, right, bottom;  // 両端を含む
+            if (c.kind == Kind::Line) {
+                // 疑似AAの点は外接矩形の中、Wuの点はもう一方の軸に1ドットはみ出すことがある
+                mEntries[i] = kotsubu_detail::makeBatchEntry(c.segment);
+                const kotsubu_detail::LineSetup& ls = mEntries[i].ls;
+                const s3d::int32 margin = mEntries[i].wu ? 1 : 0;
+                left   = std::min(ls.startPos.x, ls.endPos.x) - margin;
+                top    = std::min(ls.startPos.y, ls.endPos.y) - margin;
+                right  = std::max(ls.startPos.x, ls.endPos.x) + margin;
+                bottom = std::max(ls.startPos.y, ls.endPos.y) + margin;
+            }
+            else if (c.kind == Kind::ClearRect) {
+                left   = c.rect.x;
+                top    = c.rect.y;
+                right  = c.rect.x + c.rect.w - 1;
+                bottom = c.rect.y + c.rect.h - 1;
+            }
+            else {
+                left   = static_cast<s3d::int32>(std::floor(c.cx - c.r));
+                top    = static_cast<s3d::int32>(std::floor(c.cy - c.r));
+                right  = static_cast<s3d::int32>(std::ceil(c.cx + c.r));
+                bottom = static_cast<s3d::int32>(std::ceil(c.cy + c.r));
+            }
+            left   = std::max(left, 0);
+            top    = std::max(top, 0);
+            right  = std::min(right, width - 1);
+            bottom = std::min(bottom, height - 1);
+            mBounds[i] = s3d::Rect(left, top, right - left + 1, bottom - top + 1);
+            if ((left > right) || (top > bottom)) mAlive[i] = false;
+        }
+    }
+
+
+
+    // 【内部メソッド】後の矩形クリアに丸ごと覆われる命令を捨てる（後ろから見ていく）
+    void dropCovered()
+    {
+        mCovers.clear();
+        for (size_t i = mCommands.size(); i-- > 0; ) {
+            if (!mAlive[i]) continue;
+            const s3d::Rect& b = mBounds[i];
+            const bool covered = std::any_of(mCovers.begin(), mCovers.end(), [&](const s3d::Rect& r) {
+                return (r.x <= b.x) && (r.y <= b.y) && (b.x + b.w <= r.x + r.w) && (b.y + b.h <= r.y + r.h);
+            });
+            if (covered) {
+                mAlive[i] = false;
+                ++mDropped;
+            }
+            else if ((mCommands[i].kind == Kind::ClearRect) && (mCovers.size() < MaxCovers)) {
+                mCovers.push_back(b);
+            }
+        }
+    }
+
+
+
+    // 【内部メソッド】タイルに振り分けて、タイルごとに記録順で実行する
+    // 書き込み先はs3d::Image、KotsubuImage8、KotsubuSparseImage（疎なイメージは、矩形クリア以外の掛かるタイルだけを割り当てる）
+    template <class Surface>
+    void execute(Surface& img, size_t threadCount)
+    {
+        using namespace kotsubu_detail;
+        WorkerPool& pool = workerPool();
+        const size_t usedWorkers = std::min(pool.workerCount(), (threadCount == 0) ? pool.workerCount() : (threadCount - 1));
+
+        // 帯ごとに振り分ける（帯ごとに書き込み先のタイルが別なので、並列でもロックは要らない）
+        const s3d::int32 tilesX = (img.width()  + TileSize - 1) / TileSize;
+        const s3d::int32 tilesY = (img.height() + TileSize - 1) / TileSize;
+        mBins.resize(static_cast<size_t>(tilesX) * tilesY);
+        pool.parallelFor(tilesY, usedWorkers, [&](size_t band) {
+            binBand(img, static_cast<s3d::int32>(band), tilesX);
+        });
+
+        // 疎なイメージは、点を書く命令のあるタイルを先に1スレッドで割り当てておく（矩形クリアだけのタイルは白紙のまま）
+        if constexpr (std::is_same_v<Surface, KotsubuSparseImage>) {
+            for (size_t tile = 0; tile < mBins.size(); ++tile) {
+                const bool writes = std::any_of(mBins[tile].begin(), mBins[tile].end(), [this](s3d::uint32 i) {
+                    return mCommands[i].kind != Kind::ClearRect;
+                });
+                if (writes) img.tile(static_cast<s3d::int32>(tile % tilesX), static_cast<s3d::int32>(tile / tilesX));
+            }
+        }
+
+        // タイルごとに記録順で実行する（タイルの範囲でクリップする）
+        pool.parallelFor(mBins.size(), usedWorkers, [&](size_t tile) {
+            if (mBins[tile].empty()) return;
+            const s3d::int32 tx = static_cast<s3d::int32>(tile % tilesX);
+            const s3d::int32 ty = static_cast<s3d::int32>(tile / tilesX);
+            if constexpr (std::is_same_v<Surface, KotsubuSparseImage>) {
+                if (!img.findTile(tx, ty)) return;
+            }
+            const ClipRect clip{ tx * TileSize, ty * TileSize,
+                                 std::min((tx + 1) * TileSize, img.width())  - 1,
+                                 std::min((ty + 1) * TileSize, img.height()) - 1 };
+            auto&& surface = tileSurface(img, tx, ty);
+            using TileSurface = std::remove_reference_t<decltype(surface)>;
+            for (const s3d::uint32 i : mBins[tile]) {
+                const Command& c = mCommands[i];
+                if      (c.kind == Kind::Line)      batchDrawTable<TileSurface>[mEntries[i].bucket](surface, mEntries[i], clip);
+                else if (c.kind == Kind::ClearRect) fillRect(surface, mBounds[i], clip, PixelOf<TileSurface>{});
+                else                                fillCircle(surface, c, clip, pixelValue<PixelOf<TileSurface>>(c.col));
+            }
+        });
+    }
+
+
+
+    // 【内部メソッド】1行分のタイル（帯）に、命令を記録順に振り分ける
+    // 線分は帯の範囲でクリップしたステップの範囲から、通るxの範囲を求める。矩形クリアと円は書き込む範囲で振り分ける。
+    // タイル全体を覆う矩形クリアが来たら、そのタイルのそれまでの命令は捨てる（記録順なので、後で消される）
+    template <class Surface>
+    void binBand(const Surface& img, s3d::int32 band, s3d::int32 tilesX)
+    {
+        using namespace kotsubu_detail;
+        const ClipRect bandClip{ 0, band * TileSize, img.width() - 1,
+                                 std::min((band + 1) * TileSize, img.height()) - 1 };
+        s3d::Array<s3d::uint32>* row = mBins.data() + static_cast<size_t>(band) * tilesX;
+        for (s3d::int32 tx = 0; tx < tilesX; ++tx) row[tx].clear();
+
+        for (size_t i = 0; i < mCommands.size(); ++i) {
+            if (!mAlive[i]) continue;
+            const s3d::Rect& b = mBounds[i];
+            if ((b.y + b.h - 1 < bandClip.top) || (b.y > bandClip.bottom)) continue;
+
+            s3d::int32 lo = b.x, hi = b.x + b.w - 1;
+            if ((mCommands[i].kind == Kind::Line) && !clipXRange(mEntries[i].ls, bandClip, lo, hi, mEntries[i].wu)) continue;
+
+            const bool clears = (mCommands[i].kind == Kind::ClearRect) && (b.y <= bandClip.top) &&
+                                (b.y + b.h - 1 >= bandClip.bottom);
+            for (s3d::int32 tx = lo / TileSize; tx <= hi / TileSize; ++tx) {
+                if (clears && (b.x <= tx * TileSize) && (b.x + b.w >= std::min((tx + 1) * TileSize, img.width())))
+                    row[tx].clear();
+                row[tx].push_back(static_cast<s3d::uint32>(i));
+            }
+        }
+    }
+
+
+
+    // 【内部関数】矩形の範囲（rect）のうち、クリップ範囲の中を値で埋める
+    template <class Surface, class Pixel>
+    static void fillRect(Surface& img, const s3d::Rect& rect, const kotsubu_detail::ClipRect& clip, Pixel value)
+    {
+        const s3d::int32 left   = std::max(rect.x, clip.left);
+        const s3d::int32 right  = std::min(rect.x + rect.w - 1, clip.right);
+        const s3d::int32 top    = std::max(rect.y, clip.top);
+        const s3d::int32 bottom = std::min(rect.y + rect.h - 1, clip.bottom);
+        for (s3d::int32 y = top; y <= bottom; ++y) {
+            auto&& row = img[y];
+            for (s3d::int32 x = left; x <= right; ++x)
+                row[x] = value;
+        }
+        if ((left <= right) && (top <= bottom)) KOTSUBU_BOARD_STATS_WRITTEN(static_cast<s3d::int64>(right - left + 1) * (bottom - top + 1));
+    }
+
+
+
+    // 【内部関数】円の内側の点のうち、クリップ範囲の中を値で埋める（行ごとに、内側になるxの範囲を求める）
+    template <class Surface, class Pixel>
+    static void fillCircle(Surface& img, const Command& c, const kotsubu_detail::ClipRect& clip, Pixel value)
+    {
+        const double r2 = c.r * c.r;
+        for (s3d::int32 y = clip.top; y <= clip.bottom; ++y) {
+            const double dy = (y + 0.5) - c.cy;
+            if (dy * dy > r2) continue;
+            const double half = std::sqrt(r2 - dy * dy);
+            const s3d::int32 left  = std::max(static_cast<s3d::int32>(std::ceil(c.cx - half - 0.5)), clip.left);
+            const s3d::int32 right = std::min(static_cast<s3d::int32>(std::floor(c.cx + half - 0.5)), clip.right);
+            auto&& row = img[y];
+            for (s3d::int32 x = left; x <= right; ++x)
+                row[x] = value;
+            if (left <= right) KOTSUBU_BOARD_STATS_WRITTEN(right - left + 1);
+        }
+    }
+};
@@ -0,0 +1,477 @@
+/**************************************************************************************************
+【ヘッダオンリークラス】kotsubu_gpu_line_renderer v1.0
+
+・概要
+大量の線分を、GPUのピクセルシェーダでボードに描くクラス（OpenSiv3D v0.6以降専用）
+CPUで点を処理してmImgからテクスチャへ転送する代わりに、線分の表（1本につき48バイト）だけを転送し、
+線分ごとに線分を囲む細い四角形をドローして、ピクセルシェーダがその点が線分の点かを判定して色を書く。
+描画内容はGPU側のレンダーテクスチャにあり、mImgは読み戻し（readback()）を呼んだときだけ更新する。
+シェーダは整数版（kotsubu_line_renderer.h）と同じ式（ブレゼンハムの移動回数、疑似AAの点、減衰のアルファの丸め）で判定するので、
+結果はCPUで描いた場合とまったく同じになる（はず。bench/Main.cppの差分テストは、シェーダを読み込めた環境でだけこれを確かめる。
+読み込めなければCPUで描くので（"gpu": false）、CPU同士の比較になる）。
+GPUで描くのは、上書き（BlendMode::Overwrite）のLineMode::Line, AA, Decayで、基準軸が2^20ドット未満の線分。
+それ以外（Wu、上書き以外の合成、とても長い線分）は、読み戻してCPUで描き、描いた範囲だけをレンダーテクスチャへ戻す。
+CPUで描く線分は、後のGPUで描く線分と範囲が重ならなければ後回しにしてまとめる（GPUのドローの並びを分けない。重なる線分の順番は保つ）
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_gpu_line_renderer.h"
+KotsubuPixelBoard board(1920, 1080, 1.0);
+KotsubuGpuLineRenderer gpu(board);             // ボードはこのクラスより長く生存させる
+メインループ
+    gpu.clear();                               // board.clear()の代わり（レンダーテクスチャを白紙にする）
+    for (const auto& s : field) gpu.line(s);   // 記録するだけ（LineSegment。ColorFはs3d::Colorに変換して描く）
+    gpu.draw();                                // flush()してから、レンダーテクスチャをボードの位置とズーム率でドローする
+const s3d::Image& img = gpu.readback();        // 必要なときだけmImgへ読み戻す（GPUの完了を待つ）
+Print << gpu.fallbackCount();                  // CPUで描いた線分の数（多ければ、上書き以外の合成などを見直す）
+＜注意＞ GPUで描くのはRGBA8の密なボードだけ。8bitの形式、疎な記憶方式、外部バッファのボードと、
+シェーダ（shader/kotsubu_gpu_line.hlsl、shader/kotsubu_gpu_line.frag）を読み込めなかったときは、ボード版の関数でCPUが描く
+＜注意＞ mImgへ直接書いたら、upload()でレンダーテクスチャへ送ること。flush()とreadback()は、Transformer2Dの外で呼ぶ
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_line_renderer.h"
+
+
+
+namespace kotsubu_detail
+{
+    // 【内部定数】GPUの線分表。1本につき12語（1語は1テクセルのr, g, b, aに下位のバイトから入れる）。1行に340本
+    // 語の並び：0 終点の基準軸, 1 終点のもう一方の軸, 2 フラグ（bit0 x基準, bit1 基準軸の向きが負, bit2 もう一方の軸の向きが負,
+    // bit4-5 種類 0:Line 1:AA 2:Decay）, 3 始点のステップ, 4 e0, 5 eInc, 6 eMax, 7 分割点のステップ,
+    // 8 色, 9 疑似AAの色, 10 アルファのフェード量（16.16）, 11 疑似AA部分の割合（16bit固定小数点）
+    // シェーダ（shader/kotsubu_gpu_line.*）の定数と合わせること
+    constexpr s3d::uint32 GpuLineWords       = 12;
+    constexpr s3d::uint32 GpuLinesPerRow     = 340;
+    constexpr s3d::int32  GpuLineTableWidth  = static_cast<s3d::int32>(GpuLineWords * GpuLinesPerRow);
+
+    // 【内部定数】GPUで描く線分の基準軸のステップ数の上限（シェーダは移動回数を単精度で見積もってから直すため）
+    constexpr s3d::int64  GpuLineMaxSteps    = 1 << 20;
+
+    // 【内部定数】四角形の、もう一方の軸への半分の幅（ブレゼンハムの点のずれ1ドットと、疑似AAの1ドットに余裕を足したもの）
+    constexpr double      GpuLineQuadMargin  = 3.0;
+
+    // 【内部定数】線分が書く範囲を、端点の外接矩形から広げる幅（Wuと疑似AAの点がはみ出す1ドットに余裕を足したもの）
+    constexpr s3d::int32  GpuLineBoundsMargin = 2;
+
+
+
+    // 【内部型】GPUの線分1本分の前準備の結果
+    // kindは、描かない（ボードに掛からない）, GPUで描く, CPUで描く
+    struct GpuLineEntry
+    {
+        enum class Kind : s3d::uint8 { Skip, Gpu, Cpu };
+
+        Kind        kind;
+        s3d::uint32 words[GpuLineWords];
+        s3d::Vec2   quad[4];  // 線分を囲む四角形（ボードの座標）
+        s3d::Rect   bounds;   // 線分が書く可能性のある範囲（ボードの範囲に収めたもの。GPUとCPUで描く線分の順番の入れ替え用）
+    };
+
+
+
+    // 【内部関数】色を線分表の1語にする（r, g, b, aの順に下位のバイトから）
+    inline s3d::uint32 packGpuColor(const s3d::Color& col)
+    {
+        return s3d::uint32(col.r) | (s3d::uint32(col.g) << 8) | (s3d::uint32(col.b) << 16) | (s3d::uint32(col.a) << 24);
+    }
+
+
+
+    // 【内部関数】GPUの線分1本分の前準備。clipはボードの範囲
+    // 分割点とフェード量はrunKernel()と同じ式で求め、四角形は見えているステップの範囲だけを囲む
+    inline GpuLineEntry makeGpuLineEntry(const LineSegment& seg, const ClipRect& clip)
+    {
+        GpuLineEntry g{};
+        const bool supported = (seg.blend == BlendMode::Overwrite) &&
+                               ((seg.mode == LineMode::Line) || (seg.mode == LineMode::AA) || (seg.mode == LineMode::Decay));
+        const BatchEntry e  = makeBatchEntry(seg);
+        const LineSetup& ls = e.ls;
+        const bool xMajor   = ls.xMajor;
+        const StepRange r   = xMajor ? visibleSteps<true>(ls, clip) : visibleSteps<false>(ls, clip);
+        if (r.first > r.last) { g.kind = GpuLineEntry::Kind::Skip; return g; }
+
+        const s3d::int32 left   = std::max(std::min(ls.startPos.x, ls.endPos.x) - GpuLineBoundsMargin, clip.left);
+        const s3d::int32 top    = std::max(std::min(ls.startPos.y, ls.endPos.y) - GpuLineBoundsMargin, clip.top);
+        const s3d::int32 right  = std::min(std::max(ls.startPos.x, ls.endPos.x) + GpuLineBoundsMargin, clip.right);
+        const s3d::int32 bottom = std::min(std::max(ls.startPos.y, ls.endPos.y) + GpuLineBoundsMargin, clip.bottom);
+        g.bounds = s3d::Rect(left, top, right - left + 1, bottom - top + 1);
+
+        const s3d::int32 dist = xMajor ? (ls.endPos.x - ls.startPos.x) : (ls.endPos.y - ls.startPos.y);
+        const s3d::int64 last = std::abs(dist);
+        if (!supported || (last >= GpuLineMaxSteps) || (ls.eMax > 0xFFFFFFFFll)) { g.kind = GpuLineEntry::Kind::Cpu; return g; }
+
+        s3d::int64  split = last;
+        s3d::uint32 fade  = 0;
+        if (seg.mode == LineMode::Decay) {
+            const s3d::int32 decayLen = dist * e.decaySectionRate;
+            split = last - std::abs(decayLen);
+            fade  = (static_cast<s3d::uint32>(e.col.a) << AlphaShift) / (1 + std::abs(decayLen));
+        }
+
+        const s3d::int32 stepMaj = xMajor ? ls.step.x : ls.step.y;
+        const s3d::int32 stepMin = xMajor ? ls.step.y : ls.step.x;
+        g.kind     = GpuLineEntry::Kind::Gpu;
+        g.words[0] = static_cast<s3d::uint32>(xMajor ? ls.endPos.x : ls.endPos.y);
+        g.words[1] = static_cast<s3d::uint32>(xMajor ? ls.endPos.y : ls.endPos.x);
+        g.words[2] = (xMajor ? 1u : 0u) | ((stepMaj < 0) ? 2u : 0u) | ((stepMin < 0) ? 4u : 0u) |
+                     (static_cast<s3d::uint32>(seg.mode) << 4);
+        g.words[3] = static_cast<s3d::uint32>(last);
+        g.words[4] = static_cast<s3d::uint32>(ls.e0);
+        g.words[5] = static_cast<s3d::uint32>(ls.eInc);
+        g.words[6] = static_cast<s3d::uint32>(ls.eMax);
+        g.words[7] = static_cast<s3d::uint32>(split);
+        g.words[8] = packGpuColor(e.col);
+        g.words[9] = packGpuColor(e.aaCol);
+        g.words[10] = fade;
+        g.words[11] = e.aaRate;
+
+        // 見えている最初と最後のステップの点の中心を結ぶ線から、もう一方の軸へ±GpuLineQuadMarginの四角形
+        // （基準軸は点の端まで。途中の点と疑似AAの点は、この線から2ドット以内にある）
+        const s3d::Point pA = xMajor ? stepPos<true>(ls, r.first) : stepPos<false>(ls, r.first);
+        const s3d::Point pB = xMajor ? stepPos<true>(ls, r.last)  : stepPos<false>(ls, r.last);
+        const double majA = xMajor ? pA.x : pA.y, minA = (xMajor ? pA.y : pA.x) + 0.5;
+        const double majB = xMajor ? pB.x : pB.y, minB = (xMajor ? pB.y : pB.x) + 0.5;
+        const double slope = (majA == majB) ? 0.0 : (minB - minA) / (majB - majA);
+        const double lo = std::min(majA, majB), hi = std::max(majA, majB) + 1.0;
+        const double cLo = minA + slope * (lo - 0.5 - majA), cHi = minA + slope * (hi - 0.5 - majA);
+        auto at = [xMajor](double maj, double mnr) { return xMajor ? s3d::Vec2(maj, mnr) : s3d::Vec2(mnr, maj); };
+        g.quad[0] = at(lo, cLo - GpuLineQuadMargin);
+        g.quad[1] = at(hi, cHi - GpuLineQuadMargin);
+        g.quad[2] = at(hi, cHi + GpuLineQuadMargin);
+        g.quad[3] = at(lo, cLo + GpuLineQuadMargin);
+        return g;
+    }
+}
+
+
+
+class KotsubuGpuLineRenderer
+{
+private:
+    // 【内部フィールド】
+    KotsubuPixelBoard*                        mBoard;
+    s3d::Array<LineSegment>                   mSegments;  // 記録した順（flush()まで）
+    s3d::Array<kotsubu_detail::GpuLineEntry>  mEntries;   // flush()の作業用。線分ごとの前準備の結果
+    s3d::Array<s3d::uint32>                   mPending;   // flush()の作業用。後回しにしている、CPUで描く線分の番号
+    s3d::Image                                mTable;     // 線分表の転送元
+    s3d::DynamicTexture                       mTableTex;  // 線分表（mTableと同じサイズ）
+    s3d::DynamicTexture                       mImgTex;    // mImgをレンダーテクスチャへ戻すときの転送先（mImgと同じサイズ）
+    s3d::RenderTexture                        mTarget;    // ボードの描画内容（GPU側）
+    s3d::PixelShader                          mShader;
+    bool                                      mImgStale;  // mImgがmTargetより古いか（GPUで描いてから読み戻していない）
+    size_t                                    mFallback;  // CPUで描いた線分の数（累計）
+
+
+
+public:
+    // 【コンストラクタ】書き込み先のボード。ボードのテクスチャは使わなくなるのでプールに返す
+    explicit KotsubuGpuLineRenderer(KotsubuPixelBoard& board)
+    {
+        mBoard    = &board;
+        mImgStale = false;
+        mFallback = 0;
+        mShader   = s3d::HLSL{ U"shader/kotsubu_gpu_line.hlsl", U"PS" } |
+                    s3d::GLSL{ U"shader/kotsubu_gpu_line.frag", {} };
+        if (usesGpu()) board.releaseTexture();
+    }
+
+
+
+    // 【デストラクタ】記録した線分を描き、mImgへ読み戻す（ボードはまた自身でドローできる）
+    ~KotsubuGpuLineRenderer()
+    {
+        flush();
+        readback();
+    }
+
+    KotsubuGpuLineRenderer(const KotsubuGpuLineRenderer&)            = delete;
+    KotsubuGpuLineRenderer& operator=(const KotsubuGpuLineRenderer&) = delete;
+
+
+
+    // 【ゲッタ】GPUで描くか（RGBA8の密なボードで、シェーダを読み込めたとき）
+    bool usesGpu() const
+    {
+        const KotsubuPixelBoard& b = *mBoard;
+        return static_cast<bool>(mShader) && !b.is8bit() && !b.isSparse() && !b.isExternal();
+    }
+
+
+
+    // 【ゲッタ】記録した線分の数 / CPUで描いた線分の数（累計）
+    size_t size() const
+    {
+        return mSegments.size();
+    }
+
+    size_t fallbackCount() const
+    {
+        return mFallback;
+    }
+
+
+
+    // 【メソッド】線分を記録する（flush()まで描かない）
+    void line(const LineSegment& segment)
+    {
+        mSegments.push_back(segment);
+    }
+
+    void lines(const LineSegment* segments, size_t count)
+    {
+        mSegments.insert(mSegments.end(), segments, segments + count);
+    }
+
+    void lines(const s3d::Array<LineSegment>& segments)
+    {
+        lines(segments.data(), segments.size());
+    }
+
+
+
+    // 【メソッド】ボードを白紙にする（記録した線分は捨てる）。GPUではレンダーテクスチャを消すだけで、mImgは読み戻すまで古いまま
+    void clear()
+    {
+        mSegments.clear();
+        if (!usesGpu()) {
+            mBoard->clear();
+            return;
+        }
+        syncTarget();
+        s3d::Graphics2D::Flush();
+        mTarget.clear(s3d::ColorF(0.0, 0.0, 0.0, 0.0));
+        mImgStale = true;
+    }
+
+
+
+    // 【メソッド】記録した線分を、記録した順に描く（記録は空になる）
+    // GPUで描ける線分は1回のドローの並びにまとめ、CPUで描く線分は後回しにする。後回しにした線分と範囲が重なる
+    // GPUの線分が来たら、そこまでをGPU、CPUの順に描く（CPUの分は読み戻してから描き、描いた範囲だけをレンダーテクスチャへ戻す）。
+    // 入れ替わるのは範囲が重ならない線分同士だけなので、結果は記録した順に描いた場合と同じになる
+    void flush()
+    {
+        if (mSegments.empty()) return;
+        KotsubuPixelBoard& board = *mBoard;
+        KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+        if (!usesGpu()) {
+            for (const auto& s : mSegments)
+                renderLines(board, &s, 1);
+            mSegments.clear();
+            return;
+        }
+
+        syncTarget();
+        const kotsubu_detail::ClipRect clip{ 0, 0, static_cast<s3d::int32>(board.mWidth) - 1,
+                                                   static_cast<s3d::int32>(board.mHeight) - 1 };
+        mEntries.resize(mSegments.size());
+        for (size_t i = 0; i < mSegments.size(); ++i)
+            mEntries[i] = kotsubu_detail::makeGpuLineEntry(mSegments[i], clip);
+
+        using Kind = kotsubu_detail::GpuLineEntry::Kind;
+        const size_t count = mSegments.size();
+        size_t    first = 0;
+        s3d::Rect pendingBounds(0, 0, 0, 0);  // 後回しにしている線分の範囲を合わせたもの
+        mPending.clear();
+        for (size_t i = 0; i < count; ++i) {
+            const kotsubu_detail::GpuLineEntry& g = mEntries[i];
+            if (g.kind == Kind::Cpu) {
+                pendingBounds = unionRect(pendingBounds, g.bounds);
+                mPending.push_back(static_cast<s3d::uint32>(i));
+            }
+            else if ((g.kind == Kind::Gpu) && !mPending.empty() && overlapsPending(g.bounds, pendingBounds)) {
+                drawRange(first, i, pendingBounds);
+                first         = i;
+                pendingBounds = s3d::Rect(0, 0, 0, 0);
+                mPending.clear();
+            }
+        }
+        drawRange(first, count, pendingBounds);
+        mSegments.clear();
+    }
+
+
+
+    // 【メソッド】flush()してからドローする（board.draw()の代わり）
+    void draw()
+    {
+        flush();
+        KotsubuPixelBoard& b = *mBoard;
+        if (!usesGpu()) {
+            b.draw();
+            return;
+        }
+
+        if (b.mVisible) {
+            syncTarget();
+            KOTSUBU_BOARD_STATS_SCOPE(b, Draw);
+            mTarget.scaled(b.mScale).draw(b.mBoardPos, b.mTint);
+        }
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+        b.endStatsFrame();
+#endif
+    }
+
+
+
+    // 【メソッド】レンダーテクスチャの内容をmImgへ読み戻す（古いときだけ。GPUの完了を待つ）
+    // ボードは全体を変更範囲にする（ボード自身のdraw()でドローするとき、全体を転送する）
+    const s3d::Image& readback()
+    {
+        syncImage();
+        return mBoard->mImg;
+    }
+
+
+
+    // 【メソッド】mImgの内容をレンダーテクスチャへ送る（mImgへ直接書いたあと）。記録した線分は先に描く
+    void upload()
+    {
+        if (!usesGpu()) return;
+        uploadRegion(s3d::Rect(0, 0, static_cast<s3d::int32>(mBoard->mWidth), static_cast<s3d::int32>(mBoard->mHeight)));
+    }
+
+
+
+private:
+    // 【内部メソッド】レンダーテクスチャをボードのサイズに合わせる（作り直したら、mImgの内容から始める）
+    void syncTarget()
+    {
+        const KotsubuPixelBoard& b = *mBoard;
+        if (!mTarget.isEmpty() && (mTarget.width()  == static_cast<s3d::int32>(b.mWidth))
+                               && (mTarget.height() == static_cast<s3d::int32>(b.mHeight))) return;
+        mImgStale = false;
+        upload();
+    }
+
+
+
+    // 【内部メソッド】mImgの範囲rectを、レンダーテクスチャへ送る
+    // 転送用のテクスチャは使い回し、範囲だけを転送してから、その範囲だけをレンダーテクスチャへドローする
+    void uploadRegion(const s3d::Rect& rect)
+    {
+        const s3d::Image& img = mBoard->mImg;
+        if (mTarget.isEmpty() || (mTarget.size() != img.size())) {
+            mTarget = s3d::RenderTexture(static_cast<size_t>(mBoard->mWidth), static_cast<size_t>(mBoard->mHeight));
+        }
+        if (mImgTex.isEmpty() || (mImgTex.size() != img.size())) mImgTex = s3d::DynamicTexture(img);
+        else                                                       mImgTex.fillRegion(img, rect);
+        {
+            const s3d::ScopedRenderTarget2D target(mTarget);
+            const s3d::ScopedRenderStates2D states(s3d::BlendState::Opaque);
+            mImgTex(rect).draw(rect.pos);
+            s3d::Graphics2D::Flush();  // 転送用のテクスチャは次の転送で書き換えるので、ここでドローし切る
+        }
+        mImgStale = false;
+    }
+
+
+
+    // 【内部メソッド】記録のfirstからlastの手前までを描く。GPUで描く線分を先に描き、後回しにした線分（mPending）をCPUで描く
+    // CPUで描いた線分の範囲（bounds）だけを、レンダーテクスチャへ戻す
+    void drawRange(size_t first, size_t last, const s3d::Rect& bounds)
+    {
+        drawGpu(first, last);
+        if (mPending.empty()) return;
+        syncImage();
+        for (const s3d::uint32 i : mPending)
+            renderLines(mBoard->mImg, &mSegments[i], 1);
+        uploadRegion(bounds);
+        mFallback += mPending.size();
+    }
+
+
+
+    // 【内部メソッド】GPUで描く線分の範囲が、後回しにしている線分の範囲と重なるか
+    // 合わせた範囲と重ならなければ重ならない。重なれば1本ずつ調べる
+    bool overlapsPending(const s3d::Rect& bounds, const s3d::Rect& pendingBounds) const
+    {
+        if (!bounds.intersects(pendingBounds)) return false;
+        for (const s3d::uint32 i : mPending)
+            if (bounds.intersects(mEntries[i].bounds)) return true;
+        return false;
+    }
+
+
+
+    // 【内部メソッド】2つの矩形を含む矩形（空の矩形は無視する）
+    static s3d::Rect unionRect(const s3d::Rect& a, const s3d::Rect& b)
+    {
+        if ((a.w <= 0) || (a.h <= 0)) return b;
+        if ((b.w <= 0) || (b.h <= 0)) return a;
+        const s3d::int32 left   = std::min(a.x, b.x);
+        const s3d::int32 top    = std::min(a.y, b.y);
+        const s3d::int32 right  = std::max(a.x + a.w, b.x + b.w);
+        const s3d::int32 bottom = std::max(a.y + a.h, b.y + b.h);
+        return s3d::Rect(left, top, right - left, bottom - top);
+    }
+
+
+
+    // 【内部メソッド】mImgが古ければ、レンダーテクスチャから読み戻す
+    void syncImage()
+    {
+        if (!mImgStale) return;
+        s3d::Graphics2D::Flush();
+        mTarget.readAsImage(mBoard->mImg);
+        mBoard->markDirtyAll();
+        mImgStale = false;
+    }
+
+
+
+    // 【内部メソッド】記録のfirstからlastの手前までのうち、GPUで描く線分を描く
+    // 線分表を転送し、線分ごとに四角形をドローする（頂点の色のr, gに線分の番号、b, aに頂点の位置を入れる）
+    void drawGpu(size_t first, size_t last)
+    {
+        using Kind = kotsubu_detail::GpuLineEntry::Kind;
+        using namespace kotsubu_detail;
+        size_t count = 0;
+        for (size_t i = first; i < last; ++i)
+            if (mEntries[i].kind == Kind::Gpu) ++count;
+        if (count == 0) return;
+
+        // 線分表（足りなければ2倍の行数で作り直す）
+        const s3d::int32 rows = static_cast<s3d::int32>((count + GpuLinesPerRow - 1) / GpuLinesPerRow);
+        if (mTable.height() < rows) {
+            const s3d::int32 capacity = std::max(rows, mTable.height() * 2);
+            mTable    = s3d::Image(static_cast<size_t>(GpuLineTableWidth), static_cast<size_t>(capacity));
+            mTableTex = s3d::DynamicTexture(static_cast<size_t>(GpuLineTableWidth), static_cast<size_t>(capacity));
+        }
+        size_t index = 0;
+        for (size_t i = first; i < last; ++i) {
+            const GpuLineEntry& g = mEntries[i];
+            if (g.kind != Kind::Gpu) continue;
+            s3d::Color* row = mTable[index / GpuLinesPerRow] + (index % GpuLinesPerRow) * GpuLineWords;
+            for (s3d::uint32 w = 0; w < GpuLineWords; ++w)
+                row[w] = s3d::Color(static_cast<s3d::uint8>(g.words[w]),       static_cast<s3d::uint8>(g.words[w] >> 8),
+                                    static_cast<s3d::uint8>(g.words[w] >> 16), static_cast<s3d::uint8>(g.words[w] >> 24));
+            ++index;
+        }
+        mTableTex.fillRegion(mTable, s3d::Rect(0, 0, GpuLineTableWidth, rows));
+
+        {
+            const s3d::ScopedRenderTarget2D   target(mTarget);
+            const s3d::ScopedRenderStates2D   states(s3d::BlendState::Opaque, s3d::RasterizerState::SolidCullNone);
+            const s3d::ScopedCustomShader2D   shader(mShader);
+            s3d::Graphics2D::SetPSTexture(1, mTableTex);
+            index = 0;
+            for (size_t i = first; i < last; ++i) {
+                const GpuLineEntry& g = mEntries[i];
+                if (g.kind != Kind::Gpu) continue;
+                const double lo = static_cast<double>(index & 0xFFF), hi = static_cast<double>(index >> 12);
+                auto vertexColor = [lo, hi](const s3d::Vec2& p) { return s3d::ColorF(lo, hi, p.x, p.y); };
+                s3d::Quad(g.quad[0], g.quad[1], g.quad[2], g.quad[3])
+                    .draw(vertexColor(g.quad[0]), vertexColor(g.quad[1]), vertexColor(g.quad[2]), vertexColor(g.quad[3]));
+                ++index;
+            }
+        }
+
+        // 線分表は次の区間で書き換えるので、ここでGPUに送り切る
+        s3d::Graphics2D::Flush();
+        mImgStale = true;
+    }
+};
@@ -0,0 +1,1774 @@
+/**************************************************************************************************
+【ヘッダオンリー】kotsubu_line_renderer v1.0
+
+・概要
+ブレゼンハムの線分アルゴリズムによるレンダリング関数群（OpenSiv3D v0.6以降専用）
+s3d::Image、またはKotsubuPixelBoardに対して書き込む。
+オリジナル要素 --- 終点から始点に向かって描画, 疑似アンチエイリアシング, アルファ減衰（グラデーション）
+より正確なアンチエイリアシングとして、Xiaolin Wuのアルゴリズムも選べる（renderLineWu）。
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_line_renderer.h"
+renderLine(board.mImg, startPos, endPos, ColorF(1.0));          // イメージに線分を描く（変更範囲の通知はしない）
+renderDecayLine(board, startPos, endPos, ColorF(1.0), 0.5);     // ボード版は変更範囲をボードに通知する
+renderDecayLine(board, startPos, endPos, Color(255), 0.5);      // 整数版（s3d::Color）は1点ごとの変換が無く速い
+renderLine(board, Point(-999, 10), Point(100, 20), Color(255)); // 端点は範囲外でもよい（見えている部分だけ描く）
+renderLineAA(board, startPos, endPos, Color(255), 0.3, BlendMode::Additive);  // 書き込み先と加算合成する
+s3d::Array<LineSegment> segments;                               // 大量の線分はまとめて描く
+segments << LineSegment{ startPos, endPos, ColorF(1.0), LineMode::AA };
+renderLines(board, segments);
+renderLineWu(board, startPos, endPos, Color(255));              // Xiaolin Wuのアンチエイリアシング（小数の位置で濃淡を付ける）
+renderDecayLineWu(board, startPos, endPos, Color(255), 0.5);    // Wuの線分も減衰できる
+FixedPoint subPos = toFixedPoint(board.toImagePosF(Cursor::PosF()));  // サブピクセルの端点（24.8固定小数点）
+renderLineWu(board, startPos, subPos, Color(255));              // 端点が1ドット未満で動いても、なめらかに動く
+
+〇 ブレゼンハムの考え方。Bresenham's line algorithm
+x（またはy）を基準として、1ドット移動したとき、y（またはx）も移動するかどうかを判定しながら進む。
+基本的にすべて整数演算で高速。
+
+〇 フロー（底辺 >= 高さ のとき。初期位置は終点）
+1. 現在位置に点を描画
+2. 現在位置xが始点xなら終了
+3. xを「1ドット」移動
+4. yも移動するかどうか
+     ・水平(高さ0)       --- 移動しなくてよい
+     ・25度(底辺2:高さ1) --- xが2進んだタイミングで移動すればよい
+     ・45度(底辺1:高さ1) --- xと同じタイミングで移動すればよい
+     ・それを超える角度  --- x=1の移動に対しy=1を超える（離散的）なので別処理とする
+   上記を判定する
+     ・e += 高さ             // 誤差を蓄積
+     ・もし（e >= 底辺）なら
+           yを1移動
+           e -= 底辺         // 誤差をリセット。超過分を残すのがミソ
+5. 上記1.へ
+
+〇 補足
+eの初期値は四捨五入を期待して「底辺/2」とする。しかし、
+eを小数型にすると演算が遅くなり、整数型に代入すれば誤差が出る。そこで、
+関連するパラメータを2倍して扱うことで「整数演算かつ誤差無し」にできる。
+＜注意＞ ここで言う誤差とは計算の誤差のことであり、ブレゼンハムアルゴリズムの
+主要パラメータの「誤差」とは別物。ちなみに、誤差の英訳はerror、eはその略
+サブピクセルの端点（FixedPoint）では、eの初期値が「底辺/2」ではなく端点の小数部分から決まる。
+底辺と高さを1/256ドット単位のまま（さらに256倍して）扱うので、やはり整数演算かつ誤差無しになる。
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include <array>
+#include <utility>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_simd.h"
+#include "kotsubu_blend.h"
+
+
+
+// 【型】24.8固定小数点の座標（1/256ドット単位。サブピクセルの端点用）
+// イメージ座標で点(x, y)が受け持つ範囲は[x, x + 1)なので、点の中心は(x * 256 + 128, y * 256 + 128)になる。
+// s3d::Pointからは点の中心になり、中心にある端点は整数の座標とまったく同じ結果になる。座標は±2^20ドット以内とする
+struct FixedPoint
+{
+    s3d::int32 x;
+    s3d::int32 y;
+
+    FixedPoint() = default;
+    constexpr FixedPoint(s3d::int32 fixedX, s3d::int32 fixedY) : x(fixedX), y(fixedY) {}
+    constexpr FixedPoint(s3d::Point pos) : x(pos.x * 256 + 128), y(pos.y * 256 + 128) {}
+
+    // 含まれる点
+    constexpr s3d::Point asPoint() const { return s3d::Point(x >> 8, y >> 8); }
+
+    // 点の中心にあるか
+    constexpr bool isCentered() const { return (x & 255) == 128 && (y & 255) == 128; }
+
+    constexpr bool operator==(const FixedPoint& other) const { return x == other.x && y == other.y; }
+    constexpr bool operator!=(const FixedPoint& other) const { return !(*this == other); }
+};
+
+
+
+// 【関数】イメージ座標（小数。KotsubuPixelBoard::toImagePosF()など）を24.8固定小数点にする（1/256ドット未満は切り捨て）
+inline FixedPoint toFixedPoint(s3d::Vec2 imagePos)
+{
+    return FixedPoint(static_cast<s3d::int32>(std::floor(imagePos.x * 256.0)),
+                      static_cast<s3d::int32>(std::floor(imagePos.y * 256.0)));
+}
+
+
+
+// 【型】線分の種類（バッチ描画用）。いずれも整数版（s3d::Color）と同じ結果になる
+// Line  --- renderLine()と同じ
+// AA    --- renderLineAA()と同じ
+// Decay --- renderDecayLine()と同じ
+// Wu      --- renderLineWu()と同じ
+// WuDecay --- renderDecayLineWu()と同じ（aaColorRateは使わない）
+enum class LineMode { Line, AA, Decay, Wu, WuDecay };
+
+
+
+// 【型】バッチ描画用の線分。端点はs3d::Pointでも、サブピクセル（FixedPoint）でもよい
+struct LineSegment
+{
+    FixedPoint  startPos;
+    FixedPoint  endPos;
+    s3d::ColorF col;
+    LineMode    mode             = LineMode::Line;
+    double      decaySectionRate = 0.5;  // LineMode::Decay, LineMode::WuDecayのときだけ使う
+    double      aaColorRate      = 0.3;  // LineMode::AA, LineMode::Decayのときだけ使う
+    BlendMode   blend            = BlendMode::Overwrite;
+};
+
+
+
+namespace kotsubu_detail
+{
+    // 【内部型】線分ごとの前準備の結果
+    // 誤差は「基準軸を1ドット進むたびにeIncを足し、eMax以上になったらもう一方の軸を移動してeMaxを引く」。
+    // 整数の端点ならe0 = 底辺、eInc = 高さ*2、eMax = 底辺*2（四捨五入のための2倍）。
+    // サブピクセルの端点では、e0に端点の小数部分が入る（描く点は始点と終点の点まで。startPos, endPos）
+    struct LineSetup
+    {
+        s3d::Point startPos;  // 始点の点
+        s3d::Point endPos;    // 終点の点
+        s3d::Point dist;      // xとyそれぞれの距離（絶対値。基準軸はステップの数、もう一方の軸は移動の回数）
+        s3d::Point step;      // 進むべき方向（正負）
+        bool       xMajor;    // x基準か
+        s3d::int64 e0;        // 誤差の初期値（0 <= e0 < eMax）
+        s3d::int64 eInc;      // 1ステップごとに蓄積する誤差
+        s3d::int64 eMax;      // 誤差の閾値
+    };
+
+
+
+    // 【内部関数】線分の前準備
+    inline LineSetup makeLineSetup(s3d::Point startPos, s3d::Point endPos)
+    {
+        LineSetup ls;
+        ls.startPos = startPos;
+        ls.endPos   = endPos;
+        // xとyそれぞれの、距離（絶対値）と進むべき方向（正負）を求める
+        if (endPos.x >= startPos.x)
+            { ls.dist.x = endPos.x - startPos.x; ls.step.x = -1; }
+        else
+            { ls.dist.x = startPos.x - endPos.x; ls.step.x = 1; }
+        if (endPos.y >= startPos.y)
+            { ls.dist.y = endPos.y - startPos.y; ls.step.y = -1; }
+        else
+            { ls.dist.y = startPos.y - endPos.y; ls.step.y = 1; }
+        // 誤差の判定時に四捨五入する、かつ整数で扱うため、関連パラメータを2倍する
+        ls.xMajor = ls.dist.x >= ls.dist.y;
+        ls.e0     = ls.xMajor ? ls.dist.x : ls.dist.y;
+        ls.eInc   = 2 * s3d::int64(ls.xMajor ? ls.dist.y : ls.dist.x);
+        ls.eMax   = 2 * ls.e0;
+        return ls;
+    }
+
+
+
+    // 【内部関数】切り捨ての除算（denは正）
+    inline s3d::int64 floorDiv(s3d::int64 num, s3d::int64 den)
+    {
+        const s3d::int64 q = num / den;
+        return (num % den < 0) ? q - 1 : q;
+    }
+
+
+
+    // 【内部関数】線分の前準備（サブピクセルの端点）
+    // 基準軸は、端点を含む点から点までをステップとする。もう一方の軸は、各ステップの点の中心での理想直線の位置を
+    // 含む点に描く（ちょうど境目なら始点側。整数の端点と同じ）。進む向きを正とした座標で考えると、
+    // 終点の点からの移動の回数は「(端点の小数部分から決まる初期値 + k * 高さ) / 底辺」（切り捨て）になる。
+    // 誤差は1/256ドット単位の底辺と高さをさらに256倍して、丸めずに持つ
+    inline LineSetup makeLineSetup(const FixedPoint& startPos, const FixedPoint& endPos)
+    {
+        // 点の中心にある端点は、整数の前準備と同じ（座標の範囲も広い）
+        if (startPos.isCentered() && endPos.isCentered()) return makeLineSetup(startPos.asPoint(), endPos.asPoint());
+
+        LineSetup ls;
+        ls.xMajor = std::abs(s3d::int64(startPos.x) - endPos.x) >= std::abs(s3d::int64(startPos.y) - endPos.y);
+        const s3d::int64 endMaj   = ls.xMajor ? endPos.x   : endPos.y;
+        const s3d::int64 endMin   = ls.xMajor ? endPos.y   : endPos.x;
+        const s3d::int64 startMaj = ls.xMajor ? startPos.x : startPos.y;
+        const s3d::int64 startMin = ls.xMajor ? startPos.y : startPos.x;
+        const s3d::int32 stepMaj  = (startMaj > endMaj) ? 1 : -1;
+        const s3d::int32 stepMin  = (startMin > endMin) ? 1 : -1;
+        const s3d::int64 dMaj     = std::abs(startMaj - endMaj);  // 1/256ドット単位
+        const s3d::int64 dMin     = std::abs(startMin - endMin);
+
+        // 基準軸。終点を含む点の中心までの、進む向きの距離（-128～128）
+        const s3d::int64 endMajPos   = floorDiv(endMaj, 256);
+        const s3d::int64 startMajPos = floorDiv(startMaj, 256);
+        const s3d::int64 t0          = (endMajPos * 256 + 128 - endMaj) * stepMaj;
+
+        // もう一方の軸（進む向きを正とした座標）。終点の点の中心での位置から、誤差の初期値を求める
+        const s3d::int64 endS   = endMin * stepMin;
+        s3d::int64       minPos = floorDiv(endS, 256);
+        const s3d::int64 eInc   = dMin * 256;
+        const s3d::int64 eMax   = dMaj * 256;
+        s3d::int64       e0     = 0;
+        if (dMaj > 0) {
+            e0 = (endS - minPos * 256) * dMaj + t0 * dMin;
+            const s3d::int64 carry = floorDiv(e0, eMax);  // 終点の点そのものが隣にずれる分
+            minPos += carry;
+            e0     -= carry * eMax;
+        }
+        const s3d::int64 steps = (startMajPos - endMajPos) * stepMaj;
+        const s3d::int64 moves = (dMaj > 0) ? (e0 + steps * eInc) / eMax : 0;
+
+        const s3d::int32 endMinPos   = static_cast<s3d::int32>((stepMin > 0) ? minPos : -minPos - 1);
+        const s3d::int32 startMinPos = endMinPos + static_cast<s3d::int32>(moves) * stepMin;
+        ls.endPos   = ls.xMajor ? s3d::Point(static_cast<s3d::int32>(endMajPos), endMinPos)
+                                : s3d::Point(endMinPos, static_cast<s3d::int32>(endMajPos));
+        ls.startPos = ls.xMajor ? s3d::Point(static_cast<s3d::int32>(startMajPos), startMinPos)
+                                : s3d::Point(startMinPos, static_cast<s3d::int32>(startMajPos));
+        ls.dist     = ls.xMajor ? s3d::Point(static_cast<s3d::int32>(steps), static_cast<s3d::int32>(moves))
+                                : s3d::Point(static_cast<s3d::int32>(moves), static_cast<s3d::int32>(steps));
+        ls.step     = ls.xMajor ? s3d::Point(stepMaj, stepMin) : s3d::Point(stepMin, stepMaj);
+        ls.e0       = e0;
+        ls.eInc     = eInc;
+        ls.eMax     = eMax;
+        return ls;
+    }
+
+
+
+    // 【内部定数】減衰の固定小数点（アルファを0～255の16.16固定小数点で扱う）
+    constexpr s3d::uint32 AlphaShift = 16;
+
+
+
+    // 【内部関数】疑似AA部分の割合を16bit固定小数点にする（0～65536）。rateはクランプ済みであること
+    inline s3d::uint32 toFixedRate(double rate)
+    {
+        return static_cast<s3d::uint32>(rate * 65536.0 + 0.5);
+    }
+
+
+
+    // 【内部関数】固定小数点のアルファを8bitにする（四捨五入）
+    inline s3d::uint8 fixedAlpha(s3d::uint32 alpha)
+    {
+        return static_cast<s3d::uint8>((alpha + (1u << (AlphaShift - 1))) >> AlphaShift);
+    }
+
+
+
+    // 【内部関数】固定小数点のアルファに疑似AAの割合を掛けて8bitにする（四捨五入）
+    inline s3d::uint8 fixedAAAlpha(s3d::uint32 alpha, s3d::uint32 aaRate)
+    {
+        return static_cast<s3d::uint8>((static_cast<s3d::uint64>(alpha) * aaRate + (1ull << 31)) >> 32);
+    }
+
+
+
+    // 【内部関数】割合を0.0～1.0に収める
+    inline double clampRate(double rate)
+    {
+        if (rate < 0.0) rate = 0.0;
+        if (rate > 1.0) rate = 1.0;
+        return rate;
+    }
+
+
+
+    // 【内部関数】点を描く（範囲の確認はしない）
+    // 上書き以外は、8bitに変換してから書き込み先と合成する（Color版と同じ合成になる）
+    template <BlendMode Blend, class ColorType>
+    inline void plot(s3d::Image& img, s3d::int32 x, s3d::int32 y, const ColorType& col)
+    {
+        KOTSUBU_BOARD_STATS_WRITTEN(1);
+        if (Blend == BlendMode::Overwrite) img[y][x].set(col);
+        else                               blendPixel<Blend>(img[y][x], s3d::Color(col));
+    }
+
+
+
+    // 【内部関数】線分がイメージに掛からないことが明らかか（両端が同じ側の外にある。疑似AAの点も外接矩形の中にある）
+    inline bool outsideImage(const s3d::Image& img, s3d::Point startPos, s3d::Point endPos)
+    {
+        return (startPos.x < 0 && endPos.x < 0) || (startPos.x >= img.width()  && endPos.x >= img.width()) ||
+               (startPos.y < 0 && endPos.y < 0) || (startPos.y >= img.height() && endPos.y >= img.height());
+    }
+
+
+
+    // 【内部型】八分円（基準軸と、x, yの進む向き）。カーネルのテンプレート引数にして、向きを定数にする
+    // bit0 --- y基準なら1
+    // bit1 --- xが負の向きに進むなら1
+    // bit2 --- yが負の向きに進むなら1
+    enum class Octant : s3d::uint8 {};
+
+    constexpr bool       octantXMajor(Octant o) { return (static_cast<s3d::uint8>(o) & 1) == 0; }
+    constexpr s3d::int32 octantStepX(Octant o)  { return (static_cast<s3d::uint8>(o) & 2) ? -1 : 1; }
+    constexpr s3d::int32 octantStepY(Octant o)  { return (static_cast<s3d::uint8>(o) & 4) ? -1 : 1; }
+
+    inline Octant octantOf(const LineSetup& ls)
+    {
+        return static_cast<Octant>((ls.xMajor ? 0 : 1) | ((ls.step.x < 0) ? 2 : 0) | ((ls.step.y < 0) ? 4 : 0));
+    }
+
+
+
+    // ◎◎ ラン単位で書く実装（Color版とバッチ描画が使う）
+    // 【内部型】クリップ矩形（両端を含む）
+    struct ClipRect
+    {
+        s3d::int32 left;
+        s3d::int32 top;
+        s3d::int32 right;
+        s3d::int32 bottom;
+    };
+
+
+
+    // 【内部関数】イメージ全体のクリップ矩形（s3d::ImageとKotsubuImage8）
+    template <class Surface>
+    inline ClipRect imageClip(const Surface& img)
+    {
+        return ClipRect{ 0, 0, img.width() - 1, img.height() - 1 };
+    }
+
+
+
+    // 【内部型】疎なイメージ（KotsubuSparseImage）の1つのタイルを、イメージ座標のまま[y][x]で書く面
+    // クリップ矩形をタイルの範囲にして使う（タイルの外の点には書かない）
+    struct SparseTile
+    {
+        s3d::Color* pixels;  // タイルの先頭
+        s3d::int32  left;    // タイルの左上（イメージ座標）
+        s3d::int32  top;
+
+        struct Row
+        {
+            s3d::Color* p;
+            s3d::int32  left;
+            s3d::Color& operator[](s3d::int32 x) const { return p[x - left]; }
+        };
+
+        Row operator[](s3d::int32 y) const
+        {
+            return Row{ pixels + static_cast<std::ptrdiff_t>(y - top) * KotsubuSparseImage::TileSize, left };
+        }
+    };
+
+
+
+    // 【内部関数】縦に1ドット進むときの、点のポインタの移動量
+    inline std::ptrdiff_t rowAdvance(const s3d::Image& img)   { return img.width(); }
+    inline std::ptrdiff_t rowAdvance(const KotsubuImage8& img) { return img.stride(); }
+    inline std::ptrdiff_t rowAdvance(const SparseTile&)        { return KotsubuSparseImage::TileSize; }
+    inline std::ptrdiff_t rowAdvance(const KotsubuImageView& img) { return static_cast<std::ptrdiff_t>(img.stride()); }
+
+
+
+    // 【内部型】イメージの点の型（s3d::Image、SparseTile、KotsubuImageViewならs3d::Color、KotsubuImage8ならs3d::uint8）
+    template <class Surface>
+    using PixelOf = std::remove_reference_t<decltype(std::declval<Surface&>()[0][0])>;
+
+
+
+    // 【内部関数】上書きする点の値（s3d::Colorの点はそのまま、8bitの点はアルファ）
+    template <class Pixel>
+    inline Pixel pixelValue(const s3d::Color& col)
+    {
+        if constexpr (std::is_same_v<Pixel, s3d::uint8>) return col.a;
+        else                                             return col;
+    }
+
+
+
+    // 【内部関数】点がクリップ矩形の中にあるか
+    inline bool inClip(const ClipRect& clip, s3d::Point pos)
+    {
+        return (pos.x >= clip.left) && (pos.x <= clip.right) && (pos.y >= clip.top) && (pos.y <= clip.bottom);
+    }
+
+
+
+    // 【内部関数】正の数どうしの切り上げ除算
+    inline s3d::int64 ceilDiv(s3d::int64 num, s3d::int64 den)
+    {
+        return (num + den - 1) / den;
+    }
+
+
+
+    // 【内部型】ステップの範囲（両端を含む。first > lastなら空）
+    // ステップとは、終点を0、始点を「底辺（y基準なら高さ）」として、終点から数えた点の番号のこと
+    struct StepRange
+    {
+        s3d::int64 first;
+        s3d::int64 last;
+    };
+
+
+
+    // 【内部関数】クリップ矩形に掛かるステップの範囲を求める（Cohen-Sutherlandのように端点を動かすのではなく、
+    // ブレゼンハムの式から直接求めるので、描かれる点は1点ずつ進めた場合とまったく同じになる）
+    // ・基準軸の位置は「終点 + k * 方向」なので、範囲は引き算だけで決まる
+    // ・もう一方の軸の移動回数は「(e0 + k * eInc) / eMax」（切り捨て。整数の端点なら(底辺 + k * 高さ*2) / (底辺*2)）
+    //   なので、範囲は除算2回で決まる
+    // 疑似AAの点は線分の点の隣にあるので、矩形を1ドット広げて求める（はみ出た点はラン単位で除く）
+    template <bool XMajor>
+    inline StepRange visibleSteps(const LineSetup& ls, const ClipRect& clip)
+    {
+        const s3d::int64 endMaj  = XMajor ? ls.endPos.x  : ls.endPos.y;
+        const s3d::int64 endMin  = XMajor ? ls.endPos.y  : ls.endPos.x;
+        const s3d::int32 stepMaj = XMajor ? ls.step.x    : ls.step.y;
+        const s3d::int32 stepMin = XMajor ? ls.step.y    : ls.step.x;
+        const s3d::int64 dMaj    = XMajor ? ls.dist.x    : ls.dist.y;
+        const s3d::int64 majLo   = (XMajor ? clip.left   : clip.top)    - 1;
+        const s3d::int64 majHi   = (XMajor ? clip.right  : clip.bottom) + 1;
+        const s3d::int64 minLo   = (XMajor ? clip.top    : clip.left)   - 1;
+        const s3d::int64 minHi   = (XMajor ? clip.bottom : clip.right)  + 1;
+
+        // 基準軸
+        StepRange r{ 0, dMaj };
+        if (stepMaj > 0) { r.first = std::max(r.first, majLo - endMaj); r.last = std::min(r.last, majHi - endMaj); }
+        else             { r.first = std::max(r.first, endMaj - majHi); r.last = std::min(r.last, endMaj - majLo); }
+
+        // もう一方の軸（移動回数mの範囲に直してから、mがその範囲に入るkを求める）
+        const s3d::int64 mLo = (stepMin > 0) ? minLo - endMin : endMin - minHi;
+        const s3d::int64 mHi = (stepMin > 0) ? minHi - endMin : endMin - minLo;
+        if (ls.eInc == 0) {
+            // 水平（垂直）線と点は m = 0 のまま
+            if (mLo > 0 || mHi < 0) r.last = -1;
+            return r;
+        }
+        if (mHi < 0) { r.last = -1; return r; }
+        if (mLo > 0) r.first = std::max(r.first, ceilDiv(mLo * ls.eMax - ls.e0, ls.eInc));
+        r.last = std::min(r.last, ceilDiv((mHi + 1) * ls.eMax - ls.e0, ls.eInc) - 1);
+        return r;
+    }
+
+
+
+    // 【内部関数】ステップkの点の位置（1点ずつ進めた場合と同じ）
+    template <bool XMajor>
+    inline s3d::Point stepPos(const LineSetup& ls, s3d::int64 k)
+    {
+        const s3d::int64 m     = (ls.eMax == 0) ? 0 : (ls.e0 + k * ls.eInc) / ls.eMax;
+        const s3d::int32 maj   = static_cast<s3d::int32>((XMajor ? ls.endPos.x : ls.endPos.y) + k * (XMajor ? ls.step.x : ls.step.y));
+        const s3d::int32 sub   = static_cast<s3d::int32>((XMajor ? ls.endPos.y : ls.endPos.x) + m * (XMajor ? ls.step.y : ls.step.x));
+        return XMajor ? s3d::Point(maj, sub) : s3d::Point(sub, maj);
+    }
+
+
+
+    // 【内部関数】クリップ矩形の中で線分が通るxの範囲（疑似AAの点を含む）。通らなければfalse
+    // ステップの範囲は疑似AAの分だけ広げてあり、xは範囲の両端で最小と最大になる（単調に進むため）
+    // wideならWuの線分として求める（Wuの点はブレゼンハムの点から、もう一方の軸に1ドットはみ出すことがある）
+    inline bool clipXRange(const LineSetup& ls, const ClipRect& clip, s3d::int32& lo, s3d::int32& hi,
+                           bool wide = false)
+    {
+        const bool xMajor = ls.xMajor;
+        const StepRange r = xMajor ? visibleSteps<true>(ls, clip) : visibleSteps<false>(ls, clip);
+        if (r.first > r.last) return false;
+
+        const s3d::int32 x0 = xMajor ? stepPos<true>(ls, r.first).x : stepPos<false>(ls, r.first).x;
+        const s3d::int32 x1 = xMajor ? stepPos<true>(ls, r.last).x  : stepPos<false>(ls, r.last).x;
+        const s3d::int32 margin = wide ? 1 : 0;
+        lo = std::max(std::min(x0, x1) - margin, clip.left);
+        hi = std::min(std::max(x0, x1) + margin, clip.right);
+        return lo <= hi;
+    }
+
+
+
+    // 【内部型】ランの書き込み方。単色（塗りつぶし）
+    // Pixelは書き込み先の点の型（8bitの点には色のアルファを書く）
+    template <BlendMode Blend, class Pixel = s3d::Color>
+    struct SolidRunWriter
+    {
+        s3d::Color col;
+        s3d::Color aaCol;
+
+        // pからadvance個おきにcount個の点を書く（横のランはまとめて塗りつぶし）
+        // 合成する場合は、乗算済みアルファの色をランごとに1回だけ求める
+        void run(Pixel* p, std::ptrdiff_t advance, s3d::int32 count)
+        {
+            KOTSUBU_BOARD_STATS_WRITTEN(count);
+            if (Blend == BlendMode::Overwrite) {
+                const Pixel v = pixelValue<Pixel>(col);
+                if      (advance ==  1) std::fill_n(p, count, v);
+                else if (advance == -1) std::fill_n(p - (count - 1), count, v);
+                else for (; count > 0; --count, p += advance) *p = v;
+            }
+            else if constexpr (std::is_same_v<Pixel, s3d::Color>) {
+                const PremulColor src = premultiply(col);
+                for (; count > 0; --count, p += advance)
+                    blendPremul<Blend>(*p, src, col);
+            }
+            else {
+                for (; count > 0; --count, p += advance)
+                    blendPixel<Blend>(*p, col);
+            }
+        }
+
+        // クリップされたcount個の点を飛ばす
+        void skip(s3d::int64) {}
+
+        // 疑似AAの点を書く
+        void aa(Pixel& dst) const { KOTSUBU_BOARD_STATS_WRITTEN(1); blendPixel<Blend>(dst, aaCol); }
+    };
+
+
+
+    // 【内部型】ランの書き込み方。アルファ減衰
+    // 最初の点は元のアルファで、以降は1点ごとにフェード量だけ減らす（16.16固定小数点）。
+    // フェード量は切り捨てなので、減衰区間の最後でもアルファは負にならない。
+    // アルファのグラデーションはSIMDでまとめて作る（kotsubu_simd.h。横のランはそのまま格納、縦のランは分けて格納）。
+    // 合成する場合と、8bitの点に書く場合は1点ずつ書く
+    template <BlendMode Blend, class Pixel = s3d::Color>
+    struct DecayRunWriter
+    {
+        s3d::Color  col;
+        s3d::uint32 alpha;         // 次に書く点のアルファ
+        s3d::uint32 alphaFadeVol;  // アルファのフェード量
+        s3d::uint32 aaRate;        // 疑似AA部分の割合（16bit固定小数点）
+        s3d::int64  hold;          // 書かずに飛ばす先頭の点の数（単色区間と重なる分割点を二重に合成しないため）
+
+        void run(Pixel* p, std::ptrdiff_t advance, s3d::int32 count)
+        {
+            if (hold > 0) {
+                const s3d::int32 n = static_cast<s3d::int32>(std::min<s3d::int64>(hold, count));
+                p     += advance * n;
+                count -= n;
+                alpha -= alphaFadeVol * n;
+                hold  -= n;
+                if (count == 0) return;
+            }
+
+            KOTSUBU_BOARD_STATS_WRITTEN(count);
+            if constexpr (Blend != BlendMode::Overwrite || std::is_same_v<Pixel, s3d::uint8>) {
+                for (s3d::int32 i = 0; i < count; ++i, p += advance)
+                    blendPixel<Blend>(*p, s3d::Color(col, fixedAlpha(alpha - alphaFadeVol * i)));
+                alpha -= alphaFadeVol * count;
+            }
+            else {
+                ramp(p, advance, count);
+            }
+        }
+
+        // クリップされたcount個の点を飛ばす（アルファは書いた場合と同じだけ減らす）
+        void skip(s3d::int64 count)
+        {
+            alpha -= alphaFadeVol * static_cast<s3d::uint32>(count);
+            hold   = std::max<s3d::int64>(hold - count, 0);
+        }
+
+        // 疑似AAの点を書く（次に書く点のアルファに合わせる）
+        void aa(Pixel& dst) const
+        {
+            KOTSUBU_BOARD_STATS_WRITTEN(1);
+            blendPixel<Blend>(dst, s3d::Color(col, fixedAAAlpha(alpha, aaRate)));
+        }
+
+        // 上書きのグラデーションをSIMDで書く（s3d::Colorの点のみ）
+        void ramp(s3d::Color* p, std::ptrdiff_t advance, s3d::int32 count)
+        {
+            const s3d::int32  a    = static_cast<s3d::int32>(alpha);
+            const s3d::int32  fade = static_cast<s3d::int32>(alphaFadeVol);
+            const s3d::uint32 rgb  = toRGBBits(col);
+
+            if (advance == 1) {
+                alphaRamp()(p, count, rgb, a, -fade);
+            }
+            else if (advance == -1) {
+                // アドレスの小さい方が後に書く点（アルファが小さい）
+                alphaRamp()(p - (count - 1), count, rgb, a - fade * (count - 1), fade);
+            }
+            else if (count < 8) {
+                for (s3d::int32 i = 0; i < count; ++i, p += advance)
+                    *p = s3d::Color(col, fixedAlpha(alpha - alphaFadeVol * i));
+            }
+            else {
+                // 縦のランは、一時領域にまとめて作ってから1行おきに格納する
+                s3d::Color block[16];
+                for (s3d::int32 done = 0; done < count; done += 16) {
+                    const s3d::int32 n = std::min<s3d::int32>(16, count - done);
+                    alphaRamp()(block, n, rgb, a - fade * done, -fade);
+                    for (s3d::int32 i = 0; i < n; ++i, p += advance)
+                        *p = block[i];
+                }
+            }
+            alpha -= alphaFadeVol * count;
+        }
+    };
+
+
+
+    // 【内部関数】疑似AAの点を書く（Clippedならクリップ矩形の外の点は書かない）
+    template <bool Clipped, class Writer, class Surface>
+    inline void writeAA(Surface& img, const ClipRect& clip, s3d::int32 x, s3d::int32 y, const Writer& writer)
+    {
+        if (Clipped && !inClip(clip, s3d::Point(x, y))) return;
+        writer.aa(img[y][x]);
+    }
+
+
+
+    // 【内部関数】ランを1つ書く（Clippedならクリップ矩形の外の点は飛ばす）
+    // ランのi番目の点の位置は、基準軸が「majPos + i * 基準軸の向き」、もう一方の軸がminPos
+    template <Octant O, bool Clipped, class Writer, class Surface>
+    inline void writeRun(Surface& img, const ClipRect& clip, s3d::int32 majPos, s3d::int32 minPos,
+                         std::ptrdiff_t advance, s3d::int64 count, Writer& writer)
+    {
+        constexpr bool       XMajor  = octantXMajor(O);
+        constexpr s3d::int32 stepMaj = XMajor ? octantStepX(O) : octantStepY(O);
+        s3d::int64 iA = 0, iB = count - 1;
+        if (Clipped) {
+            const s3d::int32 majLo = XMajor ? clip.left   : clip.top;
+            const s3d::int32 majHi = XMajor ? clip.right  : clip.bottom;
+            const s3d::int32 minLo = XMajor ? clip.top    : clip.left;
+            const s3d::int32 minHi = XMajor ? clip.bottom : clip.right;
+            if (minPos < minLo || minPos > minHi) { writer.skip(count); return; }
+
+            if (stepMaj > 0) { iA = std::max<s3d::int64>(iA, majLo - majPos); iB = std::min<s3d::int64>(iB, majHi - majPos); }
+            else             { iA = std::max<s3d::int64>(iA, majPos - majHi); iB = std::min<s3d::int64>(iB, majPos - majLo); }
+            if (iA > iB) { writer.skip(count); return; }
+            writer.skip(iA);
+        }
+
+        const s3d::int32 pos = majPos + static_cast<s3d::int32>(iA) * stepMaj;
+        PixelOf<Surface>* p = XMajor ? &img[minPos][pos] : &img[pos][minPos];
+        writer.run(p, advance, static_cast<s3d::int32>(iB - iA + 1));
+
+        if (Clipped) writer.skip(count - 1 - iB);
+    }
+
+
+
+    // 【内部関数】ラン単位で線分を書く。ステップkからkLastまで（両端を含む）
+    // 同じ行（列）に続く点の並び（ラン）の長さを求め、1行分をまとめて書く。
+    // ランの長さは「q = eMax / eInc（整数の端点なら底辺 / 高さ）」か「q + 1」のどちらかで、誤差と余りの比較だけで決まる（除算は最初だけ）。
+    // 開始位置と誤差はステップkから直接求めるので、クリップされた途中から始めても結果は1点ずつ進める場合と同じになる。
+    // 縦のランは1行分ずつ飛ばして書く
+    // 向きは八分円から決まる定数で、横のランなら書き込みの間隔も定数になる
+    template <Octant O, bool AA, bool Clipped, class Writer, class Surface>
+    inline void walkRuns(Surface& img, const LineSetup& ls, const ClipRect& clip,
+                         s3d::int64 k, s3d::int64 kLast, Writer& writer)
+    {
+        constexpr bool       XMajor  = octantXMajor(O);
+        constexpr s3d::int32 stepMaj = XMajor ? octantStepX(O) : octantStepY(O);
+        constexpr s3d::int32 stepMin = XMajor ? octantStepY(O) : octantStepX(O);
+        const s3d::int64 eMax    = ls.eMax;
+        const s3d::int64 eInc    = ls.eInc;
+        const std::ptrdiff_t advance = XMajor ? stepMaj : rowAdvance(img) * stepMaj;
+
+        // ステップkの位置と誤差
+        const s3d::int64 total     = ls.e0 + k * eInc;
+        const s3d::int64 m         = (eMax == 0) ? 0 : total / eMax;
+        s3d::int64       e         = (eMax == 0) ? 0 : total % eMax;
+        s3d::int32       majPos    = static_cast<s3d::int32>((XMajor ? ls.endPos.x : ls.endPos.y) + k * stepMaj);
+        s3d::int32       minPos    = static_cast<s3d::int32>((XMajor ? ls.endPos.y : ls.endPos.x) + m * stepMin);
+        s3d::int64       remaining = kLast - k;  // 現在位置より後の点の数
+
+        // 水平（垂直）線はランが1つだけ
+        if (eInc == 0) {
+            writeRun<O, Clipped>(img, clip, majPos, minPos, advance, remaining + 1, writer);
+            return;
+        }
+
+        const s3d::int64 q  = eMax / eInc;
+        const s3d::int64 rr = eMax % eInc;
+
+        // 最初のランの長さ（誤差が閾値に届くまでのステップ数）
+        s3d::int64 n = ceilDiv(eMax - e, eInc);
+        for (;;) {
+            // 終わりに届くなら、残りを書いて終了
+            if (n > remaining) {
+                writeRun<O, Clipped>(img, clip, majPos, minPos, advance, remaining + 1, writer);
+                return;
+            }
+
+            // ランを書いて、基準軸をラン1つ分移動
+            writeRun<O, Clipped>(img, clip, majPos, minPos, advance, n, writer);
+            majPos    += static_cast<s3d::int32>(n) * stepMaj;
+            e         += n * eInc - eMax;
+            remaining -= n;
+
+            // もう一方の軸を「1ドット」移動（前後に疑似AA）
+            if (AA) writeAA<Clipped>(img, clip, XMajor ? majPos : minPos, XMajor ? minPos : majPos, writer);
+            minPos += stepMin;
+            if (AA) writeAA<Clipped>(img, clip, XMajor ? majPos - stepMaj : minPos, XMajor ? minPos : majPos - stepMaj, writer);
+
+            // 次のランの長さ（移動した直後の誤差は 0 <= e < eInc）
+            n = q + ((e < rr) ? 1 : 0);
+        }
+    }
+
+
+
+    // 【内部関数】ステップの範囲を書く（clippedならクリップ付き）
+    template <Octant O, bool AA, class Writer, class Surface>
+    inline void walkSteps(Surface& img, const LineSetup& ls, const ClipRect& clip, bool clipped,
+                          s3d::int64 first, s3d::int64 last, Writer& writer)
+    {
+        if (first > last) return;
+        if (clipped) walkRuns<O, AA, true >(img, ls, clip, first, last, writer);
+        else         walkRuns<O, AA, false>(img, ls, clip, first, last, writer);
+    }
+
+
+
+    // 【内部関数】書くべきステップの範囲。両端がクリップ矩形の中なら全体、そうでなければクリップする
+    template <bool XMajor>
+    inline StepRange lineSteps(const LineSetup& ls, const ClipRect& clip, bool& clipped)
+    {
+        clipped = !(inClip(clip, ls.startPos) && inClip(clip, ls.endPos));
+        if (clipped) return visibleSteps<XMajor>(ls, clip);
+        return StepRange{ 0, XMajor ? ls.dist.x : ls.dist.y };
+    }
+
+
+
+    // 【内部関数】ラン単位のカーネル（整数版）。線分, 疑似AA付き, 減衰（疑似AA付き）のすべてをこれ1つで描く
+    // 減衰しなければ終点から始点まで単色。減衰するなら、終点から分割点までは単色、分割点から始点までは減衰する
+    // （分割点は単色側だけで書き、減衰側は書かずに飛ばす。ColorF版と同じく重複描画を避ける）。
+    // クリップされた区間は、減衰のアルファを書いた場合と同じだけ進めてから始める。
+    // decaySectionRateとaaRateは減衰するときだけ使う（クランプ済みであること）
+    template <Octant O, bool AA, bool Decay, BlendMode Blend, class Surface>
+    inline void runKernel(Surface& img, const LineSetup& ls, const ClipRect& clip,
+                          const s3d::Color& col, const s3d::Color& aaCol,
+                          double decaySectionRate = 0.0, s3d::uint32 aaRate = 0)
+    {
+        constexpr bool XMajor = octantXMajor(O);
+        bool clipped;
+        const StepRange r = lineSteps<XMajor>(ls, clip, clipped);
+        SolidRunWriter<Blend, PixelOf<Surface>> solid{ col, aaCol };
+        if constexpr (!Decay) {
+            walkSteps<O, AA>(img, ls, clip, clipped, r.first, r.last, solid);
+        }
+        else {
+            const s3d::int32 dist     = XMajor ? (ls.endPos.x - ls.startPos.x) : (ls.endPos.y - ls.startPos.y);
+            const s3d::int32 decayLen = dist * decaySectionRate;                  // 減衰区間の長さ
+            const s3d::int64 last     = std::abs(dist);                           // 始点のステップ
+            const s3d::int64 split    = last - std::abs(decayLen);                // 分割点のステップ
+
+            // ◎ 終点から分割点まで（通常のAA付き線分の処理）
+            walkSteps<O, true>(img, ls, clip, clipped, r.first, std::min(split, r.last), solid);
+            if (split == last) return;
+
+            // ◎ 分割点から始点まで（ここが減衰する）
+            const s3d::int64  first     = std::max(split, r.first);
+            const s3d::uint32 alpha     = static_cast<s3d::uint32>(col.a) << AlphaShift;
+            const s3d::uint32 alphaFade = alpha / (1 + std::abs(decayLen));
+            DecayRunWriter<Blend, PixelOf<Surface>> decay{ col, alpha - alphaFade * static_cast<s3d::uint32>(first - split), alphaFade,
+                                         aaRate, (first == split) ? 1 : 0 };
+            walkSteps<O, true>(img, ls, clip, clipped, first, r.last, decay);
+        }
+    }
+
+
+
+    // 【内部型】八分円ごとのラン単位のカーネルの関数表（八分円の番号順。書き込み先の型ごと）
+    template <class Surface>
+    using RunKernelFunc = void (*)(Surface&, const LineSetup&, const ClipRect&,
+                                   const s3d::Color&, const s3d::Color&, double, s3d::uint32);
+
+    template <bool AA, bool Decay, BlendMode Blend, class Surface, size_t... I>
+    constexpr std::array<RunKernelFunc<Surface>, 8> makeRunKernelTable(std::index_sequence<I...>)
+    {
+        return {{ runKernel<static_cast<Octant>(I), AA, Decay, Blend, Surface>... }};
+    }
+
+    template <bool AA, bool Decay, BlendMode Blend, class Surface>
+    inline constexpr auto runKernelTable = makeRunKernelTable<AA, Decay, Blend, Surface>(std::make_index_sequence<8>());
+
+
+
+    // 【内部関数】整数版の入口。八分円から、カーネルを選んで1回呼ぶ
+    template <bool AA, bool Decay, BlendMode Blend, class Surface>
+    inline void dispatchRunKernel(Surface& img, const LineSetup& ls, const ClipRect& clip,
+                                  const s3d::Color& col, const s3d::Color& aaCol,
+                                  double decaySectionRate = 0.0, s3d::uint32 aaRate = 0)
+    {
+        runKernelTable<AA, Decay, Blend, Surface>[static_cast<size_t>(octantOf(ls))](img, ls, clip, col, aaCol,
+                                                                                     decaySectionRate, aaRate);
+    }
+
+
+
+    // ◎◎ 1点ずつ進める基準の実装（ColorF版が使う）
+    // 【内部関数】基準軸とそれ以外の軸の座標で点を描く
+    template <bool XMajor, BlendMode Blend, class ColorType>
+    inline void plotAxis(s3d::Image& img, s3d::int32 majPos, s3d::int32 minPos, const ColorType& col)
+    {
+        if (XMajor) plot<Blend>(img, majPos, minPos, col);
+        else        plot<Blend>(img, minPos, majPos, col);
+    }
+
+
+
+    // 【内部関数】ステップj - 1からjへ移るときの疑似AAの2点を、クリップ矩形の中にある点だけ描く（見えている区間の境目用）
+    template <bool XMajor, BlendMode Blend, class ColorType>
+    inline void plotEdgeAA(s3d::Image& img, const ClipRect& clip, const LineSetup& ls, s3d::int64 j, const ColorType& aaCol)
+    {
+        const s3d::Point prev = stepPos<XMajor>(ls, j - 1);
+        const s3d::Point next = stepPos<XMajor>(ls, j);
+        // 移る前の行の次の点と、移った後の行の前の点（1点ずつ進めた場合と同じ順）
+        const s3d::Point aa1 = XMajor ? s3d::Point(next.x, prev.y) : s3d::Point(prev.x, next.y);
+        const s3d::Point aa2 = XMajor ? s3d::Point(prev.x, next.y) : s3d::Point(next.x, prev.y);
+        if (inClip(clip, aa1)) plot<Blend>(img, aa1.x, aa1.y, aaCol);
+        if (inClip(clip, aa2)) plot<Blend>(img, aa2.x, aa2.y, aaCol);
+    }
+
+
+
+    // 【内部関数】線分のカーネル。線分, 疑似AA付き, 減衰（疑似AA付き）のすべてをこれ1つで描く
+    // 基準軸をmaj、もう一方の軸をminとして書き、x基準とy基準の違いは点を描くときの座標の入れ替えだけにする。
+    // 向きは八分円から決まる定数なので、1点ごとの分岐は「もう一方の軸も移動するか」だけ。
+    // 端点が範囲外なら、線分の点がイメージの中にあるステップの範囲（visibleSteps()）だけをたどる。
+    // その範囲の中の疑似AAの点はイメージの中にあるので、範囲を確認するのは範囲の境目の疑似AAの点だけになる。
+    // ColorTypeがs3d::ColorFなら1点ごとに8bitへ変換、s3d::Colorならそのまま格納（減衰はs3d::ColorFのみ）。
+    // aaColorRateとdecaySectionRateはクランプ済みであること
+    template <Octant O, bool AA, bool Decay, BlendMode Blend, class ColorType>
+    inline void lineKernel(s3d::Image& img, const LineSetup& ls, ColorType col, const ColorType& aaCol,
+                           double decaySectionRate = 0.0, double aaColorRate = 0.0)
+    {
+        constexpr bool       XMajor  = octantXMajor(O);
+        constexpr s3d::int32 stepMaj = XMajor ? octantStepX(O) : octantStepY(O);
+        constexpr s3d::int32 stepMin = XMajor ? octantStepY(O) : octantStepX(O);
+        const s3d::int64 eMax = ls.eMax;
+        const s3d::int64 eInc = ls.eInc;
+        const s3d::int64 last = XMajor ? ls.dist.x : ls.dist.y;  // 始点のステップ
+
+        // 線分の点がイメージの中にあるステップの範囲（visibleSteps()は1ドット広げるので、狭めた矩形で求める）
+        const ClipRect clip  = imageClip(img);
+        const ClipRect inner{ clip.left + 1, clip.top + 1, clip.right - 1, clip.bottom - 1 };
+        const bool     whole = inClip(clip, ls.startPos) && inClip(clip, ls.endPos);
+        const StepRange r    = whole ? StepRange{ 0, last } : visibleSteps<XMajor>(ls, inner);
+
+        // 減衰するなら、終点から分割点までが通常の処理（減衰しなければ始点まで）
+        const s3d::int32 decayLen = Decay ? static_cast<s3d::int32>(((XMajor ? ls.endPos.x - ls.startPos.x
+                                                                            : ls.endPos.y - ls.startPos.y)) * decaySectionRate) : 0;  // 減衰区間の長さ
+        const s3d::int64 split    = last - std::abs(decayLen);                                                // 分割点のステップ
+        const double     alpha0   = Decay ? static_cast<double>(col.a) : 0.0;
+        const double     alphaFadeVol = alpha0 / (1 + std::abs(decayLen));  // アルファのフェード量
+
+        // 範囲の境目の疑似AAの点（範囲の外の点を含む。見えている区間の外の移動は数回しかないので、移動ごとに求める）
+        if (AA && !whole && (eInc > 0)) {
+            const StepRange outer = visibleSteps<XMajor>(ls, clip);
+            auto edge = [&](s3d::int64 lo, s3d::int64 hi) {
+                lo = std::max<s3d::int64>(lo, 1);
+                if (lo > hi) return;
+                const s3d::int64 mLo = (ls.e0 + (lo - 1) * eInc) / eMax;
+                const s3d::int64 mHi = (ls.e0 + hi * eInc) / eMax;
+                for (s3d::int64 mv = mLo + 1; mv <= mHi; ++mv) {
+                    const s3d::int64 j = ceilDiv(mv * eMax - ls.e0, eInc);
+                    if (Decay && (j > split)) {
+                        const ColorType fadeCol(col, alpha0 - alphaFadeVol * static_cast<double>(j - split));
+                        plotEdgeAA<XMajor, Blend>(img, clip, ls, j, ColorType(fadeCol, fadeCol.a * aaColorRate));
+                    }
+                    else plotEdgeAA<XMajor, Blend>(img, clip, ls, j, aaCol);
+                }
+            };
+            if (r.first > r.last) { edge(outer.first + 1, outer.last); }
+            else                  { edge(outer.first + 1, r.first); edge(r.last + 1, outer.last); }
+        }
+        if (r.first > r.last) return;
+
+        // 範囲の始まりを初期位置として始める（端点が範囲内なら終点）
+        const s3d::Point now = stepPos<XMajor>(ls, r.first);
+        s3d::int32 majPos = XMajor ? now.x : now.y;
+        s3d::int32 minPos = XMajor ? now.y : now.x;
+        s3d::int64 e      = (eMax == 0) ? 0 : (ls.e0 + r.first * eInc) % eMax;  // 誤差（整数の端点なら、初期値は四捨五入のために閾値/2）
+        s3d::int64 k      = r.first;
+
+        // ◎ 終点から分割点までループ（通常の線分、または疑似AA付き線分の処理）
+        const s3d::int64 solidLast = std::min(split, r.last);
+        if (k <= solidLast) {
+            for (;;) {
+                // 現在位置に点を描く
+                plotAxis<XMajor, Blend>(img, majPos, minPos, col);
+
+                // 分割点（減衰しなければ範囲の終わり）ならループを抜ける
+                if (k == solidLast) break;
+
+                // 基準軸を「1ドット」移動して、誤差を蓄積
+                ++k;
+                majPos += stepMaj;
+                e      += eInc;
+
+                // 誤差がたまったら
+                if (e >= eMax) {
+                    if (AA) plotAxis<XMajor, Blend>(img, majPos, minPos, aaCol);           // 疑似AA
+
+                    // もう一方の軸を「1ドット」移動
+                    minPos += stepMin;
+
+                    if (AA) plotAxis<XMajor, Blend>(img, majPos - stepMaj, minPos, aaCol);  // 疑似AA
+
+                    // 誤差をリセット。超過分を残すのがミソ
+                    e -= eMax;
+                }
+            }
+        }
+
+        if constexpr (Decay) {
+            // 分割点より先から始まるなら、飛ばしたステップの分だけフェードしてから描く
+            // （1ステップずつ引いた場合と、アルファの丸めが1段階ずれることがある）
+            if (k > split) {
+                col.a -= alphaFadeVol * static_cast<double>(k - split);
+                plotAxis<XMajor, Blend>(img, majPos, minPos, col);
+            }
+
+            // 範囲の終わりなら終了
+            if (k == r.last) return;
+
+            // ◎ 分割点から範囲の終わりまでループ（ここが減衰する）
+            for (;;) {
+                // 初回の重複描画を避けるためフローを変更
+                ++k;
+                majPos += stepMaj;
+                e      += eInc;
+
+                col.a -= alphaFadeVol;  // アルファをフェードアウト
+
+                if (e >= eMax) {
+                    plotAxis<XMajor, Blend>(img, majPos, minPos, s3d::ColorF(col, col.a * aaColorRate));
+                    minPos += stepMin;
+                    plotAxis<XMajor, Blend>(img, majPos - stepMaj, minPos, s3d::ColorF(col, col.a * aaColorRate));
+                    e -= eMax;
+                }
+
+                plotAxis<XMajor, Blend>(img, majPos, minPos, col);
+                if (k == r.last) break;
+            }
+        }
+    }
+
+
+
+    // 【内部型】八分円ごとのカーネルの関数表（八分円の番号順）
+    // 線分ごとに表から1回だけ選んで呼ぶ。八分円ごとに別の関数のまま呼ぶので、
+    // すべての組み合わせが1つの関数に展開されて大きくなることも無い
+    template <class ColorType>
+    using LineKernelFunc = void (*)(s3d::Image&, const LineSetup&, ColorType, const ColorType&, double, double);
+
+    template <bool AA, bool Decay, BlendMode Blend, class ColorType, size_t... I>
+    constexpr std::array<LineKernelFunc<ColorType>, 8> makeLineKernelTable(std::index_sequence<I...>)
+    {
+        return {{ lineKernel<static_cast<Octant>(I), AA, Decay, Blend, ColorType>... }};
+    }
+
+    template <bool AA, bool Decay, BlendMode Blend, class ColorType>
+    inline constexpr auto lineKernelTable =
+        makeLineKernelTable<AA, Decay, Blend, ColorType>(std::make_index_sequence<8>());
+
+
+
+    // 【内部関数】ColorF版の入口。八分円から、カーネルを選んで1回呼ぶ
+    template <bool AA, bool Decay, BlendMode Blend, class ColorType>
+    inline void dispatchKernel(s3d::Image& img, const LineSetup& ls, const ColorType& col,
+                               const ColorType& aaCol, double decaySectionRate = 0.0, double aaColorRate = 0.0)
+    {
+        lineKernelTable<AA, Decay, Blend, ColorType>[static_cast<size_t>(octantOf(ls))](img, ls, col, aaCol,
+                                                                                      decaySectionRate, aaColorRate);
+    }
+
+
+
+    // ◎◎ Xiaolin Wuのアンチエイリアシング（整数版とバッチ描画が使う）
+    // 基準軸の1ドットごとに、もう一方の軸の本来の位置（小数）を挟む2点を、近さに応じた濃さで書く。
+    // 本来の位置は、終点の点の中心から「(e0 + k * eInc) / eMax - 0.5」ドット（整数の端点ならk * 高さ / 底辺）なので、
+    // 2倍して整数にした商を位置、余りをカバレッジにする（誤差は蓄積しない）。
+    // カバレッジは8bit（0～256）で、余りに底辺の逆数（固定小数点）を掛けて求める（1点ごとの除算は無い）。
+    // 濃さ0の点は書かないので、整数の端点なら点は端点の外接矩形の中に収まる
+    // （サブピクセルの端点では、もう一方の軸に1ドットはみ出すことがある）
+    // 【内部関数】カバレッジの付いた点を書く（Clippedならクリップ矩形の外の点は書かない）
+    // alphaは16.16固定小数点、weightは0～256
+    template <bool Clipped, BlendMode Blend, class Surface>
+    inline void writeCoverage(Surface& img, const ClipRect& clip, s3d::int32 x, s3d::int32 y,
+                              const s3d::Color& col, s3d::uint32 alpha, s3d::uint32 weight)
+    {
+        if (weight == 0 || (Clipped && !inClip(clip, s3d::Point(x, y)))) return;
+        const s3d::uint8 a = static_cast<s3d::uint8>((static_cast<s3d::uint64>(alpha) * weight + (1u << 23)) >> 24);
+        KOTSUBU_BOARD_STATS_WRITTEN(1);
+        blendPixel<Blend>(img[y][x], s3d::Color(col, a));
+    }
+
+
+
+    // 【内部関数】Wuの線分を書く。ステップkからkLastまで（両端を含む）
+    // 1点ごとにアルファをalphaFadeだけ減らす（減衰しなければ0）
+    template <Octant O, bool Clipped, BlendMode Blend, class Surface>
+    inline void walkWu(Surface& img, const LineSetup& ls, const ClipRect& clip, s3d::int64 k, s3d::int64 kLast,
+                       const s3d::Color& col, s3d::uint32 alpha, s3d::uint32 alphaFade)
+    {
+        constexpr bool       XMajor  = octantXMajor(O);
+        constexpr s3d::int32 stepMaj = XMajor ? octantStepX(O) : octantStepY(O);
+        constexpr s3d::int32 stepMin = XMajor ? octantStepY(O) : octantStepX(O);
+        const s3d::int64  den   = 2 * ls.eMax;  // 位置の分母（2倍）
+        const s3d::int64  inc   = 2 * ls.eInc;
+
+        // 分母の逆数（2^40倍）。分母が大きい（サブピクセルの端点など）ときは、濃さを求めるときだけ右シフトして精度を保つ
+        s3d::int32 shift = 0;
+        while ((den >> shift) >= (1 << 24)) ++shift;
+        const s3d::uint64 recip = (den == 0) ? 0 : (1ull << 40) / static_cast<s3d::uint64>(den >> shift);
+
+        // ステップkの位置と余り（終点付近では、近い方の点が終点の点の手前になることがある）
+        const s3d::int64 num  = 2 * (ls.e0 + k * ls.eInc) - ls.eMax;
+        const s3d::int64 quot = (den == 0) ? 0 : floorDiv(num, den);
+        s3d::int64 r      = (den == 0) ? 0 : num - quot * den;
+        s3d::int32 majPos = static_cast<s3d::int32>((XMajor ? ls.endPos.x : ls.endPos.y) + k * stepMaj);
+        s3d::int32 minPos = static_cast<s3d::int32>((XMajor ? ls.endPos.y : ls.endPos.x) + quot * stepMin);
+        for (; k <= kLast; ++k) {
+            // 遠い方の点の濃さ（余り / 分母）。近い方は残り
+            const s3d::uint32 far = static_cast<s3d::uint32>((static_cast<s3d::uint64>(r >> shift) * recip + (1ull << 31)) >> 32);
+            if (XMajor) {
+                writeCoverage<Clipped, Blend>(img, clip, majPos, minPos, col, alpha, 256 - far);
+                writeCoverage<Clipped, Blend>(img, clip, majPos, minPos + stepMin, col, alpha, far);
+            }
+            else {
+                writeCoverage<Clipped, Blend>(img, clip, minPos, majPos, col, alpha, 256 - far);
+                writeCoverage<Clipped, Blend>(img, clip, minPos + stepMin, majPos, col, alpha, far);
+            }
+
+            majPos += stepMaj;
+            alpha  -= alphaFade;
+            r      += inc;
+            if (r >= den) { r -= den; minPos += stepMin; }
+        }
+    }
+
+
+
+    // 【内部関数】Wuのカーネル（整数版）。減衰の有無をこれ1つで描く
+    // 減衰区間とアルファの減り方はrunKernel()と同じ（分割点は単色側で書き、減衰側は次の点から始める）。
+    // decaySectionRateは減衰するときだけ使う（クランプ済みであること）
+    template <Octant O, bool Decay, BlendMode Blend, class Surface>
+    inline void wuKernel(Surface& img, const LineSetup& ls, const ClipRect& clip,
+                         const s3d::Color& col, double decaySectionRate = 0.0)
+    {
+        constexpr bool XMajor = octantXMajor(O);
+
+        // Wuの点はもう一方の軸に1ドットはみ出すことがある（サブピクセルの端点）ので、1ドット内側の矩形で判定する
+        const ClipRect    inner{ clip.left + 1, clip.top + 1, clip.right - 1, clip.bottom - 1 };
+        const bool        clipped = !(inClip(inner, ls.startPos) && inClip(inner, ls.endPos));
+        const StepRange   r       = clipped ? visibleSteps<XMajor>(ls, clip)
+                                            : StepRange{ 0, XMajor ? ls.dist.x : ls.dist.y };
+        const s3d::uint32 alpha   = static_cast<s3d::uint32>(col.a) << AlphaShift;
+        auto walk = [&](s3d::int64 first, s3d::int64 last, s3d::uint32 a, s3d::uint32 fade) {
+            if (first > last) return;
+            if (clipped) walkWu<O, true,  Blend>(img, ls, clip, first, last, col, a, fade);
+            else         walkWu<O, false, Blend>(img, ls, clip, first, last, col, a, fade);
+        };
+
+        if constexpr (!Decay) {
+            walk(r.first, r.last, alpha, 0);
+        }
+        else {
+            const s3d::int32 dist     = XMajor ? (ls.endPos.x - ls.startPos.x) : (ls.endPos.y - ls.startPos.y);
+            const s3d::int32 decayLen = dist * decaySectionRate;                  // 減衰区間の長さ
+            const s3d::int64 last     = std::abs(dist);                           // 始点のステップ
+            const s3d::int64 split    = last - std::abs(decayLen);                // 分割点のステップ
+
+            // ◎ 終点から分割点まで
+            walk(r.first, std::min(split, r.last), alpha, 0);
+
+            // ◎ 分割点の次から始点まで（ここが減衰する）
+            const s3d::int64  first     = std::max(split + 1, r.first);
+            const s3d::uint32 alphaFade = alpha / (1 + std::abs(decayLen));
+            walk(first, r.last, alpha - alphaFade * static_cast<s3d::uint32>(first - split), alphaFade);
+        }
+    }
+
+
+
+    // 【内部型】八分円ごとのWuのカーネルの関数表（八分円の番号順。書き込み先の型ごと）
+    template <class Surface>
+    using WuKernelFunc = void (*)(Surface&, const LineSetup&, const ClipRect&, const s3d::Color&, double);
+
+    template <bool Decay, BlendMode Blend, class Surface, size_t... I>
+    constexpr std::array<WuKernelFunc<Surface>, 8> makeWuKernelTable(std::index_sequence<I...>)
+    {
+        return {{ wuKernel<static_cast<Octant>(I), Decay, Blend, Surface>... }};
+    }
+
+    template <bool Decay, BlendMode Blend, class Surface>
+    inline constexpr auto wuKernelTable = makeWuKernelTable<Decay, Blend, Surface>(std::make_index_sequence<8>());
+
+
+
+    // 【内部関数】Wuの入口。八分円から、カーネルを選んで1回呼ぶ
+    template <bool Decay, BlendMode Blend, class Surface>
+    inline void dispatchWuKernel(Surface& img, const LineSetup& ls, const ClipRect& clip,
+                                 const s3d::Color& col, double decaySectionRate = 0.0)
+    {
+        wuKernelTable<Decay, Blend, Surface>[static_cast<size_t>(octantOf(ls))](img, ls, clip, col, decaySectionRate);
+    }
+
+
+
+    // 【内部関数】疑似AA部分の色（整数版）。rateはクランプ済みであること
+    // ColorF版と同じ丸めになるよう、線分ごとに1回だけColorFを経由して求める
+    inline s3d::Color makeAAColor(const s3d::Color& col, double rate)
+    {
+        const s3d::ColorF colF(col);
+        return s3d::Color(s3d::ColorF(colF, colF.a * rate));
+    }
+
+
+
+    // 【内部定数】線分の種類の数（LineModeの並び順）と、合成の方式の数（BlendModeの並び順）
+    constexpr size_t LineModeCount  = 5;
+    constexpr size_t BlendModeCount = 4;
+
+    // 【内部関数】Wuの線分の種類か
+    inline bool isWuMode(LineMode mode)
+    {
+        return mode == LineMode::Wu || mode == LineMode::WuDecay;
+    }
+
+
+
+    // 【内部型】バッチ描画の前準備の結果（線分1本分）
+    struct BatchEntry
+    {
+        LineSetup   ls;
+        s3d::Color  col;
+        s3d::Color  aaCol;
+        double      decaySectionRate;
+        s3d::uint32 aaRate;  // 16bit固定小数点
+        bool        wu;      // Wuの線分か（点がもう一方の軸に1ドットはみ出すことがある。clipXRange()のwide）
+        size_t      bucket;  // 組（合成の方式×種類×基準軸）の番号。batchDrawFuncsの並び順
+    };
+
+
+
+    // 【内部関数】バッチ描画の1本分（組ごとにテンプレート引数を決めたもの。八分円は線分ごとに選ぶ）
+    template <LineMode Mode, bool XMajor, BlendMode Blend, class Surface>
+    inline void drawBatchEntry(Surface& img, const BatchEntry& e, const ClipRect& clip)
+    {
+        if      (Mode == LineMode::Line)  dispatchRunKernel<false, false, Blend>(img, e.ls, clip, e.col, e.col);
+        else if (Mode == LineMode::AA)    dispatchRunKernel<true,  false, Blend>(img, e.ls, clip, e.col, e.aaCol);
+        else if (Mode == LineMode::Decay) dispatchRunKernel<true, true, Blend>(img, e.ls, clip, e.col, e.aaCol,
+                                                                                e.decaySectionRate, e.aaRate);
+        else if (Mode == LineMode::Wu)    dispatchWuKernel<false, Blend>(img, e.ls, clip, e.col);
+        else                              dispatchWuKernel<true,  Blend>(img, e.ls, clip, e.col, e.decaySectionRate);
+    }
+
+
+
+    // 【内部関数】バッチ描画の前準備（線分1本分）
+    inline BatchEntry makeBatchEntry(const LineSetup& ls, LineMode mode, const s3d::Color& col,
+                                     double decaySectionRate, double aaColorRate, BlendMode blend)
+    {
+        BatchEntry entry;
+        entry.ls               = ls;
+        const double aaRate    = clampRate(aaColorRate);
+        entry.col              = col;
+        entry.aaCol            = makeAAColor(entry.col, aaRate);
+        entry.aaRate           = toFixedRate(aaRate);
+        entry.decaySectionRate = clampRate(decaySectionRate);
+        entry.wu               = isWuMode(mode);
+        entry.bucket           = (static_cast<size_t>(blend) * LineModeCount + static_cast<size_t>(mode)) * 2 +
+                                 (entry.ls.xMajor ? 0 : 1);
+        return entry;
+    }
+
+    inline BatchEntry makeBatchEntry(const LineSegment& seg)
+    {
+        return makeBatchEntry(makeLineSetup(seg.startPos, seg.endPos), seg.mode, s3d::Color(seg.col),
+                              seg.decaySectionRate, seg.aaColorRate, seg.blend);
+    }
+
+    // 【内部型】組ごとのバッチ描画の関数表（書き込み先の型ごと）
+    // 組の番号 = (合成の方式 * 種類の数 + 種類) * 2 + (x基準なら0, y基準なら1)
+    template <class Surface>
+    using BatchDrawFunc = void (*)(Surface&, const BatchEntry&, const ClipRect&);
+
+    template <class Surface, size_t... I>
+    constexpr std::array<BatchDrawFunc<Surface>, sizeof...(I)> makeBatchDrawTable(std::index_sequence<I...>)
+    {
+        return {{ drawBatchEntry<static_cast<LineMode>((I / 2) % LineModeCount), (I % 2) == 0,
+                                 static_cast<BlendMode>(I / (2 * LineModeCount)), Surface>... }};
+    }
+
+    template <class Surface>
+    inline constexpr auto batchDrawTable = makeBatchDrawTable<Surface>(std::make_index_sequence<BlendModeCount * LineModeCount * 2>());
+
+    inline constexpr auto& batchDrawFuncs = batchDrawTable<s3d::Image>;
+
+    constexpr size_t BatchBucketCount = std::size(batchDrawFuncs);
+
+
+
+    // 【内部関数】バッチ描画の作業領域（呼び出しごとのメモリ確保を避けるため使い回す）
+    // 0番は前準備の結果、1番は組ごとに並べ替えた結果
+    inline s3d::Array<BatchEntry>& batchBuffer(size_t index)
+    {
+        thread_local s3d::Array<BatchEntry> buffers[2];
+        return buffers[index];
+    }
+
+
+
+    // 【内部関数】バッチ描画の前準備と、組ごとの並べ替え
+    // 結果は組の番号順に並び、組bはbucketStart[b]からbucketStart[b + 1]の手前まで（同じ組の中は配列の順番どおり）
+    inline const s3d::Array<BatchEntry>& prepareBatch(const LineSegment* segments, size_t count,
+                                                       size_t (&bucketStart)[BatchBucketCount + 1])
+    {
+        // 前準備と、組ごとの個数の集計
+        s3d::Array<BatchEntry>& staging = batchBuffer(0);
+        s3d::Array<BatchEntry>& entries = batchBuffer(1);
+        staging.resize(count);
+        entries.resize(count);
+        std::fill_n(bucketStart, BatchBucketCount + 1, 0);
+        for (size_t i = 0; i < count; ++i) {
+            staging[i] = makeBatchEntry(segments[i]);
+            ++bucketStart[staging[i].bucket + 1];
+        }
+        for (size_t b = 0; b < BatchBucketCount; ++b)
+            bucketStart[b + 1] += bucketStart[b];
+
+        // 組ごとに詰める（計数ソート。同じ組の中の順番は変わらない）
+        size_t fill[BatchBucketCount];
+        std::copy_n(bucketStart, BatchBucketCount, fill);
+        for (const auto& entry : staging)
+            entries[fill[entry.bucket]++] = entry;
+        return entries;
+    }
+
+
+    // 【内部関数】整数版の線分の入口（Point版とFixedPoint版で共通。前準備の済んだ線分を描く）
+    // 書き込み先はs3d::ImageかKotsubuImage8（8bitの点には色のアルファを書く）
+    template <class Surface>
+    inline void drawLine(Surface& img, const LineSetup& ls, const s3d::Color& col, BlendMode blend)
+    {
+        const ClipRect clip = imageClip(img);
+        withBlend(blend, [&](auto b) {
+            dispatchRunKernel<false, false, decltype(b)::value>(img, ls, clip, col, col);
+        });
+    }
+
+    template <class Surface>
+    inline void drawLineAA(Surface& img, const LineSetup& ls, const s3d::Color& col, double aaColorRate,
+                           BlendMode blend)
+    {
+        const ClipRect   clip  = imageClip(img);
+        const s3d::Color aaCol = makeAAColor(col, clampRate(aaColorRate));
+        withBlend(blend, [&](auto b) {
+            dispatchRunKernel<true, false, decltype(b)::value>(img, ls, clip, col, aaCol);
+        });
+    }
+
+    template <class Surface>
+    inline void drawDecayLine(Surface& img, const LineSetup& ls, const s3d::Color& col,
+                              double decaySectionRate, double aaColorRate, BlendMode blend)
+    {
+        const ClipRect clip = imageClip(img);
+        aaColorRate = clampRate(aaColorRate);
+        const s3d::Color  aaCol  = makeAAColor(col, aaColorRate);
+        const s3d::uint32 aaRate = toFixedRate(aaColorRate);
+        decaySectionRate = clampRate(decaySectionRate);
+        withBlend(blend, [&](auto b) {
+            dispatchRunKernel<true, true, decltype(b)::value>(img, ls, clip, col, aaCol, decaySectionRate, aaRate);
+        });
+    }
+
+    template <class Surface>
+    inline void drawLineWu(Surface& img, const LineSetup& ls, const s3d::Color& col, BlendMode blend)
+    {
+        const ClipRect clip = imageClip(img);
+        withBlend(blend, [&](auto b) {
+            dispatchWuKernel<false, decltype(b)::value>(img, ls, clip, col);
+        });
+    }
+
+    template <class Surface>
+    inline void drawDecayLineWu(Surface& img, const LineSetup& ls, const s3d::Color& col,
+                                double decaySectionRate, BlendMode blend)
+    {
+        const ClipRect clip = imageClip(img);
+        decaySectionRate = clampRate(decaySectionRate);
+        withBlend(blend, [&](auto b) {
+            dispatchWuKernel<true, decltype(b)::value>(img, ls, clip, col, decaySectionRate);
+        });
+    }
+
+
+
+    // 【内部関数】複数の線分をまとめて描く（renderLines()の本体。書き込み先はs3d::ImageかKotsubuImage8）
+    template <class Surface>
+    inline void drawLines(Surface& img, const LineSegment* segments, size_t count)
+    {
+        // 前準備と、組ごとの並べ替え
+        size_t bucketStart[BatchBucketCount + 1];
+        const BatchEntry* e = prepareBatch(segments, count, bucketStart).data();
+
+        // 組ごとに専用の関数で描く（線分ごとの分岐が無い）
+        const ClipRect clip = imageClip(img);
+        for (size_t b = 0; b < BatchBucketCount; ++b) {
+            const BatchDrawFunc<Surface> draw = batchDrawTable<Surface>[b];
+            for (size_t i = bucketStart[b]; i < bucketStart[b + 1]; ++i)
+                draw(img, e[i], clip);
+        }
+    }
+
+
+
+    // 【内部関数】疎なイメージの、線分が掛かるタイルごとにf(タイルの面, タイルのクリップ矩形)を呼ぶ
+    // タイルは帯（タイル1行分）ごとに、帯でクリップした線分のxの範囲から選ぶ（kotsubu_tile_renderer.hの振り分けと同じ）。
+    // 選んだタイルは、まだ無ければここで割り当てる
+    template <class F>
+    inline void forEachSparseTile(KotsubuSparseImage& img, const BatchEntry& e, F&& f)
+    {
+        constexpr s3d::int32 T = KotsubuSparseImage::TileSize;
+        const LineSetup& ls = e.ls;
+        const s3d::int32 margin = e.wu ? 1 : 0;
+        const s3d::int32 minY = std::max(std::min(ls.startPos.y, ls.endPos.y) - margin, 0);
+        const s3d::int32 maxY = std::min(std::max(ls.startPos.y, ls.endPos.y) + margin, img.height() - 1);
+        for (s3d::int32 ty = minY / T; ty <= maxY / T && minY <= maxY; ++ty) {
+            const ClipRect band{ 0, ty * T, img.width() - 1, std::min((ty + 1) * T, img.height()) - 1 };
+            s3d::int32 lo, hi;
+            if (!clipXRange(ls, band, lo, hi, e.wu)) continue;
+
+            for (s3d::int32 tx = lo / T; tx <= hi / T; ++tx) {
+                const SparseTile tile{ img.tile(tx, ty), tx * T, ty * T };
+                const ClipRect   clip{ tx * T, ty * T, std::min((tx + 1) * T, img.width()) - 1, band.bottom };
+                f(tile, clip);
+            }
+        }
+    }
+
+
+
+    // 【内部関数】疎なイメージに、前準備の済んだ線分を1本描く（タイルごとにクリップして描くので、点は同じになる）
+    inline void drawSparseEntry(KotsubuSparseImage& img, const BatchEntry& e)
+    {
+        forEachSparseTile(img, e, [&](SparseTile tile, const ClipRect& clip) {
+            batchDrawTable<SparseTile>[e.bucket](tile, e, clip);
+        });
+    }
+
+
+
+    // 【内部関数】疎なイメージ版の線分の入口（s3d::Image版と同じ引数。書き込み先が疎なイメージのときに選ばれる）
+    inline void drawLine(KotsubuSparseImage& img, const LineSetup& ls, const s3d::Color& col, BlendMode blend)
+    {
+        drawSparseEntry(img, makeBatchEntry(ls, LineMode::Line, col, 0.0, 0.0, blend));
+    }
+
+    inline void drawLineAA(KotsubuSparseImage& img, const LineSetup& ls, const s3d::Color& col, double aaColorRate,
+                           BlendMode blend)
+    {
+        drawSparseEntry(img, makeBatchEntry(ls, LineMode::AA, col, 0.0, aaColorRate, blend));
+    }
+
+    inline void drawDecayLine(KotsubuSparseImage& img, const LineSetup& ls, const s3d::Color& col,
+                              double decaySectionRate, double aaColorRate, BlendMode blend)
+    {
+        drawSparseEntry(img, makeBatchEntry(ls, LineMode::Decay, col, decaySectionRate, aaColorRate, blend));
+    }
+
+    inline void drawLineWu(KotsubuSparseImage& img, const LineSetup& ls, const s3d::Color& col, BlendMode blend)
+    {
+        drawSparseEntry(img, makeBatchEntry(ls, LineMode::Wu, col, 0.0, 0.0, blend));
+    }
+
+    inline void drawDecayLineWu(KotsubuSparseImage& img, const LineSetup& ls, const s3d::Color& col,
+                                double decaySectionRate, BlendMode blend)
+    {
+        drawSparseEntry(img, makeBatchEntry(ls, LineMode::WuDecay, col, decaySectionRate, 0.0, blend));
+    }
+
+    inline void drawLines(KotsubuSparseImage& img, const LineSegment* segments, size_t count)
+    {
+        size_t bucketStart[BatchBucketCount + 1];
+        const s3d::Array<BatchEntry>& entries = prepareBatch(segments, count, bucketStart);
+        for (const auto& e : entries)
+            drawSparseEntry(img, e);
+    }
+
+
+
+    // 【内部関数】ボードの形式に合わせた描画用イメージ（mImg、mImg8、mSparse、mExternal）で、f(img)を呼ぶ
+    template <class F>
+    inline void withBoardImage(KotsubuPixelBoard& board, F&& f)
+    {
+        if      (board.isSparse())   f(board.mSparse);
+        else if (board.isExternal()) f(board.mExternal);
+        else if (board.is8bit())   f(board.mImg8);
+        else                       f(board.mImg);
+    }
+
+
+
+    // 【内部関数】線分の変更範囲をボードに通知する（端点はサブピクセルでもよい）
+    // 点の中心に無い端点では、描く点が「端点を含む点」を結ぶ直線から最大1ドットずれるので、範囲を1ドット広げる。
+    // Wuの点は理想直線から1ドット以内（ブレゼンハムは0.5ドット以内）なので、さらに1ドット広げる
+    inline void markDirtySegment(KotsubuPixelBoard& board, const FixedPoint& startPos, const FixedPoint& endPos,
+                                 bool wu = false)
+    {
+        const bool centered = startPos.isCentered() && endPos.isCentered();
+        board.markDirtyLine(startPos.asPoint(), endPos.asPoint(), (centered ? 0 : 1) + (wu ? 1 : 0));
+    }
+}
+
+
+
+// 【関数】線分をレンダリング
+// ColorF版は1点ごとに8bitへ変換する（基準の実装）。Color版は変換済みの色をそのまま格納するので速い
+// 始点と終点はイメージの範囲外でもよい（範囲外の部分は描かない）。座標は±2^28以内とする（FixedPointは±2^20以内）。
+// どちらも見えている区間だけをたどる（端点が範囲外でも、1点ごとの範囲の確認は無い）
+// blendで書き込み先との合成の方式を選べる（kotsubu_blend.h）。既定は上書き
+inline void renderLine(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                       BlendMode blend = BlendMode::Overwrite)
+{
+    using namespace kotsubu_detail;
+    if (outsideImage(img, startPos, endPos)) return;
+    const LineSetup ls = makeLineSetup(startPos, endPos);
+
+    withBlend(blend, [&](auto b) {
+        dispatchKernel<false, false, decltype(b)::value>(img, ls, col, col);
+    });
+}
+
+
+
+// 【関数】線分をレンダリング。疑似アンチエイリアシング付き
+inline void renderLineAA(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                         double aaColorRate = 0.3, BlendMode blend = BlendMode::Overwrite)
+{
+    using namespace kotsubu_detail;
+    if (outsideImage(img, startPos, endPos)) return;
+    const LineSetup ls = makeLineSetup(startPos, endPos);
+    // AA部分の通常部分に対する色の割合
+    aaColorRate = clampRate(aaColorRate);
+    // AA部分の色
+    const s3d::ColorF aaCol = s3d::ColorF(col, col.a * aaColorRate);
+
+    withBlend(blend, [&](auto b) {
+        dispatchKernel<true, false, decltype(b)::value>(img, ls, col, aaCol);
+    });
+}
+
+
+
+// 【関数】減衰する線分をレンダリング。疑似アンチエイリアシング付き
+inline void renderDecayLine(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                            double decaySectionRate = 0.5, double aaColorRate = 0.3,
+                            BlendMode blend = BlendMode::Overwrite)
+{
+    using namespace kotsubu_detail;
+    if (outsideImage(img, startPos, endPos)) return;
+    const LineSetup ls = makeLineSetup(startPos, endPos);
+    // AA部分の通常部分に対する色の割合
+    aaColorRate = clampRate(aaColorRate);
+    // AA部分の色
+    const s3d::ColorF aaCol = s3d::ColorF(col, col.a * aaColorRate);
+    // 減衰区間の割合
+    decaySectionRate = clampRate(decaySectionRate);
+
+    withBlend(blend, [&](auto b) {
+        dispatchKernel<true, true, decltype(b)::value>(img, ls, col, aaCol, decaySectionRate, aaColorRate);
+    });
+}
+
+
+
+// 【関数】線分をレンダリング。整数版（s3d::Color）
+// 1点ごとの処理は整数の格納だけになる。同じ行（列）に続く点はラン単位でまとめて書く。結果はColorF版と同じ
+// （線分と疑似AA付きはまったく同じ。減衰だけは許容差がある。renderDecayLine()の整数版を参照）
+// 端点が範囲外なら、イメージに掛かるステップの範囲を先に求め、その区間だけを描く（1点ごとの範囲確認は無い）
+// 端点はサブピクセル（FixedPoint）でもよい。誤差の初期値が端点の小数部分から決まるので、端点が1ドット未満で
+// 動いても線分がなめらかに動く（s3d::ColorFの色はs3d::Colorに変換される）
+inline void renderLine(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                       BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, blend);
+}
+
+inline void renderLine(s3d::Image& img, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                       BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, blend);
+}
+
+
+
+// 【関数】線分をレンダリング。疑似アンチエイリアシング付き。整数版（s3d::Color）
+inline void renderLineAA(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                         double aaColorRate = 0.3, BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawLineAA(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, aaColorRate, blend);
+}
+
+inline void renderLineAA(s3d::Image& img, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                         double aaColorRate = 0.3, BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawLineAA(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, aaColorRate, blend);
+}
+
+
+
+// 【関数】減衰する線分をレンダリング。疑似アンチエイリアシング付き。整数版（s3d::Color）
+// 【許容差】減衰区間のアルファは16.16固定小数点で求めるので、ColorF版（倍精度の引き算の繰り返し）とは、
+// 四捨五入がちょうど半分になる点でアルファが1違うことがある（点の位置と色のr, g, bは同じ）。
+// 上書き以外の合成では、このアルファの差が合成の結果に広がる（書き込み先のアルファが小さいと、色が大きく違う）。
+// 整数版の描き方（バッチ、並列、ボード、命令バッファ、GPU）どうしは、すべての合成でまったく同じ。
+// この許容差は bench/Main.cpp の差分テストで確かめる
+inline void renderDecayLine(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                            double decaySectionRate = 0.5, double aaColorRate = 0.3,
+                            BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawDecayLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), col,
+                                  decaySectionRate, aaColorRate, blend);
+}
+
+inline void renderDecayLine(s3d::Image& img, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                            double decaySectionRate = 0.5, double aaColorRate = 0.3,
+                            BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawDecayLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), col,
+                                  decaySectionRate, aaColorRate, blend);
+}
+
+
+
+// 【関数】線分をレンダリング。Xiaolin Wuのアンチエイリアシング（整数版）
+// 基準軸の1ドットごとに、本来の位置を挟む2点を近さに応じた濃さ（アルファ）で書く。
+// 疑似AAより細い線がなめらかに見えるので、ボードの解像度を上げなくてよい。
+// 濃さは書く色のアルファに掛かるので、上書き以外（合成）で描くと書き込み先となじむ
+inline void renderLineWu(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                         BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawLineWu(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, blend);
+}
+
+inline void renderLineWu(s3d::Image& img, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                         BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawLineWu(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, blend);
+}
+
+
+
+// 【関数】減衰する線分をレンダリング。Xiaolin Wuのアンチエイリアシング（整数版）
+// 減衰区間とアルファの減り方はrenderDecayLine()の整数版と同じ
+inline void renderDecayLineWu(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                              double decaySectionRate = 0.5, BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawDecayLineWu(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, decaySectionRate, blend);
+}
+
+inline void renderDecayLineWu(s3d::Image& img, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                              double decaySectionRate = 0.5, BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawDecayLineWu(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, decaySectionRate, blend);
+}
+
+
+
+// 【関数】Wuの線分のColorF版（s3d::Colorに変換して、整数版で描く）
+inline void renderLineWu(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                         BlendMode blend = BlendMode::Overwrite)
+{
+    renderLineWu(img, startPos, endPos, s3d::Color(col), blend);
+}
+
+inline void renderDecayLineWu(s3d::Image& img, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                              double decaySectionRate = 0.5, BlendMode blend = BlendMode::Overwrite)
+{
+    renderDecayLineWu(img, startPos, endPos, s3d::Color(col), decaySectionRate, blend);
+}
+
+
+
+// 【関数】複数の線分をまとめてレンダリング
+// 前準備（距離と方向、割合のクランプ、AA部分の色）を先に全部済ませ、
+// 合成の方式と種類と基準軸（x基準かy基準か）ごとに分けてから、それぞれを専用のループで描く。
+// 色は前準備でs3d::Colorに変換し、整数版の関数と同じ処理で描く
+// ＜注意＞ 組ごとに描くため、重なった線分同士の前後関係は配列の順番どおりにならない
+// （同じ組の中では配列の順番どおり）。順番が必要な場合は個別の関数で描く
+inline void renderLines(s3d::Image& img, const LineSegment* segments, size_t count)
+{
+    kotsubu_detail::drawLines(img, segments, count);
+}
+
+inline void renderLines(s3d::Image& img, const s3d::Array<LineSegment>& segments)
+{
+    renderLines(img, segments.data(), segments.size());
+}
+
+
+
+// 【関数】ボード版。レンダリングした範囲をボードに通知する（draw()で部分転送される）
+// 8bitの形式のボード（KotsubuPixelBoard::Format::Alpha8, Palette8）では、mImg8に色のアルファを値として書く
+// 疎な記憶方式のボード（KotsubuPixelBoard::Storage::Sparse）では、線分が掛かるタイルにだけ書く
+// 外部バッファのボード（KotsubuPixelBoard::Storage::External）では、呼び出し側のバッファに直接書く
+// （いずれもColorF版も整数版で描く。8bitの合成の方式は、s3d::Colorの点に書いた場合のアルファと同じ結果になる）
+inline void renderLine(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                       BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    if (board.is8bit() || board.isSparse() || board.isExternal())
+        kotsubu_detail::withBoardImage(board, [&](auto& img) {
+            kotsubu_detail::drawLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), s3d::Color(col), blend);
+        });
+    else
+        renderLine(board.mImg, startPos, endPos, col, blend);
+    board.markDirtyLine(startPos, endPos);
+}
+
+inline void renderLineAA(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                         double aaColorRate = 0.3, BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    if (board.is8bit() || board.isSparse() || board.isExternal())
+        kotsubu_detail::withBoardImage(board, [&](auto& img) {
+            kotsubu_detail::drawLineAA(img, kotsubu_detail::makeLineSetup(startPos, endPos), s3d::Color(col),
+                                       aaColorRate, blend);
+        });
+    else
+        renderLineAA(board.mImg, startPos, endPos, col, aaColorRate, blend);
+    board.markDirtyLine(startPos, endPos);
+}
+
+inline void renderDecayLine(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                            double decaySectionRate = 0.5, double aaColorRate = 0.3,
+                            BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    if (board.is8bit() || board.isSparse() || board.isExternal())
+        kotsubu_detail::withBoardImage(board, [&](auto& img) {
+            kotsubu_detail::drawDecayLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), s3d::Color(col),
+                                          decaySectionRate, aaColorRate, blend);
+        });
+    else
+        renderDecayLine(board.mImg, startPos, endPos, col, decaySectionRate, aaColorRate, blend);
+    board.markDirtyLine(startPos, endPos);
+}
+
+inline void renderLine(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                       BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, blend);
+    });
+    board.markDirtyLine(startPos, endPos);
+}
+
+inline void renderLineAA(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                         double aaColorRate = 0.3, BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawLineAA(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, aaColorRate, blend);
+    });
+    board.markDirtyLine(startPos, endPos);
+}
+
+inline void renderDecayLine(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                            double decaySectionRate = 0.5, double aaColorRate = 0.3,
+                            BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawDecayLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), col,
+                                      decaySectionRate, aaColorRate, blend);
+    });
+    board.markDirtyLine(startPos, endPos);
+}
+
+inline void renderLineWu(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                         BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawLineWu(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, blend);
+    });
+    board.markDirtyLine(startPos, endPos, 1);
+}
+
+inline void renderDecayLineWu(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::Color col,
+                              double decaySectionRate = 0.5, BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawDecayLineWu(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, decaySectionRate, blend);
+    });
+    board.markDirtyLine(startPos, endPos, 1);
+}
+
+inline void renderLineWu(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                         BlendMode blend = BlendMode::Overwrite)
+{
+    renderLineWu(board, startPos, endPos, s3d::Color(col), blend);
+}
+
+inline void renderDecayLineWu(KotsubuPixelBoard& board, s3d::Point startPos, s3d::Point endPos, s3d::ColorF col,
+                              double decaySectionRate = 0.5, BlendMode blend = BlendMode::Overwrite)
+{
+    renderDecayLineWu(board, startPos, endPos, s3d::Color(col), decaySectionRate, blend);
+}
+
+inline void renderLine(KotsubuPixelBoard& board, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                       BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, blend);
+    });
+    kotsubu_detail::markDirtySegment(board, startPos, endPos);
+}
+
+inline void renderLineAA(KotsubuPixelBoard& board, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                         double aaColorRate = 0.3, BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawLineAA(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, aaColorRate, blend);
+    });
+    kotsubu_detail::markDirtySegment(board, startPos, endPos);
+}
+
+inline void renderDecayLine(KotsubuPixelBoard& board, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                            double decaySectionRate = 0.5, double aaColorRate = 0.3,
+                            BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawDecayLine(img, kotsubu_detail::makeLineSetup(startPos, endPos), col,
+                                      decaySectionRate, aaColorRate, blend);
+    });
+    kotsubu_detail::markDirtySegment(board, startPos, endPos);
+}
+
+inline void renderLineWu(KotsubuPixelBoard& board, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                         BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawLineWu(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, blend);
+    });
+    kotsubu_detail::markDirtySegment(board, startPos, endPos, true);
+}
+
+inline void renderDecayLineWu(KotsubuPixelBoard& board, FixedPoint startPos, FixedPoint endPos, s3d::Color col,
+                              double decaySectionRate = 0.5, BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawDecayLineWu(img, kotsubu_detail::makeLineSetup(startPos, endPos), col, decaySectionRate, blend);
+    });
+    kotsubu_detail::markDirtySegment(board, startPos, endPos, true);
+}
+
+inline void renderLines(KotsubuPixelBoard& board, const LineSegment* segments, size_t count)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) { kotsubu_detail::drawLines(img, segments, count); });
+    for (size_t i = 0; i < count; ++i)
+        kotsubu_detail::markDirtySegment(board, segments[i].startPos, segments[i].endPos,
+                                         kotsubu_detail::isWuMode(segments[i].mode));
+}
+
+inline void renderLines(KotsubuPixelBoard& board, const s3d::Array<LineSegment>& segments)
+{
+    renderLines(board, segments.data(), segments.size());
+}
@@ -1,8 +1,8 @@
 /**************************************************************************************************
-【ヘッダオンリークラス】kotsubu_pixel_board v1.2
+【ヘッダオンリークラス】kotsubu_pixel_board v1.6
 
 ・概要
-ドットのお絵かきボードを提供するクラス（OpenSiv3D専用）
+ドットのお絵かきボードを提供するクラス（OpenSiv3D v0.6以降専用）
 1つのボードにつき、1つの描画イメージを内包する。
 座標系       --- クライアント左上を原点とするボードの位置, ボード左上を原点とする描画イメージの座標
 レンダリング --- クラスの公開フィールド s3d::Image mImg に対して直接書き込む（高速化というか手抜き）
@@ -12,98 +12,1102 @@
 #include <Siv3D.hpp>
 #include "kotsubu_pixel_board.h"
 KotsubuPixelBoard board(32, 24, 10.0);         // 32x24ドット、ズーム率10のお絵かきボードを生成
+board.setClearMode(KotsubuPixelBoard::ClearMode::Damage);  // clear()を書き込んだ範囲だけにする
+board.setUploadMode(KotsubuPixelBoard::UploadMode::Async); // 転送でGPUを待たない（前面バッファ経由）
 メインループ
     board.clear();                             // ボードを白紙にする
     int w = board.mImg.width();                // 公開メンバmImgはボードの描画内容（s3d::Image型）
     s3d::Point pos = board.toImagePos(Cursor::Pos());         // カーソル座標をイメージ座標に変換
+    s3d::Vec2 posF = board.toImagePosF(Cursor::PosF());       // 小数のイメージ座標（サブピクセルの端点用）
     if (board.checkRange(pos)) {                              // イメージの範囲内かどうかをチェック
         board.mImg[pos].set(s3d::Palette::Cyan);              // 点をレンダリング（添え字範囲に注意）
         Circle(pos, 3.0).overwrite(board.mImg, Palette::Red); // mImgはs3d::Image型と同じ扱いが可能
     }
     board.mBoardPos = { 0.0, 5.0 };            // ボードをスクロール
     board.setScale(2.0);                       // ズーム
-    board.draw();                              // ドロー
-    board.setSize(48, 36);                     // ドットサイズを変更（ボードは白紙になる。高負荷注意）
+    board.markDirty(s3d::Rect(pos.x - 3, pos.y - 3, 7, 7));  // 直接書き込んだ範囲を通知（draw()で転送される）
+    board.draw();                              // ドロー（変更範囲のうち、画面に見えている部分だけをテクスチャへ転送）
+    board.setCulling(false);                   // Transformer2Dなどの下でドローするときは、見えている範囲の計算をやめる
+    board.setSize(48, 36);                     // ドットサイズを変更（ボードは白紙になる。容量を超える拡大はプールから取り出す）
     board.mVisible = false;                    // 非表示にする
+
+・計測（#include の前に KOTSUBU_PIXEL_BOARD_STATS を定義したときだけ有効。未定義なら何も残らない）
+#define KOTSUBU_PIXEL_BOARD_STATS
+const auto& st = board.stats().last;           // 直前のフレーム（draw()からdraw()まで）の計測値
+Print << st.clearTime << U" " << st.writtenPixels << U" " << st.uploadedBytes;
+board.drawStats(font, Vec2(10, 10));           // 計測値とフレーム時間のヒストグラムを画面に表示
+＜注意＞ KOTSUBU_PIXEL_BOARD_STATS は、プロジェクト全体（すべての翻訳単位）で定義をそろえること。
+ボードの計測値のメンバは定義によらず持つので配置はずれないが、定義しなかった翻訳単位の書き込みや時間は数えない
+
+・プール（setSize()で容量を超えたときや、形式を切り替えたときに手放したイメージとテクスチャを、ボードの間で使い回す）
+const auto& ps = KotsubuBoardPool::shared().stats();     // 取り出しの回数
+Print << ps.hitRate();                                    // プールにあった割合
+KotsubuBoardPool::shared().trim();                        // 取っておいたものを解放する
+
+・8bitの形式（1ドット1バイト。メモリ、clear()、テクスチャへの転送がRGBA8の1/4になる）
+board.setFormat(KotsubuPixelBoard::Format::Alpha8);       // 単色のボード（ボードは白紙になる）。mImgの代わりにmImg8に書く
+board.setTint(s3d::ColorF(0.4, 0.8, 1.0));                // 表示する色（Alpha8では値がこの色のアルファになる）
+board.setFormat(KotsubuPixelBoard::Format::Palette8);     // パレットのボード（値はパレットの番号）
+board.setPalette(palette);                                // s3d::Array<s3d::Color>（256色まで。足りない番号は透明）
+board.mImg8[pos.y][pos.x] = 255;                          // 直接書いたらmarkDirty()で通知する
+renderDecayLine(board, startPos, endPos, Color(255), 0.5); // 線分のボード版は形式に合わせて書く（色のアルファを値にする）
+＜注意＞ 8bitの形式は、draw()でピクセルシェーダ（shader/kotsubu_image8.hlsl、shader/kotsubu_image8.frag）を使う。
+シェーダのファイルは実行ファイルから見て同じ相対パスに置くこと。
+8bitの形式に書けるのは、線分のボード版（renderLine(board, ...)など、renderLines()、renderLinesParallel()）だけ
+
+・疎な記憶方式（巨大なボード用。書いたところの64x64ドットのタイルだけがメモリを使う）
+KotsubuPixelBoard map(32768, 32768, 1.0);
+map.setStorage(KotsubuPixelBoard::Storage::Sparse);       // ボードは白紙になる。mImgの代わりにmSparseに書く
+renderLine(map, startPos, endPos, Color(255));            // 線分のボード版は、掛かるタイルにだけ書く
+map.mSparse.at(pos.x, pos.y) = Color(255);                // 直接書いたらmarkDirty()で通知する
+map.clear();                                              // タイルをプールに返す（メモリのコピーは無い）
+＜注意＞ 疎な記憶方式のdraw()は、setCulling()によらず画面に見えている範囲だけを転送・ドローする。
+疎な記憶方式に書けるのも、線分のボード版だけ
+
+・外部バッファ（カメラの映像やデコーダの出力など、呼び出し側のRGBA8のバッファに直接描く。コピーはテクスチャへの転送だけ）
+KotsubuPixelBoard overlay(1, 1, 1.0);
+overlay.bindExternal(frame.data, 1280, 720, frame.strideBytes);  // 行の間隔は幅より広くてもよい（0なら幅ちょうど）
+renderLine(overlay, startPos, endPos, Color(255, 0, 0));  // 線分のボード版は、バッファに直接書く
+overlay.markDirtyAll();                                   // バッファをボードの外で書き換えたら通知する
+overlay.draw();                                           // バッファからテクスチャへ直接転送する
+overlay.bindExternal(nextFrame.data, 1280, 720, frame.strideBytes);  // 次のバッファに結び直す
+overlay.setStorage(KotsubuPixelBoard::Storage::Dense);    // バッファを手放して、ボード自身のイメージに戻す（白紙）
+＜注意＞ バッファは、結び直すかsetStorage()で戻すまで生存させること。clear()はバッファを0で埋める。
+外部バッファに書けるのは、線分のボード版とkotsubu_command_buffer.h、kotsubu_stroke_recorder.hだけ（mImgは空）
 **************************************************************************************************/
 
-#pragma once
-#include <Siv3D.hpp>
+#pragma once
+#include <Siv3D.hpp>
+#include <chrono>
+
+
+
+// 【マクロ】ボードの計測区間（KOTSUBU_PIXEL_BOARD_STATS が未定義なら何もしない）
+// スコープの終わりまでの時間を、ボードの今のフレームの計測値（kind: Clear, Render, Upload, Draw）に足す
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+#define KOTSUBU_BOARD_STATS_SCOPE(board, kind) \
+    const KotsubuPixelBoard::StatsScope kotsubuStatsScope_##kind((board), KotsubuPixelBoard::StatsTimer::kind)
+#else
+#define KOTSUBU_BOARD_STATS_SCOPE(board, kind) static_cast<void>(0)
+#endif
+
+// 【マクロ】書いた点の数を数える（KOTSUBU_PIXEL_BOARD_STATS が未定義なら何もしない）
+// レンダリング関数が点を書くところで、書いた点の数を足す。計測区間の間に足した分が、ボードの計測値になる
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+#define KOTSUBU_BOARD_STATS_WRITTEN(count) (kotsubu_detail::writtenPixels() += (count))
+#else
+#define KOTSUBU_BOARD_STATS_WRITTEN(count) static_cast<void>(0)
+#endif
+
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+namespace kotsubu_detail
+{
+    // 【内部関数】このスレッドで書いた点の数（計測用。補助スレッドの分は、parallelFor()の終わりに呼び出し元のスレッドへ移す）
+    inline s3d::int64& writtenPixels()
+    {
+        thread_local s3d::int64 count = 0;
+        return count;
+    }
+}
+#endif
+
+
+
+// 【クラス】8bitのイメージ（1ドット1バイト）。KotsubuPixelBoardの8bitの形式の描画内容
+// 4ドットずつs3d::Colorの1点（r, g, b, aの順）に詰めて持つので、行の長さは4ドット単位に切り上がる。
+// 詰めたイメージはそのまま32bitのテクスチャへ転送でき、ピクセルシェーダで1ドットずつ取り出す
+class KotsubuImage8
+{
+private:
+    s3d::Image mPacked;  // 4ドットずつ詰めたイメージ
+    s3d::int32 mWidth;
+    s3d::int32 mHeight;
+
+
+
+public:
+    // 【コンストラクタ】
+    KotsubuImage8()
+    {
+        mWidth  = 0;
+        mHeight = 0;
+    }
+
+
+
+    // 【メソッド】サイズを変えて、すべて0にする（容量が足りていればメモリを再確保しない）
+    void resize(size_t width, size_t height)
+    {
+        mPacked.resize(packedWidth(width), height);
+        mWidth  = static_cast<s3d::int32>(width);
+        mHeight = static_cast<s3d::int32>(height);
+        fill(0);
+    }
+
+
+
+    // 【メソッド】メモリを解放して、サイズを0にする
+    void release()
+    {
+        mPacked = s3d::Image();
+        mWidth  = 0;
+        mHeight = 0;
+    }
+
+
+
+    // 【メソッド】すべての点をvalueにする
+    void fill(s3d::uint8 value)
+    {
+        std::fill_n(reinterpret_cast<s3d::uint8*>(mPacked.data()), mPacked.num_pixels() * sizeof(s3d::Color), value);
+    }
+
+
+
+    // 【ゲッタ】サイズ（ドット単位）
+    s3d::int32 width()  const { return mWidth; }
+    s3d::int32 height() const { return mHeight; }
+
+    // 【ゲッタ】1行分のバイト数（4ドット単位に切り上げた幅）
+    s3d::int32 stride() const { return mPacked.width() * static_cast<s3d::int32>(sizeof(s3d::Color)); }
+
+    // 【ゲッタ】4ドットずつ詰めたイメージ（テクスチャへの転送用）
+    const s3d::Image& packed() const { return mPacked; }
+
+
+
+    // 【演算子】行の先頭（添え字はs3d::Imageと同じく[y][x]）
+    s3d::uint8* operator[](size_t y)
+    {
+        return reinterpret_cast<s3d::uint8*>(mPacked[y]);
+    }
+
+    const s3d::uint8* operator[](size_t y) const
+    {
+        return reinterpret_cast<const s3d::uint8*>(mPacked[y]);
+    }
+
+    s3d::uint8& operator[](s3d::Point pos)
+    {
+        return (*this)[pos.y][pos.x];
+    }
+
+
+
+    // 【関数】詰めたイメージの幅（4ドットで1点）
+    static size_t packedWidth(size_t width)
+    {
+        return (width + 3) / 4;
+    }
+};
+
+
+
+// 【クラス】呼び出し側が持つRGBA8のバッファを、イメージとして扱う窓（KotsubuPixelBoardの外部バッファ）
+// メモリは持たず、確保も解放もしない（コピーしても同じバッファを指す）。点はs3d::Colorと同じr, g, b, aの順。
+// 行の間隔（ストライド）は幅より広くてもよい（カメラの映像など、行の末尾に詰め物のあるバッファ）
+class KotsubuImageView
+{
+private:
+    s3d::Color* mData;
+    s3d::int32  mWidth;
+    s3d::int32  mHeight;
+    size_t      mStride;  // 1行分のドット数
+
+
+
+public:
+    // 【コンストラクタ】
+    KotsubuImageView()
+    {
+        mData   = nullptr;
+        mWidth  = 0;
+        mHeight = 0;
+        mStride = 0;
+    }
+
+    // strideBytesは行の先頭から次の行の先頭までのバイト数（4の倍数。0なら幅ちょうど）
+    KotsubuImageView(void* data, size_t width, size_t height, size_t strideBytes = 0)
+    {
+        mData   = static_cast<s3d::Color*>(data);
+        mWidth  = static_cast<s3d::int32>(width);
+        mHeight = static_cast<s3d::int32>(height);
+        mStride = (strideBytes == 0) ? width : (strideBytes / sizeof(s3d::Color));
+    }
+
+
+
+    // 【ゲッタ】サイズ（ドット単位）
+    s3d::int32 width()  const { return mWidth; }
+    s3d::int32 height() const { return mHeight; }
+
+    // 【ゲッタ】1行分のドット数とバイト数
+    size_t stride()      const { return mStride; }
+    size_t strideBytes() const { return mStride * sizeof(s3d::Color); }
+
+    // 【ゲッタ】バッファの先頭
+    s3d::Color*       data()       { return mData; }
+    const s3d::Color* data() const { return mData; }
+
+    // 【ゲッタ】バッファが無いか
+    bool isEmpty() const { return mData == nullptr; }
+
+
+
+    // 【演算子】行の先頭（添え字はs3d::Imageと同じく[y][x]）
+    s3d::Color* operator[](size_t y)
+    {
+        return mData + y * mStride;
+    }
+
+    const s3d::Color* operator[](size_t y) const
+    {
+        return mData + y * mStride;
+    }
+
+    s3d::Color& operator[](s3d::Point pos)
+    {
+        return (*this)[pos.y][pos.x];
+    }
+};
+
+
+
+// 【クラス】疎なタイルのイメージ。KotsubuPixelBoardの疎な記憶方式（Storage::Sparse）の描画内容
+// イメージを64x64ドットのタイルに分け、最初に書くときにだけタイルを割り当てる。割り当てていないタイルは白紙として読める。
+// タイルのメモリはプールで使い回す（clear()はタイルをプールに返すだけで、メモリのコピーも解放もしない）
+class KotsubuSparseImage
+{
+public:
+    // 【定数】タイルの大きさ（ドット）
+    static constexpr s3d::int32 TileShift = 6;
+    static constexpr s3d::int32 TileSize  = 1 << TileShift;
+    static constexpr size_t     TileDots  = static_cast<size_t>(TileSize) * TileSize;
+
+
+
+private:
+    s3d::Array<s3d::Color*>                  mTiles;    // タイルごとの点（割り当てていなければnullptr）
+    s3d::Array<s3d::uint32>                  mUsed;     // 割り当て中のタイルの番号
+    s3d::Array<std::unique_ptr<s3d::Color[]>> mStorage;  // プールが確保したタイルのメモリ（すべて）
+    s3d::Array<s3d::Color*>                  mFree;     // プールの空きタイル
+    s3d::int32                               mWidth;
+    s3d::int32                               mHeight;
+    s3d::int32                               mTilesX;
+    s3d::int32                               mTilesY;
+
+
+
+public:
+    // 【定数】白紙の色（割り当てていないタイルの点）
+    static constexpr s3d::Color Blank{ 0, 0, 0, 0 };
+
+
+
+    // 【コンストラクタ】
+    KotsubuSparseImage()
+    {
+        mWidth  = 0;
+        mHeight = 0;
+        mTilesX = 0;
+        mTilesY = 0;
+    }
+
+
+
+    // 【メソッド】サイズを変えて、すべて白紙にする（タイルはプールに返す）
+    void resize(size_t width, size_t height)
+    {
+        clear();
+        mWidth  = static_cast<s3d::int32>(width);
+        mHeight = static_cast<s3d::int32>(height);
+        mTilesX = (mWidth  + TileSize - 1) >> TileShift;
+        mTilesY = (mHeight + TileSize - 1) >> TileShift;
+        mTiles.assign(static_cast<size_t>(mTilesX) * mTilesY, nullptr);
+    }
+
+
+
+    // 【メソッド】すべて白紙にする。割り当て中のタイルをプールに返すだけ（O(割り当て中のタイルの数)）
+    void clear()
+    {
+        for (const auto i : mUsed) {
+            mFree.push_back(mTiles[i]);
+            mTiles[i] = nullptr;
+        }
+        mUsed.clear();
+    }
+
+
+
+    // 【メソッド】プールも含めてメモリを解放して、サイズを0にする
+    void release()
+    {
+        mTiles.clear();
+        mTiles.shrink_to_fit();
+        mUsed.clear();
+        mUsed.shrink_to_fit();
+        mFree.clear();
+        mFree.shrink_to_fit();
+        mStorage.clear();
+        mStorage.shrink_to_fit();
+        mWidth  = 0;
+        mHeight = 0;
+        mTilesX = 0;
+        mTilesY = 0;
+    }
+
+
+
+    // 【ゲッタ】サイズ（ドット単位）
+    s3d::int32 width()  const { return mWidth; }
+    s3d::int32 height() const { return mHeight; }
+
+    // 【ゲッタ】タイルの数（横、縦）
+    s3d::int32 tilesX() const { return mTilesX; }
+    s3d::int32 tilesY() const { return mTilesY; }
+
+    // 【ゲッタ】割り当て中のタイルの数と、プールが確保したタイルの数
+    size_t usedTiles()      const { return mUsed.size(); }
+    size_t allocatedTiles() const { return mStorage.size(); }
+
+
+
+    // 【メソッド】書き込み用のタイル（割り当てていなければ、プールから白紙のタイルを割り当てる）
+    // タイルの点は行ごとにTileSize個ずつ並ぶ
+    s3d::Color* tile(s3d::int32 tx, s3d::int32 ty)
+    {
+        const size_t index = static_cast<size_t>(ty) * mTilesX + tx;
+        s3d::Color*& t = mTiles[index];
+        if (t) return t;
+
+        if (mFree.empty()) {
+            mStorage.push_back(std::make_unique<s3d::Color[]>(TileDots));
+            mFree.push_back(mStorage.back().get());
+        }
+        t = mFree.back();
+        mFree.pop_back();
+        std::fill_n(t, TileDots, Blank);
+        mUsed.push_back(static_cast<s3d::uint32>(index));
+        return t;
+    }
+
+
+
+    // 【メソッド】読み出し用のタイル（割り当てていなければnullptr。割り当てはしない）
+    const s3d::Color* findTile(s3d::int32 tx, s3d::int32 ty) const
+    {
+        return mTiles[static_cast<size_t>(ty) * mTilesX + tx];
+    }
+
+
+
+    // 【メソッド】点の読み書き（範囲のチェックはしない。書き込むとタイルが割り当てられる）
+    s3d::Color get(s3d::int32 x, s3d::int32 y) const
+    {
+        const s3d::Color* t = findTile(x >> TileShift, y >> TileShift);
+        return t ? t[((y & (TileSize - 1)) << TileShift) + (x & (TileSize - 1))] : Blank;
+    }
+
+    s3d::Color& at(s3d::int32 x, s3d::int32 y)
+    {
+        return tile(x >> TileShift, y >> TileShift)[((y & (TileSize - 1)) << TileShift) + (x & (TileSize - 1))];
+    }
+
+
+
+    // 【メソッド】範囲rectの点を、dstの位置dstPosへ写す（割り当てていないタイルの分は白紙で埋める）
+    void copyTo(const s3d::Rect& rect, s3d::Image& dst, s3d::Point dstPos) const
+    {
+        for (s3d::int32 y = rect.y; y < rect.y + rect.h; ++y) {
+            const s3d::int32 ty = y >> TileShift;
+            const s3d::int32 row = (y & (TileSize - 1)) << TileShift;
+            s3d::Color* out = dst[dstPos.y + (y - rect.y)] + dstPos.x;
+            for (s3d::int32 x = rect.x; x < rect.x + rect.w; ) {
+                const s3d::int32 tx  = x >> TileShift;
+                const s3d::int32 end = std::min((tx + 1) << TileShift, rect.x + rect.w);
+                const s3d::Color* t  = findTile(tx, ty);
+                if (t) std::copy_n(t + row + (x & (TileSize - 1)), end - x, out);
+                else   std::fill_n(out, end - x, Blank);
+                out += end - x;
+                x = end;
+            }
+        }
+    }
+};
+
+
+
+// 【クラス】ボードのイメージと動的テクスチャのプール（プロセスで1つ。KotsubuBoardPool::shared()）
+// 幅と高さをサイズクラス（2のべき乗を4等分した刻み）に切り上げて確保し、手放されたものを取っておいて使い回す。
+// setSize()で容量を超えて拡大したときや、形式・記憶方式を切り替えたときの再確保を、
+// 別のボードが手放したものも含めて、プールからの取り出しで済ませる（サイズのスライダーを動かしたときの負荷の山を抑える）
+// ＜注意＞ メインスレッドからだけ使う（ボードのsetSize()やdraw()と同じ）
+class KotsubuBoardPool
+{
+public:
+    // 【型】取り出しの回数（プールにあった回数と、新たに確保した回数）
+    struct Stats
+    {
+        s3d::int64 imageHits     = 0;
+        s3d::int64 imageMisses   = 0;
+        s3d::int64 textureHits   = 0;
+        s3d::int64 textureMisses = 0;
+
+        // 【ゲッタ】ヒット率（0.0～1.0。まだ取り出していなければ0.0）
+        double hitRate() const
+        {
+            const s3d::int64 total = imageHits + imageMisses + textureHits + textureMisses;
+            return (total > 0) ? static_cast<double>(imageHits + textureHits) / total : 0.0;
+        }
+    };
+
+
+
+private:
+    // 【内部型】手放されたイメージ。容量は確保したドット数（これ以下のサイズならresize()で再確保しない）
+    struct PooledImage
+    {
+        s3d::Image img;
+        size_t     capacity;
+    };
+
+    // 【内部フィールド】
+    s3d::Array<PooledImage>         mImages;    // 手放された順（いっぱいなら古いものから捨てる）
+    s3d::Array<s3d::DynamicTexture> mTextures;
+    Stats                           mStats;
+
+    // 種類ごとに取っておく数の上限
+    static constexpr size_t MaxPooled = 8;
+
+    // 要求より大きすぎるものは使い回さない（サイズクラスの面積のこの倍まで）
+    static constexpr size_t MaxWasteRate = 2;
+
+    // サイズクラスの最小値（ドット）
+    static constexpr size_t MinClass = 64;
+
+
+
+public:
+    // 【メソッド】プロセスで共有のプール
+    static KotsubuBoardPool& shared()
+    {
+        static KotsubuBoardPool pool;
+        return pool;
+    }
+
+
+
+    // 【メソッド】サイズクラス（n以上で、nを含む2のべき乗の区間を4等分した刻みの値。最小はMinClass）
+    static size_t sizeClass(size_t n)
+    {
+        if (n <= MinClass) return MinClass;
+        size_t base = MinClass;
+        while (base * 2 <= n) base *= 2;
+        const size_t step = base / 4;
+        return (n + step - 1) / step * step;
+    }
+
+
+
+    // 【メソッド】width x heightのイメージを取り出す（内容は不定）。capacityには確保済みのドット数が入る
+    // 容量の足りる一番小さいものを使い回し、無ければサイズクラスの大きさで確保してから縮める
+    s3d::Image acquireImage(size_t width, size_t height, size_t& capacity)
+    {
+        const size_t need  = width * height;
+        const size_t limit = sizeClass(width) * sizeClass(height) * MaxWasteRate;
+        size_t best = mImages.size();
+        for (size_t i = 0; i < mImages.size(); ++i) {
+            const size_t c = mImages[i].capacity;
+            if ((c >= need) && (c <= limit) && ((best == mImages.size()) || (c < mImages[best].capacity))) best = i;
+        }
+
+        s3d::Image img;
+        if (best < mImages.size()) {
+            img      = std::move(mImages[best].img);
+            capacity = mImages[best].capacity;
+            mImages.erase(mImages.begin() + best);
+            ++mStats.imageHits;
+        }
+        else {
+            img      = s3d::Image(sizeClass(width), sizeClass(height));
+            capacity = img.num_pixels();
+            ++mStats.imageMisses;
+        }
+        img.resize(width, height);
+        return img;
+    }
+
+
+
+    // 【メソッド】イメージをプールに返す（空なら何もしない）。imgは空になる
+    void releaseImage(s3d::Image& img, size_t capacity)
+    {
+        if (!img.isEmpty() && (capacity > 0)) {
+            if (mImages.size() == MaxPooled) mImages.erase(mImages.begin());
+            mImages.push_back(PooledImage{ std::move(img), capacity });
+        }
+        img = s3d::Image();
+    }
+
+
+
+    // 【メソッド】width x height以上の動的テクスチャを取り出す（内容は不定。左上の部分を使う）
+    // 収まる一番小さいものを使い回し、無ければサイズクラスの大きさで作る
+    s3d::DynamicTexture acquireTexture(size_t width, size_t height)
+    {
+        const s3d::int64 limit = static_cast<s3d::int64>(sizeClass(width) * sizeClass(height) * MaxWasteRate);
+        auto area = [](const s3d::DynamicTexture& t) { return static_cast<s3d::int64>(t.width()) * t.height(); };
+        size_t best = mTextures.size();
+        for (size_t i = 0; i < mTextures.size(); ++i) {
+            const s3d::DynamicTexture& t = mTextures[i];
+            if ((t.width() >= static_cast<s3d::int32>(width)) && (t.height() >= static_cast<s3d::int32>(height)) &&
+                (area(t) <= limit) && ((best == mTextures.size()) || (area(t) < area(mTextures[best])))) best = i;
+        }
+
+        if (best < mTextures.size()) {
+            s3d::DynamicTexture tex = mTextures[best];
+            mTextures.erase(mTextures.begin() + best);
+            ++mStats.textureHits;
+            return tex;
+        }
+        ++mStats.textureMisses;
+        return s3d::DynamicTexture(sizeClass(width), sizeClass(height));
+    }
+
+
+
+    // 【メソッド】動的テクスチャをプールに返す（空なら何もしない）。texは空になる
+    void releaseTexture(s3d::DynamicTexture& tex)
+    {
+        if (!tex.isEmpty()) {
+            if (mTextures.size() == MaxPooled) mTextures.erase(mTextures.begin());
+            mTextures.push_back(tex);
+        }
+        tex.release();
+    }
+
+
+
+    // 【メソッド】取っておいたものをすべて解放する
+    void trim()
+    {
+        mImages.clear();
+        mTextures.clear();
+    }
+
+
+
+    // 【ゲッタ】取り出しの回数とヒット率
+    const Stats& stats() const
+    {
+        return mStats;
+    }
+
+
+
+    // 【ゲッタ】取っておいているイメージのバイト数（テクスチャは含まない）
+    size_t pooledImageBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& p : mImages)
+            bytes += p.capacity * sizeof(s3d::Color);
+        return bytes;
+    }
+};
+
+
+
+class KotsubuPixelBoard
+{
+public:
+    // 【型】描画内容の形式
+    // RGBA8    --- mImg（s3d::Image）に書く。1ドット4バイト
+    // Alpha8   --- mImg8に書く。値はアルファで、draw()でsetTint()の色を付ける
+    // Palette8 --- mImg8に書く。値はパレットの番号で、draw()でsetPalette()の色に置き換える
+    // 8bitの形式では、ブランクイメージも持たない（白紙は値0）
+    enum class Format { RGBA8, Alpha8, Palette8 };
+
+    // 【型】描画内容の記憶方式
+    // Dense  --- イメージ全体を確保する（mImgかmImg8）
+    // Sparse --- mSparseに書く。64x64ドットのタイルを最初に書くときに割り当て、書いていないところは白紙（透明）。
+    //            ブランクイメージも全体のテクスチャも持たず、draw()は画面に見えている範囲だけを転送・ドローする。
+    //            形式はRGBA8だけ（8bitの形式にするとDenseに戻る）。巨大なボード（32kx32kドットなど）向け
+    // External --- 呼び出し側のRGBA8のバッファ（mExternal）にそのまま書き、そこから転送する（bindExternal()で切り替える）。
+    //            コピーはテクスチャへの転送だけ。サイズはバッファで決まる（setSize()は何もしない）。形式はRGBA8だけ
+    enum class Storage { Dense, Sparse, External };
+
+    // 【型】clear()の方式
+    // Full   --- 全体を0で埋める
+    // Damage --- 前回のclear()以降に書き込まれた範囲だけを0に戻す（疎な描画向け）。
+    //            mImgへ直接書き込んだときは、markDirty()で範囲を通知しておくこと
+    enum class ClearMode { Full, Damage };
+
+    // 【型】draw()のテクスチャへの転送の方式
+    // Direct --- mImgの変更範囲をそのまま転送する（GPUが使用中なら待つ）
+    // Async  --- mImg（背面バッファ）の変更範囲のうち見えている部分を前面バッファに写してから、GPUが空いているときだけ
+    //            まだ転送していない範囲をまとめた矩形を転送する。空いていなければ次のdraw()でまた試す（表示は最大で数フレーム遅れる）。
+    //            Directとの違いは、draw()がGPUの使用中のテクスチャを待たないこと（転送を見送る）と、
+    //            転送を待つ間の内容を前面バッファが持つので、draw()の後すぐmImgを描き直してよいこと。
+    //            その代わり、前面バッファ（テクスチャと同じサイズ）の分のメモリと、写すコピーが増える。
+    //            mImgは常に背面バッファなので、書き込み方は変わらない。GPUの待ちが目立つ、毎フレーム描き直す用途向け
+    enum class UploadMode { Direct, Async };
+
+    // 【型】計測区間の種類
+    // Clear  --- clear()
+    // Render --- レンダリング関数のボード版（renderLine(board, ...)など。変更範囲の通知も含む）
+    // Upload --- draw()のテクスチャへの転送（mTex.fill()やfillRegion()）
+    // Draw   --- draw()のスケーリングしたドロー
+    enum class StatsTimer { Clear, Render, Upload, Draw };
+
+    // 【型】1フレーム分の計測値（時間は秒）
+    struct FrameStats
+    {
+        double     clearTime      = 0.0;
+        double     renderTime     = 0.0;
+        double     uploadTime     = 0.0;
+        double     drawTime       = 0.0;
+        double     frameTime      = 0.0;  // 前回のdraw()からの経過時間（メインループ1周分）
+        s3d::int64 clearedBytes   = 0;    // clear()でブランクに戻したバイト数
+        s3d::int64 writtenPixels  = 0;    // レンダリング関数が書いた点の数（疑似AAの点を含む。合成で変わらなかった点も数える。
+                                          // mImgへ直接書いた点と、GPUで描いた点は数えない）
+        s3d::int64 uploadedBytes  = 0;    // テクスチャへ転送したバイト数
+        s3d::int32 texReallocs    = 0;    // setSize()でテクスチャを作り直した回数
+    };
+
+    // 【型】計測結果
+    // フレーム時間のヒストグラムは直近HistoryLengthフレーム分。
+    // 区間の幅はHistogramStep秒で、最後の区間はそれ以上のすべてを数える
+    struct Stats
+    {
+        static constexpr size_t HistoryLength  = 120;
+        static constexpr size_t HistogramCount = 16;
+        static constexpr double HistogramStep  = 0.002;
+
+        FrameStats current;                      // 計測中のフレーム
+        FrameStats last;                         // 直前のフレーム
+        double     history[HistoryLength] = {};  // フレーム時間の記録（リングバッファ）
+        size_t     historyHead  = 0;             // 次に書き込む位置
+        size_t     historyCount = 0;
+        s3d::int32 histogram[HistogramCount] = {};
+
+        static size_t histogramIndex(double frameTime)
+        {
+            const double i = frameTime / HistogramStep;
+            return (i < static_cast<double>(HistogramCount - 1)) ? static_cast<size_t>(std::max(i, 0.0))
+                                                                  : (HistogramCount - 1);
+        }
+    };
+
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+    // 【型】計測区間（KOTSUBU_BOARD_STATS_SCOPEマクロから使う）
+    // 区間の時間と、区間の間にこのスレッドで書いた点の数（KOTSUBU_BOARD_STATS_WRITTEN）をボードに足す
+    class StatsScope
+    {
+    public:
+        StatsScope(KotsubuPixelBoard& board, StatsTimer kind)
+            : mTime(board.statsTime(kind)), mWritten(board.mStats.current.writtenPixels),
+              mStart(std::chrono::steady_clock::now()), mWrittenStart(kotsubu_detail::writtenPixels())
+        {}
+
+        ~StatsScope()
+        {
+            mTime    += std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+            mWritten += kotsubu_detail::writtenPixels() - mWrittenStart;
+        }
+
+        StatsScope(const StatsScope&)            = delete;
+        StatsScope& operator=(const StatsScope&) = delete;
+
+    private:
+        double&                               mTime;
+        s3d::int64&                           mWritten;
+        std::chrono::steady_clock::time_point mStart;
+        s3d::int64                            mWrittenStart;
+    };
+#endif
+
+
+
+private:
+    // 【内部フィールド】
+    double                mScale;
+    size_t                mWidth;           // 現在のサイズ（ドット単位）。インスタンスごとに持つ
+    size_t                mHeight;
+    size_t                mImgCapacity;     // mImgの確保済みのドット数（これ以下のサイズならメモリを再確保しない）
+    s3d::DynamicTexture   mTex;             // 確保済みのサイズはイメージ以上（左上の部分を使う）。KotsubuBoardPoolから取り出す
+    s3d::Array<s3d::Rect> mDirtyRects;      // 次のdraw()でテクスチャへ転送する範囲
+    s3d::Array<s3d::Rect> mOffscreenRects;  // draw()の作業用。画面外のため転送を見送った範囲
+    s3d::Array<s3d::Rect> mDrawnRects;      // 前回のclear()以降に書き込まれた範囲
+    bool                  mDirtyAll;        // 全体を転送するかどうか
+    s3d::int64            mDirtyArea;       // mDirtyRectsの面積の合計（重なりは考慮しない）
+    double                mFullUploadRate;  // 全体転送に切り替える面積の割合
+    bool                  mCulling;         // draw()で画面に見えている範囲だけを転送・ドローするかどうか
+
+    // 差分クリア用。前回のclear()以降に書き込まれた行ごとのx範囲（minX > maxXなら未使用の行）
+    s3d::Array<s3d::int32> mSpanMinX;
+    s3d::Array<s3d::int32> mSpanMaxX;
+    s3d::Array<s3d::int32> mSpanRows;       // 書き込みのあった行の一覧
+    s3d::int64             mSpanArea;       // 各行の範囲の合計ドット数
+    bool                   mClearAll;       // 次のclear()を全体クリアにするかどうか
+    ClearMode              mClearMode;
+
+    // 転送用。UploadMode::Asyncのときの前面バッファ（テクスチャと同じサイズ）
+    s3d::Image             mFrontImg;
+    s3d::Rect              mPendingRect;    // 前面バッファに写して、まだ転送していない範囲をまとめた矩形（テクセル単位。空なら無し）
+    UploadMode             mUploadMode;
+
+    // 8bitの形式用。パレットはテクスチャ（256x1）にしてシェーダで引く
+    Format                  mFormat;
+    s3d::ColorF             mTint;          // ドローする色（頂点色として掛ける）
+    s3d::Array<s3d::Color>  mPalette;       // Palette8のパレット
+    s3d::Texture            mPaletteTex;
+    bool                    mPaletteDirty;  // 次のdraw()でパレットのテクスチャを作り直すかどうか
+    s3d::PixelShader        mShader8;
+
+    // 疎な記憶方式用。テクスチャには、見えている範囲（mSparseView）だけを写して転送する
+    Storage                 mStorage;
+    s3d::Rect               mSparseView;    // テクスチャに入っているイメージの範囲
+    s3d::Image              mViewImg;       // 転送元（見えている範囲をタイルから写す）
+
+    // 矩形リストの上限。超えたら外接矩形にまとめる（部分転送の呼び出し回数を抑える）
+    static constexpr size_t MaxDirtyRects = 32;
+
+    // コンポジタ（kotsubu_board_compositor.h）は、変更範囲を受け取ってアトラスへ転送する
+    friend class KotsubuBoardCompositor;
+
+    // 詳細度（kotsubu_board_lod.h）は、縮小した段を作るときにイメージの行を読み、縮小した段を出す間はテクスチャを手放す
+    friend class KotsubuBoardLod;
+
+    // GPUの線分（kotsubu_gpu_line_renderer.h）は、レンダーテクスチャに描く間はテクスチャを手放し、読み戻したら全体を転送させる
+    friend class KotsubuGpuLineRenderer;
+
+    // 計測値（KOTSUBU_PIXEL_BOARD_STATS の定義によらず持つ。未定義なら使わない）
+    Stats                                 mStats;
+    std::chrono::steady_clock::time_point mLastFrame;
+    bool                                  mHasLastFrame = false;
+
+
+
+public:
+    // 【公開フィールド】
+    s3d::Vec2          mBoardPos;  // ピクセルボードの左上位置
+    s3d::Image         mImg;       // 描画用イメージ。これに直接.set()などで書き込んで.draw()（RGBA8のとき）
+    KotsubuImage8      mImg8;      // 8bitの描画用イメージ（Alpha8, Palette8のとき。RGBA8なら空）
+    KotsubuSparseImage mSparse;    // 疎な描画用イメージ（Storage::Sparseのとき。mImgは空）
+    KotsubuImageView   mExternal;  // 外部バッファ（Storage::Externalのとき。mImgは空）
+    bool               mVisible;   // 表示非表示の切り替え
+
+
+
+    // 【コンストラクタ】
+    KotsubuPixelBoard() : KotsubuPixelBoard(s3d::Window::Width(), s3d::Window::Height(), 1.0)
+    {}
+
+    KotsubuPixelBoard(size_t width, size_t height, double scale = 1.0)
+    {
+        mVisible = true;
+        mWidth  = 0;
+        mHeight = 0;
+        mImgCapacity = 0;
+        mDirtyAll = true;
+        mDirtyArea = 0;
+        mFullUploadRate = 0.5;
+        mCulling = true;
+        mSpanArea = 0;
+        mClearAll = true;
+        mClearMode = ClearMode::Full;
+        mPendingRect = s3d::Rect(0, 0, 0, 0);
+        mUploadMode = UploadMode::Direct;
+        mFormat = Format::RGBA8;
+        mTint = s3d::ColorF(1.0);
+        mPaletteDirty = true;
+        mStorage = Storage::Dense;
+        mSparseView = s3d::Rect(0, 0, 0, 0);
+        setScale(scale);
+        setSize(width, height);
+    }
+
+
+
+    // 【セッタ】ズーム率
+    void setScale(double scale)
+    {
+        if (scale < 0.0) scale = 0.0;
+        mScale = scale;
+    }
+
+
+
+    // 【ゲッタ】ズーム率
+    double getScale()
+    {
+        return mScale;
+    }
+
+
+
+    // 【セッタ】全体転送に切り替える面積の割合（0.0～1.0）
+    // 変更範囲の面積の合計がボードの面積×rateを超えたら、draw()は部分転送をやめて全体を転送する。
+    // 部分転送は1矩形ごとに転送処理が走るので、変更が広いときは全体転送の方が速い
+    void setFullUploadRate(double rate)
+    {
+        if (rate < 0.0) rate = 0.0;
+        if (rate > 1.0) rate = 1.0;
+        mFullUploadRate = rate;
+    }
+
+
+
+    // 【セッタ】draw()で、画面（ウィンドウ）に見えている範囲だけを転送・ドローするかどうか（既定はする）
+    // 見えている範囲は、mBoardPosとズーム率から求める（toImagePos()の逆）。画面外の変更範囲は、見えたときに転送する。
+    // Transformer2Dやカメラの下でドローするときは、位置が合わないのでfalseにする
+    void setCulling(bool culling)
+    {
+        mCulling = culling;
+    }
+
+
+
+    // 【セッタ】clear()の方式
+    void setClearMode(ClearMode mode)
+    {
+        mClearMode = mode;
+    }
+
+
+
+    // 【セッタ】draw()の転送の方式
+    // Directに戻すときは、前面バッファを解放し、次のdraw()で全体を転送する
+    void setUploadMode(UploadMode mode)
+    {
+        if (mode == mUploadMode) return;
+        mUploadMode = mode;
+        if (mode == UploadMode::Direct) {
+            mFrontImg = s3d::Image();
+            mPendingRect = s3d::Rect(0, 0, 0, 0);
+        }
+        mDirtyAll = true;
+        mDirtyRects.clear();
+        mDirtyArea = 0;
+    }
+
+
+
+    // 【セッタ】描画内容の形式
+    // RGBA8と8bitの形式を切り替えると、ボードは白紙になる（使わなくなった方のイメージは解放する）。
+    // Alpha8とPalette8の間では、値をそのまま使う。8bitの形式にしたときに、シェーダを読み込む
+    void setFormat(Format format)
+    {
+        if (format == mFormat) return;
+        if (format != Format::RGBA8) setStorage(Storage::Dense);
+        const bool was8bit = is8bit();
+        mFormat = format;
+        mPaletteDirty = true;
+        if (was8bit == is8bit()) return;
+
+        if (is8bit()) {
+            releaseImage();
+            if (!mShader8)
+                mShader8 = s3d::HLSL{ U"shader/kotsubu_image8.hlsl", U"PS" } |
+                           s3d::GLSL{ U"shader/kotsubu_image8.frag", { { U"PSConstants2D", 0 } } };
+        }
+        else {
+            mImg8.release();
+        }
+
+        // テクスチャの幅の単位が変わるので作り直し（プールに返す）、今のサイズで作り直す
+        releaseTexture();
+        mFrontImg = s3d::Image();
+        mPendingRect = s3d::Rect(0, 0, 0, 0);
+        const size_t width = mWidth, height = mHeight;
+        mWidth  = 0;
+        mHeight = 0;
+        setSize(width, height);
+    }
+
+
+
+    // 【セッタ】描画内容の記憶方式
+    // 切り替えると、ボードは白紙になる（使わなくなった方のイメージは解放する）。Sparseにすると形式はRGBA8になる
+    // Externalへは、bindExternal()で切り替える（ここでは何もしない）。Externalから切り替えると、外部バッファを手放す
+    void setStorage(Storage storage)
+    {
+        if ((storage == mStorage) || (storage == Storage::External)) return;
+        if (storage == Storage::Sparse) setFormat(Format::RGBA8);
+        mStorage  = storage;
+        mExternal = KotsubuImageView();
+
+        if (isSparse()) {
+            releaseImage();
+        }
+        else {
+            mSparse.release();
+            mViewImg = s3d::Image();
+        }
+
+        // テクスチャの大きさの意味が変わるので作り直し（プールに返す）、今のサイズで作り直す
+        releaseTexture();
+        mFrontImg = s3d::Image();
+        mPendingRect = s3d::Rect(0, 0, 0, 0);
+        mSparseView = s3d::Rect(0, 0, 0, 0);
+        const size_t width = mWidth, height = mHeight;
+        mWidth  = 0;
+        mHeight = 0;
+        setSize(width, height);
+    }
+
 
 
+    // 【ゲッタ】描画内容の記憶方式
+    Storage getStorage() const
+    {
+        return mStorage;
+    }
 
-class KotsubuPixelBoard
-{
-    // 【内部フィールド】
-    double              mScale;
-    s3d::Image          mBlankImg;
-    s3d::DynamicTexture mTex;
 
 
+    // 【ゲッタ】疎な記憶方式（mSparseに書く）かどうか
+    bool isSparse() const
+    {
+        return mStorage == Storage::Sparse;
+    }
 
-public:
-    // 【公開フィールド】
-    s3d::Vec2  mBoardPos;  // ピクセルボードの左上位置
-    s3d::Image mImg;       // 描画用イメージ。これに直接.set()などで書き込んで.draw()
-    bool       mVisible;   // 表示非表示の切り替え
 
 
+    // 【ゲッタ】外部バッファ（mExternalに書く）かどうか
+    bool isExternal() const
+    {
+        return mStorage == Storage::External;
+    }
 
-    // 【コンストラクタ】
-    KotsubuPixelBoard() : KotsubuPixelBoard(s3d::Window::Width(), s3d::Window::Height(), 1.0)
-    {}
 
-    KotsubuPixelBoard(size_t width, size_t height, double scale = 1.0)
+
+    // 【メソッド】呼び出し側のRGBA8のバッファを、描画内容にする（Storage::Externalにする。形式はRGBA8になる）
+    // 線分のボード版やclear()はバッファに直接書き、draw()はバッファからテクスチャへ転送する（コピーは転送だけ）。
+    // strideBytesは行の先頭から次の行の先頭までのバイト数（4の倍数。0なら幅ちょうど）。引数が正しくなければfalse。
+    // 同じボードに別のバッファ（次のフレームなど）を結び直してもよい。バッファの内容は全体が変更範囲になる
+    // ＜注意＞ バッファは、結び直すかsetStorage()で戻すまで生存させること。
+    // バッファをボードの外で書き換えたら、markDirty()かmarkDirtyAll()で通知する
+    bool bindExternal(void* data, size_t width, size_t height, size_t strideBytes = 0)
     {
-        mVisible = true;
-        setScale(scale);
-        setSize(width, height);
+        if ((data == nullptr) || (width < 1) || (height < 1)) return false;
+        if (strideBytes == 0) strideBytes = width * sizeof(s3d::Color);
+        if ((strideBytes < width * sizeof(s3d::Color)) || (strideBytes % sizeof(s3d::Color) != 0)) return false;
+
+        if (!isExternal()) {
+            setFormat(Format::RGBA8);
+            setStorage(Storage::Dense);
+            releaseImage();
+            mStorage = Storage::External;
+            mFrontImg = s3d::Image();
+            mPendingRect = s3d::Rect(0, 0, 0, 0);
+        }
+        mExternal = KotsubuImageView(data, width, height, strideBytes);
+
+        // テクスチャは、容量を超えるときだけプールに返す（setSize()と同じ）
+        if (!mTex.isEmpty() &&
+            ((static_cast<s3d::int32>(width) > mTex.width()) || (static_cast<s3d::int32>(height) > mTex.height())))
+            releaseTexture();
+
+        // 内容は分からないので、全体を転送し、次のclear()は全体クリアにする
+        mDrawnRects.clear();
+        resetSpans(height);
+        markDirtyAll();
+        mWidth  = width;
+        mHeight = height;
+        return true;
     }
 
 
 
-    // 【セッタ】ズーム率
-    void setScale(double scale)
+    // 【ゲッタ】描画内容の形式
+    Format getFormat() const
     {
-        if (scale < 0.0) scale = 0.0;
-        mScale = scale;
+        return mFormat;
     }
 
 
 
-    // 【ゲッタ】ズーム率
-    double getScale()
+    // 【ゲッタ】8bitの形式（mImg8に書く）かどうか
+    bool is8bit() const
     {
-        return mScale;
+        return mFormat != Format::RGBA8;
     }
 
 
 
-    // 【セッタ】サイズ（ドット単位）
+    // 【セッタ】ドローする色（テクスチャの色に掛ける。Alpha8では、この色に値をアルファとして掛けた色になる）
+    void setTint(const s3d::ColorF& tint)
+    {
+        mTint = tint;
+    }
+
+
+
+    // 【セッタ】Palette8のパレット（番号の順。256色を超える分は使わず、足りない番号は透明）
+    void setPalette(const s3d::Array<s3d::Color>& palette)
+    {
+        mPalette = palette;
+        mPaletteDirty = true;
+    }
+
+
+
+    // 【セッタ】サイズ（ドット単位）。外部バッファのときは何もしない（サイズはbindExternal()のバッファで決まる）
     // 設定したサイズが以前のサイズから更新した場合、描画イメージはクリアされる。
-    // ＜注意＞ この関数は負荷が高く、連続的に異なるサイズを設定するとエラーすることがある
+    // 確保済みの容量に収まる場合（縮小や、以前の大きさまでの拡大）は、イメージのメモリと
+    // テクスチャを再確保せずに使い回す。容量を超えて拡大したときは、今のものをKotsubuBoardPoolに返して
+    // サイズクラスに切り上げた大きさのものを取り出す（プールに無いときだけ新たに確保する）。
+    // ＜注意＞ 容量を超える拡大は負荷が高く、連続的に行うとエラーすることがある
     void setSize(size_t width, size_t height)
     {
-        static size_t oldWidth  = -1;
-        static size_t oldHeight = -1;
+        if (isExternal()) return;
         if (width  < 1) width  = 1;
         if (height < 1) height = 1;
-        if ((width == oldWidth) && (height == oldHeight)) return;
+        if ((width == mWidth) && (height == mHeight)) return;
 
-        // 新しいサイズのブランクイメージを作る
-        mBlankImg = s3d::Image(width, height);
+        // 描画用イメージを新しいサイズにして、0で埋める（容量内のリサイズはメモリを再確保しない）
+        // 疎な記憶方式は、タイルをプールに返すだけ
+        if      (isSparse()) mSparse.resize(width, height);
+        else if (is8bit())   mImg8.resize(width, height);
+        else {
+            if (width * height > mImgCapacity) {
+                KotsubuBoardPool& pool = KotsubuBoardPool::shared();
+                pool.releaseImage(mImg, mImgCapacity);
+                mImg = pool.acquireImage(width, height, mImgCapacity);
+            }
+            else {
+                mImg.resize(width, height);
+            }
+            std::fill_n(mImg.data(), mImg.num_pixels(), s3d::Color(0, 0, 0, 0));
+        }
 
-        // 動的テクスチャは「同じサイズ」のイメージを供給しないと更新されないため一旦解放。
+        // 動的テクスチャは、容量を超えるときだけプールに返す（次のdraw()でプールから取り出す）。
+        // 容量内なら左上の部分だけを更新・ドローする
         // ＜補足＞ テクスチャやイメージのrelease()やclear()と、draw()が別所の場合、
         // 「無い物」のアクセス発生に注意する。また、テクスチャ登録などの重い処理を
         // 連続で行った場合に、エラーすることがあるので注意する。
-        mTex.release();
+        // 疎な記憶方式のテクスチャは見えている範囲の大きさなので、ここでは作り直さない
+        const size_t texWidth = is8bit() ? KotsubuImage8::packedWidth(width) : width;
+        if (!isSparse() && !mTex.isEmpty() &&
+            ((static_cast<s3d::int32>(texWidth) > mTex.width()) ||
+             (static_cast<s3d::int32>(height)   > mTex.height()))) {
+            releaseTexture();
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+            ++mStats.current.texReallocs;
+#endif
+        }
 
-        // 描画用イメージをクリア
-        mImg = mBlankImg;
+        mDrawnRects.clear();
+        markDirtyAll();
 
-        oldWidth  = width;
-        oldHeight = height;
+        // 差分クリア用の記録を新しい高さで作り直す
+        resetSpans(height);
+        mClearAll = false;
+
+        mWidth  = width;
+        mHeight = height;
     }
 
 
@@ -111,25 +1115,224 @@ public:
     // 【メソッド】イメージを白紙に戻す
     // 現在のイメージサイズに応じた高速なクリア。また、似たような用途として
     // s3d::Imageのclear()があるが内容が破棄されてしまう。fill()は負荷が高い
+    // ClearMode::Damageのときは、書き込まれた行の範囲だけを0に戻す（O(線分の長さ)）。
+    // ＜補足＞ 書き込み済みの範囲（markDirty()で通知された範囲）だけが変化するので、そこを転送対象にする
     void clear()
     {
-        // 描画用イメージをブランクイメージで置き換える（この方法が高速）
-        mImg = mBlankImg;
+        KOTSUBU_BOARD_STATS_SCOPE(*this, Clear);
+
+        // 書き込みが広い場合はまとめて置き換えた方が速い
+        // 疎な記憶方式は、方式によらずタイルをプールに返す（メモリのコピーは無い）
+        const s3d::int64 boardArea = static_cast<s3d::int64>(mWidth) * static_cast<s3d::int64>(mHeight);
+        if (isSparse()) {
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+            mStats.current.clearedBytes += static_cast<s3d::int64>(mSparse.usedTiles() * KotsubuSparseImage::TileDots *
+                                                                   sizeof(s3d::Color));
+#endif
+            mSparse.clear();
+        }
+        else if ((mClearMode == ClearMode::Full) || mClearAll || (mSpanArea * 2 > boardArea)) {
+            // 描画用イメージを0で埋める（ブランクイメージからのコピーと違い、書き込むだけで読み出しが無い）
+            // 外部バッファは、行の間隔があるので1行ずつ
+            if (is8bit()) mImg8.fill(0);
+            else if (isExternal()) {
+                for (s3d::int32 y = 0; y < mExternal.height(); ++y)
+                    std::fill_n(mExternal[y], mExternal.width(), s3d::Color(0, 0, 0, 0));
+            }
+            else {
+                std::fill_n(mImg.data(), mImg.num_pixels(), s3d::Color(0, 0, 0, 0));
+            }
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+            mStats.current.clearedBytes += boardArea * bytesPerDot();
+#endif
+        }
+        else {
+            // 書き込まれた行の範囲だけを0で埋める
+            for (const auto y : mSpanRows) {
+                const s3d::int32 minX = mSpanMinX[y];
+                if      (is8bit())     std::fill_n(mImg8[y] + minX, mSpanMaxX[y] - minX + 1, s3d::uint8(0));
+                else if (isExternal()) std::fill_n(mExternal[y] + minX, mSpanMaxX[y] - minX + 1, s3d::Color(0, 0, 0, 0));
+                else                   std::fill_n(mImg[y] + minX, mSpanMaxX[y] - minX + 1, s3d::Color(0, 0, 0, 0));
+            }
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+            mStats.current.clearedBytes += mSpanArea * bytesPerDot();
+#endif
+        }
+
+        for (const auto y : mSpanRows) {
+            mSpanMinX[y] = std::numeric_limits<s3d::int32>::max();
+            mSpanMaxX[y] = -1;
+        }
+        mSpanRows.clear();
+        mSpanArea = 0;
+
+        if (mClearAll) {
+            markDirtyAll();
+            mClearAll = false;
+        }
+        for (const auto& rect : mDrawnRects)
+            addDirtyRect(rect);
+        mDrawnRects.clear();
+    }
+
+
+
+    // 【メソッド】イメージの変更範囲を通知する
+    // mImgに直接書き込んだときは、その範囲をここへ通知する（通知しない部分はテクスチャに反映されない）。
+    // レンダリング関数のボード版（renderLine(board, ...)など）は自動で通知する。範囲外はクリップされる
+    void markDirty(const s3d::Rect& rect)
+    {
+        const s3d::Rect clipped = clipToImage(rect);
+        if (clipped.w <= 0 || clipped.h <= 0) return;
+
+        addRect(mDrawnRects, clipped);
+        addDirtyRect(clipped);
+        for (s3d::int32 y = clipped.y; y < clipped.y + clipped.h; ++y)
+            addSpan(y, clipped.x, clipped.x + clipped.w - 1);
+    }
+
+
+
+    // 【メソッド】線分の変更範囲を通知する
+    // 転送範囲は外接矩形、差分クリアの範囲は各行で線分が通るx範囲（疑似AAの分として±1ドット）とする。
+    // ブレゼンハムの点は理想直線から0.5ドット以内にあるので、y±0.5での理想直線のx範囲に必ず収まる
+    // marginを指定すると、点が理想直線からmarginドットまで余分に離れてもよいように広げる
+    // （Wuの線分やサブピクセルの端点の線分など。外接矩形も広げる）
+    void markDirtyLine(s3d::Point startPos, s3d::Point endPos, s3d::int32 margin = 0)
+    {
+        const s3d::int32 minX = std::min(startPos.x, endPos.x) - margin;
+        const s3d::int32 maxX = std::max(startPos.x, endPos.x) + margin;
+        const s3d::int32 minY = std::min(startPos.y, endPos.y) - margin;
+        const s3d::int32 maxY = std::max(startPos.y, endPos.y) + margin;
+        const s3d::Rect clipped = clipToImage(s3d::Rect(minX, minY, maxX - minX + 1, maxY - minY + 1));
+        if (clipped.w <= 0 || clipped.h <= 0) return;
+
+        addRect(mDrawnRects, clipped);
+        addDirtyRect(clipped);
+
+        // 水平線は外接矩形の幅のまま（marginが無ければ1行だけ）
+        const s3d::int64 dx = endPos.x - startPos.x;
+        const s3d::int64 dy = endPos.y - startPos.y;
+        if (dy == 0) {
+            for (s3d::int32 y = clipped.y; y < clipped.y + clipped.h; ++y)
+                addSpan(y, clipped.x, clipped.x + clipped.w - 1);
+            return;
+        }
+
+        // 各行で、理想直線のy-0.5-marginとy+0.5+marginのときのxを求める（2倍して整数で扱う）
+        const s3d::int64 num = (dy > 0) ? dx : -dx;
+        const s3d::int64 den = std::abs(dy) * 2;
+        for (s3d::int32 y = clipped.y; y < clipped.y + clipped.h; ++y) {
+            const s3d::int64 t  = (y - startPos.y) * 2;
+            const s3d::int64 xa = floorDiv((t - 1 - 2 * margin) * num, den);
+            const s3d::int64 xb = floorDiv((t + 1 + 2 * margin) * num, den);
+            const s3d::int64 lo = startPos.x + std::min(xa, xb) - 1 - margin;
+            const s3d::int64 hi = startPos.x + std::max(xa, xb) + 2 + margin;  // 切り上げ分と疑似AA分
+            addSpan(y, static_cast<s3d::int32>(std::max<s3d::int64>(lo, clipped.x)),
+                       static_cast<s3d::int32>(std::min<s3d::int64>(hi, clipped.x + clipped.w - 1)));
+        }
+    }
+
+
+
+    // 【メソッド】イメージ全体の変更を通知する
+    // 差分クリアの記録も取れないので、次のclear()は全体クリアになる
+    void markDirtyAll()
+    {
+        mClearAll = true;
+        markUploadAll();
     }
 
 
 
     // 【メソッド】ドロー
+    // 画面に見えている範囲だけを転送・ドローし、まったく見えなければ何もしない（setCulling()）。
+    // 計測が有効なときは、ここでフレームの区切りとする（非表示でも区切る）
     void draw()
     {
-        if (mVisible) {
+        const s3d::Rect view = visibleRect();
+        if (mVisible && isSparse()) {
+            if ((view.w > 0) && (view.h > 0)) drawSparse(view);
+        }
+        else if (mVisible && (view.w > 0) && (view.h > 0)) {
             // 動的テクスチャを更新（同じ大きさでないと更新されない）
-            mTex.fill(mImg);
+            // 変更範囲のうち、見えている部分だけを部分転送する。初回や変更が広いときは全体を転送。
+            // 8bitの形式は4ドットずつ詰めたイメージを転送する（範囲はテクセル単位に直す）
+            // テクスチャが無ければプールから取り出し（内容は不定）、全体を変更範囲にする。外部バッファからは直接転送する
+            const s3d::Size srcSize = uploadSize();
+            const s3d::Rect imageRect(0, 0, srcSize.x, srcSize.y);
+            {
+                KOTSUBU_BOARD_STATS_SCOPE(*this, Upload);
+                if (mTex.isEmpty()) {
+                    mTex = KotsubuBoardPool::shared().acquireTexture(static_cast<size_t>(srcSize.x), static_cast<size_t>(srcSize.y));
+                    markUploadAll();
+                }
+
+                if (mUploadMode == UploadMode::Async) {
+                    uploadAsync(view);
+                }
+                else if (mDirtyAll && (view.w == static_cast<s3d::int32>(mWidth)) && (view.h == static_cast<s3d::int32>(mHeight))) {
+                    // 全体が見えているときだけ全体を転送
+                    // テクスチャの方が大きい（容量内で縮小した、サイズクラスに切り上げた）ときは、使う部分だけを更新
+                    // 転送できなければ、変更範囲を残して次のdraw()でやり直す
+                    const bool filled = ((mTex.size() == srcSize) && !isExternal()) ? mTex.fill(uploadImage())
+                                                                                    : fillTexture(imageRect);
+                    if (filled) {
+                        countUpload(imageRect);
+                        clearDirty();
+                    }
+                }
+                else {
+                    uploadVisible(view);
+                }
+            }
+
+            // 動的テクスチャの見えている部分だけを、スケーリングしてドロー
+            KOTSUBU_BOARD_STATS_SCOPE(*this, Draw);
+            const s3d::Vec2 pos = mBoardPos + s3d::Vec2(view.x, view.y) * mScale;
+            if (is8bit()) draw8bit(view, pos);
+            else          mTex(view).scaled(mScale).draw(pos, mTint);
+        }
+
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+        endStatsFrame();
+#endif
+    }
 
-            // 動的テクスチャをスケーリングしてドロー
-            mTex.scaled(mScale).draw(mBoardPos);
+
+
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+    // 【ゲッタ】計測結果
+    const Stats& stats() const
+    {
+        return mStats;
+    }
+
+
+
+    // 【メソッド】直前のフレームの計測値と、フレーム時間のヒストグラムをドロー
+    void drawStats(const s3d::Font& font, const s3d::Vec2& pos) const
+    {
+        const FrameStats& st = mStats.last;
+        auto ms = [](double sec) { return sec * 1000.0; };
+        font(U"frame  ", ms(st.frameTime), U" ms\n",
+             U"clear  ", ms(st.clearTime), U" ms / ", st.clearedBytes, U" B\n",
+             U"render ", ms(st.renderTime), U" ms / ", st.writtenPixels, U" px\n",
+             U"upload ", ms(st.uploadTime), U" ms / ", st.uploadedBytes, U" B\n",
+             U"draw   ", ms(st.drawTime), U" ms\n",
+             U"realloc ", st.texReallocs, U" / pool hit ", KotsubuBoardPool::shared().stats().hitRate() * 100.0, U" %").draw(pos);
+
+        // ヒストグラム（棒の高さは直近のフレーム数に対する割合）
+        constexpr double barW = 10.0, barH = 60.0;
+        const double top = pos.y + font.height() * 6 + 8.0;
+        const double count = static_cast<double>(std::max<size_t>(mStats.historyCount, 1));
+        for (size_t i = 0; i < Stats::HistogramCount; ++i) {
+            const double h = barH * mStats.histogram[i] / count;
+            s3d::RectF(pos.x + i * barW, top + barH - h, barW - 1.0, h).draw(s3d::Palette::Orange);
         }
+        s3d::RectF(pos.x, top, barW * Stats::HistogramCount, barH).drawFrame(1.0, 0.0, s3d::Palette::Gray);
     }
+#endif
 
 
 
@@ -143,6 +1346,16 @@ public:
 
 
 
+    // 【メソッド】クライアント座標をイメージ座標（小数）に変換
+    // 点(x, y)は x以上x+1未満の範囲を占める（整数部がtoImagePos()の結果）。
+    // サブピクセルの端点の線分に使う（kotsubu_line_renderer.hのtoFixedPoint()で固定小数点に直す）
+    s3d::Vec2 toImagePosF(s3d::Vec2 clientPos)
+    {
+        return (clientPos - mBoardPos) / mScale;
+    }
+
+
+
     // 【メソッド】イメージ座標をクライアント座標に変換
     // イメージ座標から、スクロール位置やズーム率を考慮したクライアント座標に変換
     s3d::Point toClientPos(s3d::Point imagePos)
@@ -155,12 +1368,446 @@ public:
     // 【メソッド】イメージ座標の範囲内かどうかを返す
     bool checkRange(s3d::Point imagePos)
     {
-        return (imagePos.x >= 0) && (imagePos.x < mImg.width()) &&
-               (imagePos.y >= 0) && (imagePos.y < mImg.height());
+        return (imagePos.x >= 0) && (imagePos.x < static_cast<s3d::int32>(mWidth)) &&
+               (imagePos.y >= 0) && (imagePos.y < static_cast<s3d::int32>(mHeight));
     }
 
     bool checkRange(s3d::Vector2D<int> imagePos)
     {
         return checkRange(imagePos.asPoint());
     }
+
+
+
+private:
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+    // 【内部メソッド】計測区間の時間を足し込む先
+    double& statsTime(StatsTimer kind)
+    {
+        switch (kind) {
+        case StatsTimer::Clear:  return mStats.current.clearTime;
+        case StatsTimer::Render: return mStats.current.renderTime;
+        case StatsTimer::Upload: return mStats.current.uploadTime;
+        default:                 return mStats.current.drawTime;
+        }
+    }
+
+
+
+    // 【内部メソッド】今のフレームを締めて、フレーム時間をヒストグラムに入れる
+    void endStatsFrame()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (mHasLastFrame) {
+            mStats.current.frameTime = std::chrono::duration<double>(now - mLastFrame).count();
+
+            // いっぱいなら一番古い記録をヒストグラムから抜く
+            if (mStats.historyCount == Stats::HistoryLength)
+                --mStats.histogram[Stats::histogramIndex(mStats.history[mStats.historyHead])];
+            else
+                ++mStats.historyCount;
+            mStats.history[mStats.historyHead] = mStats.current.frameTime;
+            ++mStats.histogram[Stats::histogramIndex(mStats.current.frameTime)];
+            mStats.historyHead = (mStats.historyHead + 1) % Stats::HistoryLength;
+        }
+        mLastFrame    = now;
+        mHasLastFrame = true;
+
+        mStats.last    = mStats.current;
+        mStats.current = FrameStats();
+    }
+#endif
+
+
+
+    // 【内部メソッド】8bitの形式のドロー（イメージのview の範囲を、クライアント座標のposにドロー）
+    // シェーダで、詰めたテクスチャから1ドットずつ値を取り出し、パレットのテクスチャ（t1）で色に置き換える。
+    // Alpha8のパレットは、白のアルファを値にしたもの（setTint()の色が掛かる）
+    void draw8bit(const s3d::Rect& view, const s3d::Vec2& pos)
+    {
+        if (!mShader8) return;
+        if (mPaletteDirty) {
+            s3d::Image palette(256, 1, s3d::Color(0, 0, 0, 0));
+            for (size_t i = 0; i < 256; ++i) {
+                if (mFormat == Format::Alpha8)  palette[0][i] = s3d::Color(255, 255, 255, static_cast<s3d::uint8>(i));
+                else if (i < mPalette.size())   palette[0][i] = mPalette[i];
+            }
+            mPaletteTex   = s3d::Texture(palette);
+            mPaletteDirty = false;
+        }
+
+        const s3d::ScopedCustomShader2D shader(mShader8);
+        s3d::Graphics2D::SetPSTexture(1, mPaletteTex);
+        const double texW = 4.0 * mTex.width(), texH = mTex.height();
+        mTex.uv(view.x / texW, view.y / texH, view.w / texW, view.h / texH)
+            .resized(view.w * mScale, view.h * mScale).draw(pos, mTint);
+    }
+
+
+
+    // 【内部メソッド】疎な記憶方式のドロー
+    // 見えている範囲が前回と同じなら、その中の変更範囲だけをタイルから写して転送する。
+    // 範囲が変わったら（スクロール、ズーム）、範囲全体を写して転送する（テクスチャは容量を超えるときだけ作り直す）。
+    // 見えていない変更範囲は、見えたときに範囲全体として転送されるので捨てる
+    void drawSparse(const s3d::Rect& view)
+    {
+        {
+            KOTSUBU_BOARD_STATS_SCOPE(*this, Upload);
+            const bool fits = !mTex.isEmpty() && (view.w <= mTex.width()) && (view.h <= mTex.height());
+            if (!fits) {
+                releaseTexture();
+                mTex = KotsubuBoardPool::shared().acquireTexture(static_cast<size_t>(view.w), static_cast<size_t>(view.h));
+                mSparseView = s3d::Rect(0, 0, 0, 0);
+            }
+            // 転送元はテクスチャと同じ大きさにする（テクスチャはサイズクラスに切り上げてあり、
+            // 見えている範囲が広がっても、テクスチャに収まる間は作り直さない）
+            if (mViewImg.size() != mTex.size())
+                mViewImg = s3d::Image(static_cast<size_t>(mTex.width()), static_cast<size_t>(mTex.height()));
+
+            // 転送できなければ、変更範囲を残して次のdraw()でやり直す（範囲が変わったときは全体をやり直す）
+            bool filled = true;
+            if (view != mSparseView) {
+                mSparse.copyTo(view, mViewImg, s3d::Point(0, 0));
+                const s3d::Rect texRect(0, 0, view.w, view.h);
+                filled = fillViewTexture(texRect);
+                mSparseView = filled ? view : s3d::Rect(0, 0, 0, 0);
+            }
+            else if (mDirtyAll) {
+                mSparse.copyTo(view, mViewImg, s3d::Point(0, 0));
+                filled = fillViewTexture(s3d::Rect(0, 0, view.w, view.h));
+            }
+            else {
+                for (const auto& rect : mDirtyRects) {
+                    const s3d::int32 left   = std::max(rect.x, view.x);
+                    const s3d::int32 top    = std::max(rect.y, view.y);
+                    const s3d::int32 right  = std::min(rect.x + rect.w, view.x + view.w);
+                    const s3d::int32 bottom = std::min(rect.y + rect.h, view.y + view.h);
+                    if ((left >= right) || (top >= bottom)) continue;
+
+                    const s3d::Rect texRect(left - view.x, top - view.y, right - left, bottom - top);
+                    mSparse.copyTo(s3d::Rect(left, top, texRect.w, texRect.h), mViewImg, texRect.pos);
+                    filled = fillViewTexture(texRect) && filled;
+                }
+            }
+            if (filled) clearDirty();
+        }
+
+        KOTSUBU_BOARD_STATS_SCOPE(*this, Draw);
+        mTex(0, 0, view.w, view.h).scaled(mScale).draw(mBoardPos + s3d::Vec2(view.x, view.y) * mScale, mTint);
+    }
+
+
+
+    // 【内部メソッド】疎な記憶方式で、転送元（mViewImg）の範囲をテクスチャの同じ位置へ転送する。転送できなければfalse
+    bool fillViewTexture(const s3d::Rect& texRect)
+    {
+        if (!mTex.fillRegion(mViewImg.data(), mViewImg.stride(), texRect)) return false;
+        countUpload(texRect);
+        return true;
+    }
+
+
+
+    // 【内部メソッド】画面に見えているイメージの範囲（toImagePos()の逆。見えていなければ空）
+    // カリングしないときは、イメージ全体（疎な記憶方式は、常に見えている範囲）
+    s3d::Rect visibleRect() const
+    {
+        const s3d::Rect all(0, 0, static_cast<s3d::int32>(mWidth), static_cast<s3d::int32>(mHeight));
+        if (!mCulling && !isSparse()) return all;
+        if (mScale <= 0.0) return s3d::Rect(0, 0, 0, 0);
+
+        // 画面の端をイメージ座標にして、イメージの少し外までに収めてから整数にする（はみ出した点も含める）
+        auto toImage = [this](double client, double boardPos, s3d::int32 size) {
+            return std::clamp((client - boardPos) / mScale, -1.0, size + 1.0);
+        };
+        const s3d::int32 left   = static_cast<s3d::int32>(std::floor(toImage(0.0, mBoardPos.x, all.w)));
+        const s3d::int32 top    = static_cast<s3d::int32>(std::floor(toImage(0.0, mBoardPos.y, all.h)));
+        const s3d::int32 right  = static_cast<s3d::int32>(std::ceil(toImage(s3d::Window::Width(),  mBoardPos.x, all.w)));
+        const s3d::int32 bottom = static_cast<s3d::int32>(std::ceil(toImage(s3d::Window::Height(), mBoardPos.y, all.h)));
+        const s3d::Rect view = clipToImage(s3d::Rect(left, top, right - left, bottom - top));
+        return ((view.w > 0) && (view.h > 0)) ? view : s3d::Rect(0, 0, 0, 0);
+    }
+
+
+
+    // 【内部メソッド】変更範囲のうち、見えている部分だけを転送する（UploadMode::Direct）
+    void uploadVisible(const s3d::Rect& view)
+    {
+        takeVisible(view, [this](const s3d::Rect& texRect) {
+            if (!fillTexture(texRect)) return false;
+            countUpload(texRect);
+            return true;
+        });
+    }
+
+
+
+    // 【内部メソッド】変更範囲のうち見えている部分を、テクセル単位の矩形ごとにupload(texRect)へ渡す
+    // 見えていない部分は（最大4つの矩形に分けて）変更範囲に残し、見えたときに渡す。uploadがfalseなら矩形ごと残す
+    template <class Upload>
+    void takeVisible(const s3d::Rect& view, Upload&& upload)
+    {
+        if (mDirtyAll) {
+            mDirtyRects.assign(1, s3d::Rect(0, 0, static_cast<s3d::int32>(mWidth), static_cast<s3d::int32>(mHeight)));
+            mDirtyAll = false;
+        }
+
+        mOffscreenRects.clear();
+        for (const auto& rect : mDirtyRects) {
+            const s3d::int32 left   = std::max(rect.x, view.x);
+            const s3d::int32 top    = std::max(rect.y, view.y);
+            const s3d::int32 right  = std::min(rect.x + rect.w, view.x + view.w);
+            const s3d::int32 bottom = std::min(rect.y + rect.h, view.y + view.h);
+            if ((left >= right) || (top >= bottom)) {
+                addRect(mOffscreenRects, rect);
+                continue;
+            }
+
+            if (!upload(toTexelRect(s3d::Rect(left, top, right - left, bottom - top)))) {
+                addRect(mOffscreenRects, rect);  // 転送できなければ、次のdraw()でやり直す
+                continue;
+            }
+
+            // 見えている部分を除いた残り（上下の帯と、左右の帯）
+            const s3d::int32 rectRight = rect.x + rect.w, rectBottom = rect.y + rect.h;
+            if (rect.y < top)        addRect(mOffscreenRects, s3d::Rect(rect.x, rect.y, rect.w, top - rect.y));
+            if (bottom < rectBottom) addRect(mOffscreenRects, s3d::Rect(rect.x, bottom, rect.w, rectBottom - bottom));
+            if (rect.x < left)       addRect(mOffscreenRects, s3d::Rect(rect.x, top, left - rect.x, bottom - top));
+            if (right < rectRight)   addRect(mOffscreenRects, s3d::Rect(right, top, rectRight - right, bottom - top));
+        }
+
+        mDirtyRects.swap(mOffscreenRects);
+        mDirtyArea = 0;
+        for (const auto& r : mDirtyRects)
+            mDirtyArea += static_cast<s3d::int64>(r.w) * r.h;
+    }
+
+
+
+    // 【内部メソッド】全体を転送対象にする
+    // 転送だけの話で、差分クリアの記録はそのまま使う（内容が分からなくなったときはmarkDirtyAll()）
+    void markUploadAll()
+    {
+        mDirtyAll = true;
+        mDirtyRects.clear();
+        mDirtyArea = 0;
+    }
+
+
+
+    // 【内部メソッド】転送範囲を空にする（すべて転送した）
+    void clearDirty()
+    {
+        mDirtyRects.clear();
+        mDirtyArea = 0;
+        mDirtyAll  = false;
+    }
+
+
+
+    // 【内部メソッド】差分クリア用の記録を、書き込みの無い状態にする（heightは行の数）
+    void resetSpans(size_t height)
+    {
+        mSpanMinX.assign(height, std::numeric_limits<s3d::int32>::max());
+        mSpanMaxX.assign(height, -1);
+        mSpanRows.clear();
+        mSpanArea = 0;
+    }
+
+
+
+    // 【内部メソッド】描画用イメージ（RGBA8）をプールに返して、空にする
+    void releaseImage()
+    {
+        KotsubuBoardPool::shared().releaseImage(mImg, mImgCapacity);
+        mImgCapacity = 0;
+    }
+
+
+
+    // 【内部メソッド】動的テクスチャをプールに返して、空にする（次のdraw()でプールから取り出す）
+    void releaseTexture()
+    {
+        KotsubuBoardPool::shared().releaseTexture(mTex);
+    }
+
+
+
+    // 【内部メソッド】テクスチャへ転送するイメージ（8bitの形式は4ドットずつ詰めたイメージ）
+    const s3d::Image& uploadImage() const
+    {
+        return is8bit() ? mImg8.packed() : mImg;
+    }
+
+
+
+    // 【内部メソッド】転送するイメージのサイズ（テクセル単位）
+    s3d::Size uploadSize() const
+    {
+        if (isExternal()) return s3d::Size(mExternal.width(), mExternal.height());
+        return uploadImage().size();
+    }
+
+
+
+    // 【内部メソッド】転送するイメージのy行目の先頭（外部バッファは行の間隔があるので、行ごとに引く）
+    const s3d::Color* uploadRow(s3d::int32 y) const
+    {
+        return isExternal() ? mExternal[y] : uploadImage()[y];
+    }
+
+
+
+    // 【内部メソッド】転送するイメージの範囲（テクセル単位）を、テクスチャの同じ位置へ転送する。転送できなければfalse
+    // 先頭と行の間隔を渡して転送する（イメージ版のfillRegion()は、イメージとテクスチャが同じ大きさでないと転送しない。
+    // テクスチャは容量内で縮小したときやサイズクラスに切り上げたときに大きい）。外部バッファも途中のイメージへコピーしない
+    bool fillTexture(const s3d::Rect& texRect)
+    {
+        if (isExternal()) return mTex.fillRegion(mExternal.data(), static_cast<s3d::uint32>(mExternal.strideBytes()), texRect);
+        const s3d::Image& img = uploadImage();
+        return mTex.fillRegion(img.data(), img.stride(), texRect);
+    }
+
+
+
+    // 【内部メソッド】イメージ座標の矩形を、転送するイメージの範囲に直す（8bitの形式は4ドットで1テクセル）
+    s3d::Rect toTexelRect(const s3d::Rect& rect) const
+    {
+        if (!is8bit()) return rect;
+        const s3d::int32 left  = rect.x / 4;
+        const s3d::int32 right = (rect.x + rect.w + 3) / 4;
+        return s3d::Rect(left, rect.y, right - left, rect.h);
+    }
+
+
+
+    // 【内部メソッド】1ドットのバイト数
+    s3d::int64 bytesPerDot() const
+    {
+        return is8bit() ? 1 : static_cast<s3d::int64>(sizeof(s3d::Color));
+    }
+
+
+
+    // 【内部メソッド】UploadMode::Asyncの転送
+    // 変更範囲のうち見えている部分を前面バッファに写し（メモリのコピーだけ）、写した範囲をまとめた矩形を覚えておく。
+    // GPUが空いていればその矩形だけを転送し、使用中なら待たずに次のdraw()へ持ち越す（写した内容は前面バッファに残る）。
+    // 前面バッファはテクスチャと同じサイズにする（イメージ版のfillRegionIfNotBusy()は同じサイズでないと転送しない）
+    void uploadAsync(const s3d::Rect& view)
+    {
+        if (mFrontImg.size() != mTex.size()) {
+            mFrontImg = s3d::Image(static_cast<size_t>(mTex.width()), static_cast<size_t>(mTex.height()));
+            mPendingRect = s3d::Rect(0, 0, 0, 0);
+            mDirtyAll = true;
+        }
+
+        takeVisible(view, [this](const s3d::Rect& texRect) {
+            for (s3d::int32 y = texRect.y; y < texRect.y + texRect.h; ++y)
+                std::copy_n(uploadRow(y) + texRect.x, texRect.w, mFrontImg[y] + texRect.x);
+            mPendingRect = unionRect(mPendingRect, texRect);
+            return true;
+        });
+
+        if ((mPendingRect.w > 0) && mTex.fillRegionIfNotBusy(mFrontImg, mPendingRect)) {
+            countUpload(mPendingRect);
+            mPendingRect = s3d::Rect(0, 0, 0, 0);
+        }
+    }
+
+
+
+    // 【内部メソッド】2つの矩形を含む矩形（空の矩形は無視する）
+    static s3d::Rect unionRect(const s3d::Rect& a, const s3d::Rect& b)
+    {
+        if ((a.w <= 0) || (a.h <= 0)) return b;
+        if ((b.w <= 0) || (b.h <= 0)) return a;
+        const s3d::int32 left   = std::min(a.x, b.x);
+        const s3d::int32 top    = std::min(a.y, b.y);
+        const s3d::int32 right  = std::max(a.x + a.w, b.x + b.w);
+        const s3d::int32 bottom = std::max(a.y + a.h, b.y + b.h);
+        return s3d::Rect(left, top, right - left, bottom - top);
+    }
+
+
+
+    // 【内部メソッド】テクスチャへ転送したバイト数を数える（計測が無効なら何もしない）
+    void countUpload([[maybe_unused]] const s3d::Rect& rect)
+    {
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+        mStats.current.uploadedBytes += static_cast<s3d::int64>(rect.w) * rect.h * sizeof(s3d::Color);
+#endif
+    }
+
+
+
+    // 【内部メソッド】矩形をイメージの範囲にクリップ
+    s3d::Rect clipToImage(const s3d::Rect& rect) const
+    {
+        const s3d::int32 left   = std::max(rect.x, 0);
+        const s3d::int32 top    = std::max(rect.y, 0);
+        const s3d::int32 right  = std::min(rect.x + rect.w, static_cast<s3d::int32>(mWidth));
+        const s3d::int32 bottom = std::min(rect.y + rect.h, static_cast<s3d::int32>(mHeight));
+        return s3d::Rect(left, top, right - left, bottom - top);
+    }
+
+
+
+    // 【内部メソッド】矩形リストに追加。上限を超えたら外接矩形1つにまとめる
+    static void addRect(s3d::Array<s3d::Rect>& rects, const s3d::Rect& rect)
+    {
+        rects.push_back(rect);
+        if (rects.size() <= MaxDirtyRects) return;
+
+        s3d::int32 left = rect.x, top = rect.y, right = rect.x + rect.w, bottom = rect.y + rect.h;
+        for (const auto& r : rects) {
+            left   = std::min(left,   r.x);
+            top    = std::min(top,    r.y);
+            right  = std::max(right,  r.x + r.w);
+            bottom = std::max(bottom, r.y + r.h);
+        }
+        rects.clear();
+        rects.push_back(s3d::Rect(left, top, right - left, bottom - top));
+    }
+
+
+
+    // 【内部メソッド】差分クリアの記録に、行yのx範囲を追加（呼び出し側でクリップ済みであること）
+    void addSpan(s3d::int32 y, s3d::int32 minX, s3d::int32 maxX)
+    {
+        if (minX > maxX) return;
+
+        s3d::int32& spanMin = mSpanMinX[y];
+        s3d::int32& spanMax = mSpanMaxX[y];
+        if (spanMin > spanMax) mSpanRows.push_back(y);
+        else                   mSpanArea -= spanMax - spanMin + 1;
+
+        spanMin = std::min(spanMin, minX);
+        spanMax = std::max(spanMax, maxX);
+        mSpanArea += spanMax - spanMin + 1;
+    }
+
+
+
+    // 【内部メソッド】負の数でも切り捨てる整数除算（den > 0）
+    static s3d::int64 floorDiv(s3d::int64 num, s3d::int64 den)
+    {
+        return (num >= 0) ? (num / den) : -((-num + den - 1) / den);
+    }
+
+
+
+    // 【内部メソッド】転送範囲に追加。面積が閾値を超えたら全体転送に切り替える
+    void addDirtyRect(const s3d::Rect& rect)
+    {
+        if (mDirtyAll) return;
+
+        addRect(mDirtyRects, rect);
+        mDirtyArea = 0;
+        for (const auto& r : mDirtyRects)
+            mDirtyArea += static_cast<s3d::int64>(r.w) * r.h;
+
+        const double boardArea = static_cast<double>(mWidth) * mHeight;
+        if (mDirtyArea > boardArea * mFullUploadRate)
+            markUploadAll();
+    }
 };
@@ -0,0 +1,589 @@
+/**************************************************************************************************
+【ヘッダオンリー】kotsubu_polyline_renderer v1.0
+
+・概要
+折れ線（点の配列）を1回でレンダリングする関数群（OpenSiv3D v0.6以降専用）
+線分ごとにrenderDecayLine()を呼ぶと、つなぎ目の点が2回書かれ、減衰も線分ごとにやり直しになる。
+ここでは折れ線全体を「行ごとの横の範囲（ピース）」に分けてから重なりを取り除くので、1つの点は1回だけ書かれる。
+ただし太さ1の上書きは、ピースにせず線分ごとに直接書く（つなぎ目の点は前の線分だけが書く。
+離れた線分どうしが交差する点は2回書かれるが、結果は1回だけ書く場合と同じ）。
+減衰は折れ線全体の長さ（始点からの道のり）で決まり、つなぎ目でも途切れない。
+太さ1はブレゼンハムの線分をつないだもの。太さ2以上は線分ごとの長方形に、つなぎ目（マイター, 丸）を足したもの。
+ボード版は、ボードの形式（8bit、疎なタイル、外部バッファ）に合わせたイメージに書く。
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_polyline_renderer.h"
+s3d::Array<s3d::Point> points = { Point(10, 10), Point(100, 40), Point(60, 120) };
+renderPolyline(board, points, Color(255));                                  // 太さ1（ブレゼンハム）
+renderPolyline(board, points, Color(255), 5, LineJoin::Round);              // 太さ5、丸いつなぎ目
+renderPolyline(board, points, Color(255), 3, LineJoin::Miter, 0.5);         // 始点側の半分（道のり）が減衰する
+renderPolyline(board.mImg, points, Color(255), 1, LineJoin::Miter, 0.0, BlendMode::Additive);  // 合成もできる
+＜注意＞ 減衰の向きはrenderDecayLine()と同じく、始点（points[0]）に向かって薄くなる
+＜注意＞ 線の両端は切りっぱなし（太さの分だけ端点を越えて伸ばさない）
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_line_renderer.h"
+
+
+
+// 【型】太い折れ線のつなぎ目
+// Miter --- 外側の辺を延ばして角にする（角が長すぎる鋭角では、角を切り落とす）
+// Round --- つなぎ目を円で埋める
+enum class LineJoin { Miter, Round };
+
+
+
+namespace kotsubu_detail
+{
+    // 【内部定数】マイターの角の長さの上限（つなぎ目の点から角までの距離 / 太さの半分）
+    constexpr double PolylineMiterLimit = 2.0;
+
+    // 【内部定数】作業領域を取っておく大きさの上限（要素数。描き終えたときに超えていれば手放す）
+    constexpr size_t PolylineKeepCapacity = 1 << 16;
+
+
+
+    // 【内部型】折れ線の1行分の横の範囲（両端を含む。折れ線の始点からの相対位置）
+    // shapeは線分iなら2 * i、線分iの手前のつなぎ目なら2 * i - 1。ピースはshapeの順に加え、後に加えたもの（終点側）を優先する
+    struct PolylinePiece
+    {
+        s3d::int32  y;
+        s3d::int32  x0;
+        s3d::int32  x1;
+        s3d::uint32 shape;
+    };
+
+
+
+    // 【内部型】折れ線の線分1本分（減衰のための道のりを求める）
+    struct PolylineSegment
+    {
+        s3d::Vec2 startPos;  // 線分の始点（点の中心が整数の座標。折れ線の始点からの相対位置）
+        s3d::Vec2 dir;       // 始点から終点への単位ベクトル
+        double    length;
+        double    arcStart;  // 折れ線の始点から、この線分の始点までの道のり
+    };
+
+
+
+    // 【内部関数】作業領域（スレッドごとに使い回す）
+    inline s3d::Array<PolylinePiece>& polylinePieces()
+    {
+        thread_local s3d::Array<PolylinePiece> pieces;
+        return pieces;
+    }
+
+    inline s3d::Array<PolylineSegment>& polylineSegments()
+    {
+        thread_local s3d::Array<PolylineSegment> segments;
+        return segments;
+    }
+
+    inline s3d::Array<PolylinePiece>& polylineRowPieces()
+    {
+        thread_local s3d::Array<PolylinePiece> rowPieces;  // 行ごとに分けたピース
+        return rowPieces;
+    }
+
+    inline s3d::Array<s3d::uint32>& polylineRowEnds()
+    {
+        thread_local s3d::Array<s3d::uint32> rowEnds;  // 行ごとのピースの終わりの位置
+        return rowEnds;
+    }
+
+    inline s3d::Array<s3d::uint64>& polylineMask()
+    {
+        thread_local s3d::Array<s3d::uint64> mask;  // 書いた点の印（1行分。1点1ビット。使い終わったら0に戻す）
+        return mask;
+    }
+
+    // 作業領域が大きすぎれば手放す（長い折れ線を1回描いただけで、メモリを持ち続けないように）
+    template <class T>
+    inline void releaseIfLarge(s3d::Array<T>& work)
+    {
+        if (work.capacity() > PolylineKeepCapacity) work = s3d::Array<T>();
+    }
+
+
+
+    // 【内部関数】ピースをクリップして加える
+    inline void addPiece(s3d::Array<PolylinePiece>& pieces, const ClipRect& clip,
+                         s3d::int32 y, s3d::int32 x0, s3d::int32 x1, s3d::uint32 shape)
+    {
+        if (y < clip.top || y > clip.bottom) return;
+        x0 = std::max(x0, clip.left);
+        x1 = std::min(x1, clip.right);
+        if (x0 <= x1) pieces.push_back(PolylinePiece{ y, x0, x1, shape });
+    }
+
+
+
+    // 【内部関数】凸多角形をピースにする（点の中心が[下限, 上限)に入る点。頂点は順に並んでいること）
+    inline void addConvexPieces(s3d::Array<PolylinePiece>& pieces, const ClipRect& clip,
+                                const s3d::Vec2* v, size_t n, s3d::uint32 shape)
+    {
+        double minY = v[0].y, maxY = v[0].y;
+        for (size_t i = 1; i < n; ++i) { minY = std::min(minY, v[i].y); maxY = std::max(maxY, v[i].y); }
+        const s3d::int32 top    = std::max(static_cast<s3d::int32>(std::ceil(minY)), clip.top);
+        const s3d::int32 bottom = std::min(static_cast<s3d::int32>(std::ceil(maxY)) - 1, clip.bottom);
+
+        for (s3d::int32 y = top; y <= bottom; ++y) {
+            // 凸多角形なので、行を横切る辺（下端を含み、上端を含まない）は2本だけ
+            double lo = 0.0, hi = -1.0;
+            bool found = false;
+            for (size_t i = 0; i < n; ++i) {
+                const s3d::Vec2& a = v[i];
+                const s3d::Vec2& b = v[(i + 1) % n];
+                if ((a.y <= y) == (b.y <= y)) continue;
+                const double x = a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+                if (!found) { lo = hi = x; found = true; }
+                else        { lo = std::min(lo, x); hi = std::max(hi, x); }
+            }
+            if (found)
+                addPiece(pieces, clip, y, static_cast<s3d::int32>(std::ceil(lo)),
+                         static_cast<s3d::int32>(std::ceil(hi)) - 1, shape);
+        }
+    }
+
+
+
+    // 【内部関数】円をピースにする
+    inline void addDiskPieces(s3d::Array<PolylinePiece>& pieces, const ClipRect& clip,
+                              const s3d::Vec2& center, double radius, s3d::uint32 shape)
+    {
+        const s3d::int32 top    = std::max(static_cast<s3d::int32>(std::ceil(center.y - radius)), clip.top);
+        const s3d::int32 bottom = std::min(static_cast<s3d::int32>(std::ceil(center.y + radius)) - 1, clip.bottom);
+        for (s3d::int32 y = top; y <= bottom; ++y) {
+            const double dy = y - center.y;
+            const double hw = std::sqrt(std::max(0.0, radius * radius - dy * dy));
+            addPiece(pieces, clip, y, static_cast<s3d::int32>(std::ceil(center.x - hw)),
+                     static_cast<s3d::int32>(std::ceil(center.x + hw)) - 1, shape);
+        }
+    }
+
+
+
+    // 【内部関数】ブレゼンハムの線分（太さ1）をピースにする。点はrenderLine()と同じ
+    // クリップ矩形に掛かるステップだけを進め、同じ行に続く点は1つのピースにまとめる
+    inline void addBresenhamPieces(s3d::Array<PolylinePiece>& pieces, const ClipRect& clip,
+                                   s3d::Point startPos, s3d::Point endPos, s3d::uint32 shape)
+    {
+        const LineSetup ls = makeLineSetup(startPos, endPos);
+        const StepRange r  = ls.xMajor ? visibleSteps<true>(ls, clip) : visibleSteps<false>(ls, clip);
+        if (r.first > r.last) return;
+
+        const s3d::int32 stepMaj = ls.xMajor ? ls.step.x : ls.step.y;
+        const s3d::int32 stepMin = ls.xMajor ? ls.step.y : ls.step.x;
+        const s3d::int64 e       = ls.e0 + r.first * ls.eInc;
+        s3d::int64       m       = (ls.eMax == 0) ? 0 : e / ls.eMax;
+        s3d::int64       err     = e - m * ls.eMax;
+        s3d::int32 majPos = static_cast<s3d::int32>((ls.xMajor ? ls.endPos.x : ls.endPos.y) + r.first * stepMaj);
+        s3d::int32 minPos = static_cast<s3d::int32>((ls.xMajor ? ls.endPos.y : ls.endPos.x) + m * stepMin);
+
+        const size_t firstPiece = pieces.size();
+        for (s3d::int64 k = r.first; k <= r.last; ++k) {
+            const s3d::int32 x = ls.xMajor ? majPos : minPos;
+            const s3d::int32 y = ls.xMajor ? minPos : majPos;
+            if (x >= clip.left && x <= clip.right && y >= clip.top && y <= clip.bottom) {
+                PolylinePiece* last = (pieces.size() > firstPiece) ? &pieces.back() : nullptr;
+                if (last && last->y == y && (x == last->x0 - 1 || x == last->x1 + 1)) {
+                    last->x0 = std::min(last->x0, x);
+                    last->x1 = std::max(last->x1, x);
+                }
+                else {
+                    pieces.push_back(PolylinePiece{ y, x, x, shape });
+                }
+            }
+
+            majPos += stepMaj;
+            err    += ls.eInc;
+            if (err >= ls.eMax && ls.eMax > 0) { err -= ls.eMax; minPos += stepMin; }
+        }
+    }
+
+
+
+    // 【内部関数】線分iの手前のつなぎ目（前の線分の終点 = 線分iの始点）をピースにする
+    inline void addJoinPieces(s3d::Array<PolylinePiece>& pieces, const ClipRect& clip,
+                              const s3d::Array<PolylineSegment>& segments, size_t i,
+                              double halfWidth, LineJoin join)
+    {
+        const s3d::uint32 shape = static_cast<s3d::uint32>(2 * i - 1);
+        const s3d::Vec2&  v     = segments[i].startPos;
+        if (join == LineJoin::Round) {
+            addDiskPieces(pieces, clip, v, halfWidth, shape);
+            return;
+        }
+
+        // 外側（曲がる向きの反対側）の辺の端どうしを、角の点でつなぐ。まっすぐなら要らない
+        const s3d::Vec2& d1    = segments[i - 1].dir;
+        const s3d::Vec2& d2    = segments[i].dir;
+        const double     cross = d1.x * d2.y - d1.y * d2.x;
+        if (cross == 0.0 && d1.x * d2.x + d1.y * d2.y > 0.0) return;
+        const double    side = (cross > 0.0) ? -1.0 : 1.0;
+        const s3d::Vec2 n1(-d1.y, d1.x), n2(-d2.y, d2.x);
+        const s3d::Vec2 a = v + n1 * (side * halfWidth);
+        const s3d::Vec2 b = v + n2 * (side * halfWidth);
+        const double    c = 1.0 + n1.x * n2.x + n1.y * n2.y;  // 2 * cos^2(曲がる角度 / 2)
+        if (c >= 2.0 / (PolylineMiterLimit * PolylineMiterLimit)) {
+            const s3d::Vec2 corner = v + (n1 + n2) * (side * halfWidth / c);
+            const s3d::Vec2 wedge[4] = { v, a, corner, b };
+            addConvexPieces(pieces, clip, wedge, 4, shape);
+        }
+        else {
+            const s3d::Vec2 bevel[3] = { v, a, b };
+            addConvexPieces(pieces, clip, bevel, 3, shape);
+        }
+    }
+
+
+
+    // 【内部関数】太い線分の長方形をピースにする
+    inline void addThickSegmentPieces(s3d::Array<PolylinePiece>& pieces, const ClipRect& clip,
+                                      const PolylineSegment& seg, s3d::uint32 shape, double halfWidth)
+    {
+        const s3d::Vec2 n(-seg.dir.y * halfWidth, seg.dir.x * halfWidth);
+        const s3d::Vec2 endPos = seg.startPos + seg.dir * seg.length;
+        const s3d::Vec2 body[4] = { seg.startPos + n, endPos + n, endPos - n, seg.startPos - n };
+        addConvexPieces(pieces, clip, body, 4, shape);
+    }
+
+
+
+    // 【内部関数】ピースを優先順位の高い順に書き、すでに書いた点は飛ばす（1つの点は1回だけ書く）
+    // ピースを行ごとに分け（数え上げてから置く。行の中は加えた順のまま）、1行ずつ、加えた順の逆に書く。
+    // 書いた点の印はその行のピースの範囲の分だけのビットの表に付け、行を書き終えたら消す
+    // （表の大きさは折れ線の長さや外接矩形によらず、1行の幅まで）。ピースが1つだけの行は印を使わずにそのまま書く。
+    // 減衰する点は、ピースの形の道のりからアルファを決める（線分なら点の中心を線分に下ろした位置）。
+    // originは相対位置の基準（折れ線の始点）。書き込み先はs3d::Image、KotsubuImage8、KotsubuImageView、
+    // KotsubuSparseImage（疎なイメージは、ピースをタイルの境目で分けて書く）
+    template <BlendMode Blend, class Surface>
+    inline void writePolylinePieces(Surface& img, s3d::Point origin, const s3d::Array<PolylinePiece>& pieces,
+                                    const s3d::Array<PolylineSegment>& segments,
+                                    const s3d::Color& col, double decayLen)
+    {
+        constexpr bool Sparse = std::is_same_v<Surface, KotsubuSparseImage>;
+        using Pixel = PixelOf<std::conditional_t<Sparse, SparseTile, Surface>>;
+        if (pieces.empty()) return;
+
+        s3d::int32 top = pieces[0].y, bottom = pieces[0].y;
+        for (const PolylinePiece& p : pieces) {
+            top    = std::min(top, p.y);
+            bottom = std::max(bottom, p.y);
+        }
+        s3d::Array<s3d::uint32>& rowEnds = polylineRowEnds();
+        rowEnds.assign(static_cast<size_t>(bottom - top) + 2, 0);
+        for (const PolylinePiece& p : pieces)
+            ++rowEnds[p.y - top + 1];
+        for (size_t r = 1; r < rowEnds.size(); ++r)
+            rowEnds[r] += rowEnds[r - 1];
+        s3d::Array<PolylinePiece>& rows = polylineRowPieces();
+        rows.resize(pieces.size());
+        for (const PolylinePiece& p : pieces)
+            rows[rowEnds[p.y - top]++] = p;  // 置き終えると、rowEnds[r]は行top + rの終わり（次の行の始まり）になる
+
+        SolidRunWriter<Blend, Pixel> solid{ col, col };
+        const double invDecay = 1.0 / (1.0 + decayLen);
+        auto writeChunk = [&](Pixel* p, s3d::int32 y, s3d::int32 x0, s3d::int32 x1, s3d::uint32 shape) {
+            const PolylineSegment& seg = segments[(shape + 1) / 2];
+            if (decayLen <= 0.0 || seg.arcStart >= decayLen) {  // 減衰区間に掛からない
+                solid.run(p, 1, x1 - x0 + 1);
+                return;
+            }
+            // 道のりはxについて1次式（線分の範囲でクランプする）。つなぎ目は一定
+            const bool   onSegment = (shape % 2 == 0);
+            const double tRow      = (y - seg.startPos.y) * seg.dir.y - seg.startPos.x * seg.dir.x;
+            KOTSUBU_BOARD_STATS_WRITTEN(x1 - x0 + 1);
+            for (s3d::int32 x = x0; x <= x1; ++x, ++p) {
+                const double arc  = seg.arcStart + (onSegment ? std::clamp(tRow + x * seg.dir.x, 0.0, seg.length) : 0.0);
+                const double rate = (arc >= decayLen) ? 1.0 : (1.0 + arc) * invDecay;
+                blendPixel<Blend>(*p, s3d::Color(col, static_cast<s3d::uint8>(col.a * rate + 0.5)));
+            }
+        };
+        auto writeSpan = [&](s3d::int32 y, s3d::int32 x0, s3d::int32 x1, s3d::uint32 shape) {
+            if constexpr (Sparse) {
+                // タイルの中では1行の点が並んでいるので、タイルの境目までをまとめて書く
+                constexpr s3d::int32 TileMask = KotsubuSparseImage::TileSize - 1;
+                for (s3d::int32 x = x0; x <= x1; ) {
+                    const s3d::int32 end = std::min(x1, ((x + origin.x) | TileMask) - origin.x);
+                    writeChunk(&img.at(x + origin.x, y + origin.y), y, x, end, shape);
+                    x = end + 1;
+                }
+            }
+            else {
+                writeChunk(&img[y + origin.y][x0 + origin.x], y, x0, x1, shape);
+            }
+        };
+
+        // 印は64点（1語）ずつ調べる。語の中の範囲がすべて空き、またはすべて書いた点なら1回で済ませ、混ざるときだけ1点ずつ見る
+        s3d::Array<s3d::uint64>& written = polylineMask();
+        for (s3d::int32 y = top; y <= bottom; ++y) {
+            const size_t rowBegin = (y == top) ? 0 : rowEnds[y - top - 1];
+            const size_t rowEnd   = rowEnds[y - top];
+            if (rowBegin == rowEnd) continue;
+            if (rowEnd == rowBegin + 1) {
+                const PolylinePiece& p = rows[rowBegin];
+                writeSpan(y, p.x0, p.x1, p.shape);
+                continue;
+            }
+
+            s3d::int32 left = rows[rowBegin].x0, right = rows[rowBegin].x1;
+            for (size_t i = rowBegin + 1; i < rowEnd; ++i) {
+                left  = std::min(left, rows[i].x0);
+                right = std::max(right, rows[i].x1);
+            }
+            const size_t words = (static_cast<size_t>(right - left) + 64) / 64;
+            if (written.size() < words) written.resize(words, 0);
+            for (size_t i = rowEnd; i-- > rowBegin; ) {
+                const PolylinePiece& p = rows[i];
+                bool       inRun    = false;  // まだ書いていない点のランの途中か
+                s3d::int32 runStart = 0;
+                for (s3d::int32 x = p.x0; x <= p.x1; ) {
+                    const size_t      bit   = static_cast<size_t>(x - left);
+                    const size_t      lo    = bit % 64;
+                    const size_t      count = std::min<size_t>(64 - lo, static_cast<size_t>(p.x1 - x) + 1);
+                    const s3d::uint64 range = ((count == 64) ? ~0ull : ((1ull << count) - 1)) << lo;
+                    s3d::uint64&      word  = written[bit / 64];
+                    const s3d::uint64 done  = word & range;
+                    word |= range;
+                    if (done == 0) {
+                        if (!inRun) { runStart = x; inRun = true; }
+                    }
+                    else if (done == range) {
+                        if (inRun) { writeSpan(y, runStart, x - 1, p.shape); inRun = false; }
+                    }
+                    else {
+                        for (size_t b = 0; b < count; ++b) {
+                            const s3d::int32 px = x + static_cast<s3d::int32>(b);
+                            if (done & (1ull << (lo + b))) {
+                                if (inRun) { writeSpan(y, runStart, px - 1, p.shape); inRun = false; }
+                            }
+                            else if (!inRun) { runStart = px; inRun = true; }
+                        }
+                    }
+                    x += static_cast<s3d::int32>(count);
+                }
+                if (inRun) writeSpan(y, runStart, p.x1, p.shape);
+            }
+            std::fill_n(written.begin(), words, 0);
+        }
+    }
+
+
+
+    // 【内部関数】線分の終点（点の中心。折れ線の始点からの相対位置）
+    inline s3d::Point polylineSegmentEnd(const PolylineSegment& seg)
+    {
+        const s3d::Vec2 endPos = seg.startPos + seg.dir * seg.length;
+        return s3d::Point(static_cast<s3d::int32>(std::lround(endPos.x)), static_cast<s3d::int32>(std::lround(endPos.y)));
+    }
+
+
+
+    // 【内部関数】上書きの単色で、線分のステップlastまで（クリップ矩形の中だけ）をラン単位で書く
+    template <Octant O, class Surface>
+    inline void walkPolylineSegment(Surface& img, const LineSetup& ls, const ClipRect& clip,
+                                    const s3d::Color& col, s3d::int64 last)
+    {
+        constexpr bool XMajor = octantXMajor(O);
+        bool clipped;
+        const StepRange r = lineSteps<XMajor>(ls, clip, clipped);
+        SolidRunWriter<BlendMode::Overwrite, PixelOf<Surface>> solid{ col, col };
+        walkSteps<O, false>(img, ls, clip, clipped, r.first, std::min(r.last, last), solid);
+    }
+
+    // 【内部型】八分円ごとのwalkPolylineSegment()の関数表（八分円の番号順。書き込み先の型ごと）
+    template <class Surface>
+    using PolylineWalkFunc = void (*)(Surface&, const LineSetup&, const ClipRect&, const s3d::Color&, s3d::int64);
+
+    template <class Surface, size_t... I>
+    constexpr std::array<PolylineWalkFunc<Surface>, 8> makePolylineWalkTable(std::index_sequence<I...>)
+    {
+        return {{ walkPolylineSegment<static_cast<Octant>(I), Surface>... }};
+    }
+
+    template <class Surface>
+    inline constexpr auto polylineWalkTable = makePolylineWalkTable<Surface>(std::make_index_sequence<8>());
+
+
+
+    // 【内部関数】太さ1の折れ線を、上書きで線分ごとに直接書く（ピースと書いた点の印を使わない）
+    // 隣り合う線分が重なるのはつなぎ目の点だけなので、2本目からは線分の始点のステップ（つなぎ目）を書かずに
+    // 1ステップ手前で止める（つなぎ目は前の線分の終点として書く）。これで1つの点は1回だけ書かれる。
+    // 離れた線分どうしが交差する点は、始点側の線分から順に書くので終点側の線分の色になり、ピースで書く場合と同じになる
+    // （合成するときは2回書くと結果が変わるので、ピースで書く）。
+    // 減衰区間に掛からない線分はラン単位で、掛かる線分は見えているステップを1点ずつ、道のりからアルファを決めて書く。
+    // 書き込み先はs3d::Image、KotsubuImage8、KotsubuImageView（疎なイメージはピースで書く）
+    template <class Surface>
+    inline void writePolylineDirect(Surface& img, s3d::Point origin, const s3d::Array<PolylineSegment>& segments,
+                                    const s3d::Color& col, double decayLen)
+    {
+        const ClipRect clip  = imageClip(img);
+        const ClipRect inner{ clip.left + 1, clip.top + 1, clip.right - 1, clip.bottom - 1 };  // visibleSteps()は1ドット広げる
+        const double   invDecay = 1.0 / (1.0 + decayLen);
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const PolylineSegment& seg  = segments[i];
+            const LineSetup        ls   = makeLineSetup(seg.startPos.asPoint() + origin, polylineSegmentEnd(seg) + origin);
+            const s3d::int64       last = (ls.xMajor ? ls.dist.x : ls.dist.y) - ((i > 0) ? 1 : 0);  // 書く最後のステップ
+            if (decayLen <= 0.0 || seg.arcStart >= decayLen) {  // 減衰区間に掛からない
+                polylineWalkTable<Surface>[static_cast<size_t>(octantOf(ls))](img, ls, clip, col, last);
+                continue;
+            }
+
+            // 見えているステップの始まりから1点ずつ進める。道のりはwritePolylinePieces()と同じ式で求める（同じ丸めにする）
+            StepRange r = ls.xMajor ? visibleSteps<true>(ls, inner) : visibleSteps<false>(ls, inner);
+            r.last = std::min(r.last, last);
+            if (r.first > r.last) continue;
+            const s3d::int32 stepMaj = ls.xMajor ? ls.step.x : ls.step.y;
+            const s3d::int32 stepMin = ls.xMajor ? ls.step.y : ls.step.x;
+            const s3d::Point now     = ls.xMajor ? stepPos<true>(ls, r.first) : stepPos<false>(ls, r.first);
+            s3d::int32 majPos = ls.xMajor ? now.x : now.y;
+            s3d::int32 minPos = ls.xMajor ? now.y : now.x;
+            s3d::int64 e      = (ls.e0 + r.first * ls.eInc) % ls.eMax;  // 長さ0の線分は無いので、eMaxは正
+            for (s3d::int64 k = r.first; ; ) {
+                const s3d::int32 px   = ls.xMajor ? majPos : minPos;
+                const s3d::int32 py   = ls.xMajor ? minPos : majPos;
+                const s3d::int32 x    = px - origin.x;
+                const s3d::int32 y    = py - origin.y;
+                const double     tRow = (y - seg.startPos.y) * seg.dir.y - seg.startPos.x * seg.dir.x;
+                const double     arc  = seg.arcStart + std::clamp(tRow + x * seg.dir.x, 0.0, seg.length);
+                const double     rate = (arc >= decayLen) ? 1.0 : (1.0 + arc) * invDecay;
+                blendPixel<BlendMode::Overwrite>(img[py][px], s3d::Color(col, static_cast<s3d::uint8>(col.a * rate + 0.5)));
+                KOTSUBU_BOARD_STATS_WRITTEN(1);
+
+                if (k++ == r.last) break;
+                majPos += stepMaj;
+                e      += ls.eInc;
+                if (e >= ls.eMax) { e -= ls.eMax; minPos += stepMin; }
+            }
+        }
+    }
+
+
+
+    // 【内部関数】つなぎ目の外側が、線分からはみ出す最大の距離（ボードへの通知用。ドット）
+    inline s3d::int32 polylineMargin(s3d::int32 thickness, LineJoin join)
+    {
+        if (thickness <= 1) return 0;
+        const double halfWidth = thickness * 0.5;
+        return static_cast<s3d::int32>(std::ceil(halfWidth * ((join == LineJoin::Miter) ? PolylineMiterLimit : 1.0))) + 1;
+    }
+
+
+
+    // 【内部関数】折れ線をレンダリング（renderPolyline()の本体）
+    // 書き込み先はs3d::Image、KotsubuImage8、KotsubuImageView、KotsubuSparseImage
+    template <class Surface>
+    inline void drawPolyline(Surface& img, const s3d::Point* points, size_t count, s3d::Color col,
+                             s3d::int32 thickness, LineJoin join, double decaySectionRate, BlendMode blend)
+    {
+        if (count == 0 || img.width() <= 0 || img.height() <= 0) return;
+
+        // 形は折れ線の始点からの相対位置で求める（平行移動しても、点の並びがまったく同じになる）
+        const s3d::Point origin = points[0];
+        const ClipRect   clip{ -origin.x, -origin.y, img.width() - 1 - origin.x, img.height() - 1 - origin.y };
+
+        // 線分の一覧（同じ点が続く分は詰める）と道のり
+        s3d::Array<PolylineSegment>& segments = polylineSegments();
+        segments.clear();
+        size_t prev = 0;
+        double arc  = 0.0;
+        for (size_t i = 1; i < count; ++i) {
+            if (points[i] == points[prev]) continue;
+            const s3d::Vec2 a(points[prev] - origin), b(points[i] - origin);
+            const double    len = (b - a).length();
+            segments << PolylineSegment{ a, (b - a) / len, len, arc };
+            arc += len;
+            prev = i;
+        }
+
+        s3d::Array<PolylinePiece>& pieces = polylinePieces();
+        pieces.clear();
+        const double halfWidth = std::max(thickness, 1) * 0.5;
+        if (segments.isEmpty()) {
+            // 点が1つだけ
+            segments << PolylineSegment{ s3d::Vec2(0.0, 0.0), s3d::Vec2(1.0, 0.0), 0.0, 0.0 };
+            if (thickness <= 1) addPiece(pieces, clip, 0, 0, 0, 0);
+            else                addDiskPieces(pieces, clip, s3d::Vec2(0.0, 0.0), halfWidth, 0);
+        }
+        else if (thickness <= 1) {
+            // 上書きなら、線分ごとに直接書く（結果はピースで書く場合と同じ。疎なイメージはピースで書く）
+            if constexpr (!std::is_same_v<Surface, KotsubuSparseImage>) {
+                if (blend == BlendMode::Overwrite) {
+                    writePolylineDirect(img, origin, segments, col, arc * clampRate(decaySectionRate));
+                    releaseIfLarge(segments);
+                    return;
+                }
+            }
+            // 線分iの点はrenderLine(始点, 終点)と同じ（つなぎ目の点はどちらの線分にもあるが、終点側の線分だけが書く）
+            for (size_t i = 0; i < segments.size(); ++i)
+                addBresenhamPieces(pieces, clip, segments[i].startPos.asPoint(), polylineSegmentEnd(segments[i]),
+                                   static_cast<s3d::uint32>(2 * i));
+        }
+        else {
+            for (size_t i = 0; i < segments.size(); ++i) {
+                if (i > 0) addJoinPieces(pieces, clip, segments, i, halfWidth, join);
+                addThickSegmentPieces(pieces, clip, segments[i], static_cast<s3d::uint32>(2 * i), halfWidth);
+            }
+        }
+
+        const double decayLen = arc * clampRate(decaySectionRate);
+        withBlend(blend, [&](auto b) { writePolylinePieces<decltype(b)::value>(img, origin, pieces, segments, col, decayLen); });
+        releaseIfLarge(pieces);
+        releaseIfLarge(polylineRowPieces());
+        releaseIfLarge(polylineRowEnds());
+        releaseIfLarge(segments);
+    }
+}
+
+
+
+// 【関数】折れ線をレンダリング（整数版）
+// thicknessは太さ（ドット）。1ならブレゼンハムの線分をつないだもので、joinは使わない。
+// decaySectionRateは折れ線全体の長さに対する減衰区間の割合（0なら減衰しない。始点側が薄くなる）。
+// 続けて同じ点が並んでいてもよい。点が1つだけなら、その点（太ければ円）を描く
+inline void renderPolyline(s3d::Image& img, const s3d::Point* points, size_t count, s3d::Color col,
+                           s3d::int32 thickness = 1, LineJoin join = LineJoin::Miter,
+                           double decaySectionRate = 0.0, BlendMode blend = BlendMode::Overwrite)
+{
+    kotsubu_detail::drawPolyline(img, points, count, col, thickness, join, decaySectionRate, blend);
+}
+
+inline void renderPolyline(s3d::Image& img, const s3d::Array<s3d::Point>& points, s3d::Color col,
+                           s3d::int32 thickness = 1, LineJoin join = LineJoin::Miter,
+                           double decaySectionRate = 0.0, BlendMode blend = BlendMode::Overwrite)
+{
+    renderPolyline(img, points.data(), points.size(), col, thickness, join, decaySectionRate, blend);
+}
+
+
+
+// 【関数】ボード版。ボードの形式に合わせたイメージに書き、線分ごとに、太さとつなぎ目の分だけ広げてボードに通知する
+inline void renderPolyline(KotsubuPixelBoard& board, const s3d::Point* points, size_t count, s3d::Color col,
+                           s3d::int32 thickness = 1, LineJoin join = LineJoin::Miter,
+                           double decaySectionRate = 0.0, BlendMode blend = BlendMode::Overwrite)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawPolyline(img, points, count, col, thickness, join, decaySectionRate, blend);
+    });
+    const s3d::int32 margin = kotsubu_detail::polylineMargin(thickness, join);
+    if (count == 1) board.markDirtyLine(points[0], points[0], std::max(margin, thickness / 2 + 1));
+    for (size_t i = 1; i < count; ++i)
+        board.markDirtyLine(points[i - 1], points[i], margin);
+}
+
+inline void renderPolyline(KotsubuPixelBoard& board, const s3d::Array<s3d::Point>& points, s3d::Color col,
+                           s3d::int32 thickness = 1, LineJoin join = LineJoin::Miter,
+                           double decaySectionRate = 0.0, BlendMode blend = BlendMode::Overwrite)
+{
+    renderPolyline(board, points.data(), points.size(), col, thickness, join, decaySectionRate, blend);
+}
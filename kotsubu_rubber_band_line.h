@@ -0,0 +1,273 @@
+/**************************************************************************************************
+【ヘッダオンリークラス】kotsubu_rubber_band_line v1.0
+
+・概要
+ドラッグ中の線分（ラバーバンド）を、前回との差分だけでボードに描き直すクラス（OpenSiv3D v0.6以降専用）
+前回レンダリングした点の位置と色を覚えておき、端点が動いたら新しい線分をレンダリングして比べ、
+消える点は描く前の色に戻し、色の変わる点だけを書き込む（変更範囲の通知も変わった点だけ）。
+始点が同じなら、始点付近の点は前回と同じ位置に並ぶので書き込まれない。
+アルファ減衰は線分の長さで決まるので、更新のたびに作り直してから比べる（変わらない点は書かない）。
+結果はrenderLines()で1本だけ描いた場合と同じになる。
+ボードの形式（8bit、疎なタイル、外部バッファ）に合わせたイメージに書く。作業用イメージは線分の外接矩形の大きさで足りる。
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_rubber_band_line.h"
+KotsubuRubberBandLine rubberBand;
+メインループ
+    rubberBand.update(board, LineSegment{ startPos, endPos, ColorF(1.0), LineMode::Decay, 0.5 });  // clear()は要らない
+    board.draw();
+rubberBand.erase(board);                       // 線分を消して、描く前の色に戻す
+board.clear(); rubberBand.reset();             // ボードを別にクリアしたら、記録を捨てる
+＜注意＞ 書き込む色がs3d::Color(0, 0, 0, 0)の点は、書かなかった点と同じ扱いになる
+＜注意＞ 8bitのボードでは、線分の色のアルファだけを書く（renderLines()と同じ）
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_line_renderer.h"
+
+
+
+class KotsubuRubberBandLine
+{
+private:
+    // 【内部定数】作業用イメージを線分の外接矩形から広げる幅（サブピクセルの端点とWuの点がはみ出す分）
+    static constexpr s3d::int32 ScratchMargin = 2;
+
+
+
+    // 【内部型】レンダリングした1点
+    struct Pixel
+    {
+        s3d::Point pos;    // ボードの座標
+        s3d::Color col;    // 線分の色（書き込み先と合成する前）
+        s3d::Color under;  // 描く前の書き込み先の色（消すときに戻す。8bitのボードではアルファだけ）
+    };
+
+    // 【内部フィールド】
+    s3d::Array<Pixel> mPixels;   // 前回レンダリングした点（位置の順。上の行から、行の中は左から）
+    s3d::Array<Pixel> mNext;     // 今回レンダリングした点（作業領域）
+    s3d::Image        mScratch;  // 線分を1本だけレンダリングする作業用イメージ（書いた点以外は常に透明。大きくするだけ）
+    LineSegment       mSegment;
+    bool              mHasLine;
+    s3d::int32        mWidth;    // 記録を取ったときのボードのサイズ
+    s3d::int32        mHeight;
+
+
+
+public:
+    // 【コンストラクタ】
+    KotsubuRubberBandLine()
+    {
+        mHasLine = false;
+        mWidth   = 0;
+        mHeight  = 0;
+    }
+
+
+
+    // 【メソッド】線分を更新する
+    // 前回と同じ線分なら何もしない。ボードのサイズが変わっていたら（setSize()で白紙になっているので）記録を捨てる
+    void update(KotsubuPixelBoard& board, const LineSegment& segment)
+    {
+        if (mHasLine && sameSegment(segment, mSegment)) return;
+        KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+
+        kotsubu_detail::withBoardImage(board, [&](auto& img) {
+            if (img.width() != mWidth || img.height() != mHeight) {
+                reset();
+                mWidth  = img.width();
+                mHeight = img.height();
+            }
+            renderScratch(segment);
+            kotsubu_detail::withBlend(segment.blend, [&](auto b) { merge<decltype(b)::value>(board, img); });
+        });
+        mPixels.swap(mNext);
+        mSegment = segment;
+        mHasLine = true;
+    }
+
+
+
+    // 【メソッド】線分を消して、描く前の色に戻す
+    void erase(KotsubuPixelBoard& board)
+    {
+        kotsubu_detail::withBoardImage(board, [&](auto& img) {
+            if (img.width() != mWidth || img.height() != mHeight) return;
+            mNext.clear();
+            merge<BlendMode::Overwrite>(board, img);
+        });
+        reset();
+    }
+
+
+
+    // 【メソッド】記録を捨てる（ボードを別にクリアしたときなど。ボードには何もしない）
+    void reset()
+    {
+        mPixels.clear();
+        mHasLine = false;
+    }
+
+
+
+    // 【ゲッタ】前回レンダリングした点の数
+    size_t pixelCount() const
+    {
+        return mPixels.size();
+    }
+
+
+
+private:
+    // 【内部メソッド】同じ線分かどうか
+    static bool sameSegment(const LineSegment& a, const LineSegment& b)
+    {
+        return a.startPos == b.startPos && a.endPos == b.endPos &&
+               a.col.r == b.col.r && a.col.g == b.col.g && a.col.b == b.col.b && a.col.a == b.col.a &&
+               a.mode == b.mode && a.decaySectionRate == b.decaySectionRate &&
+               a.aaColorRate == b.aaColorRate && a.blend == b.blend;
+    }
+
+
+
+    // 【内部メソッド】作業用イメージに線分を上書きでレンダリングし、書いた点をmNextに集める
+    // 作業用イメージの左上を、線分の外接矩形（点がはみ出す分を広げ、ボードの範囲に収めたもの）の左上に合わせる。
+    // 整数の平行移動なので、点の並びも色もボードに直接描く場合と同じになる。
+    // 各行で線分が通るxの範囲だけを調べ、調べた点は透明に戻す（O(線分の長さ)）
+    void renderScratch(const LineSegment& segment)
+    {
+        using namespace kotsubu_detail;
+        mNext.clear();
+        const s3d::Point a = segment.startPos.asPoint(), b = segment.endPos.asPoint();
+        const s3d::int32 left   = std::max(std::min(a.x, b.x) - ScratchMargin, 0);
+        const s3d::int32 top    = std::max(std::min(a.y, b.y) - ScratchMargin, 0);
+        const s3d::int32 right  = std::min(std::max(a.x, b.x) + ScratchMargin, mWidth - 1);
+        const s3d::int32 bottom = std::min(std::max(a.y, b.y) + ScratchMargin, mHeight - 1);
+        if (left > right || top > bottom) return;
+        if (mScratch.width() <= right - left || mScratch.height() <= bottom - top) {
+            mScratch = s3d::Image(static_cast<size_t>(std::max(mScratch.width(), right - left + 1)),
+                                  static_cast<size_t>(std::max(mScratch.height(), bottom - top + 1)), s3d::Color(0, 0, 0, 0));
+        }
+
+        LineSegment local = segment;
+        local.startPos = FixedPoint(segment.startPos.x - left * 256, segment.startPos.y - top * 256);
+        local.endPos   = FixedPoint(segment.endPos.x - left * 256, segment.endPos.y - top * 256);
+        local.blend    = BlendMode::Overwrite;
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+        const s3d::int64 written = writtenPixels();  // 作業用イメージに書いた点は、ボードに書いた点として数えない
+#endif
+        renderLines(mScratch, &local, 1);
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+        writtenPixels() = written;
+#endif
+
+        // 作業用イメージはボードの範囲より大きいことがあるので、ボードの外の点は集めずに透明に戻すだけ
+        const s3d::int32 width  = mScratch.width();
+        const s3d::int32 height = mScratch.height();
+        const LineSetup  ls     = makeLineSetup(local.startPos, local.endPos);
+        const bool       wu     = isWuMode(segment.mode);
+        const s3d::int32 margin = wu ? 1 : 0;  // Wuの点は縦にも1ドットはみ出すことがある
+        const s3d::int32 rowTop    = std::max(std::min(ls.startPos.y, ls.endPos.y) - margin, 0);
+        const s3d::int32 rowBottom = std::min(std::max(ls.startPos.y, ls.endPos.y) + margin, height - 1);
+        for (s3d::int32 y = rowTop; y <= rowBottom; ++y) {
+            // 1行だけのクリップ矩形で、線分が通るxの範囲を求める
+            s3d::int32 lo, hi;
+            if (!clipXRange(ls, ClipRect{ 0, y, width - 1, y }, lo, hi, wu)) continue;
+            s3d::Color* row = mScratch[y];
+            for (s3d::int32 x = lo; x <= hi; ++x) {
+                if (toBits(row[x]) == 0) continue;
+                if (x + left <= right && y + top <= bottom)
+                    mNext.push_back(Pixel{ s3d::Point(x + left, y + top), row[x], row[x] });
+                row[x] = s3d::Color(0, 0, 0, 0);
+            }
+        }
+    }
+
+
+
+    // 【内部メソッド】前回の点（mPixels）と今回の点（mNext）を位置の順に突き合わせて、ボードに書き込む
+    // 前回だけの点は描く前の色に戻し、今回の点は描く前の色と合成する。色が変わった点だけを書き、
+    // 書いた点は横に続く分をまとめてボードに通知する。mNextのunderは、ここで描く前の色に置き換わる。
+    // imgはボードの形式に合わせた描画用イメージ（s3d::Image、KotsubuImage8、KotsubuImageView、KotsubuSparseImage）
+    template <BlendMode Blend, class Surface>
+    void merge(KotsubuPixelBoard& board, Surface& img)
+    {
+        s3d::Point runStart(-1, -1);  // 通知待ちの横のラン（両端を含む）
+        s3d::int32 runEnd = -1;
+        auto write = [&](s3d::Point pos, const s3d::Color& col) {
+            if (kotsubu_detail::toBits(readPixel(img, pos)) == kotsubu_detail::toBits(col)) return;
+            writePixel(img, pos, col);
+            KOTSUBU_BOARD_STATS_WRITTEN(1);
+            if (pos.y == runStart.y && pos.x == runEnd + 1) { runEnd = pos.x; return; }
+            flushRun(board, runStart, runEnd);
+            runStart = pos;
+            runEnd   = pos.x;
+        };
+
+        size_t i = 0, j = 0;
+        while (i < mPixels.size() || j < mNext.size()) {
+            if (j == mNext.size() || (i < mPixels.size() && before(mPixels[i].pos, mNext[j].pos))) {
+                write(mPixels[i].pos, mPixels[i].under);
+                ++i;
+                continue;
+            }
+            Pixel& p = mNext[j];
+            if (i < mPixels.size() && mPixels[i].pos == p.pos) p.under = mPixels[i++].under;
+            else                                               p.under = readPixel(img, p.pos);
+            write(p.pos, compose<Blend, Surface>(p.under, p.col));
+            ++j;
+        }
+        flushRun(board, runStart, runEnd);
+    }
+
+
+
+    // 【内部メソッド】位置の順（上の行から、行の中は左から）で前か
+    static bool before(s3d::Point a, s3d::Point b)
+    {
+        return a.y < b.y || (a.y == b.y && a.x < b.x);
+    }
+
+
+
+    // 【内部メソッド】描画用イメージの点の読み書き（8bitの点は色のアルファだけ。疎なイメージは書くときだけタイルを割り当てる）
+    static s3d::Color readPixel(const s3d::Image& img, s3d::Point pos)         { return img[pos.y][pos.x]; }
+    static s3d::Color readPixel(const KotsubuImage8& img, s3d::Point pos)      { return s3d::Color(0, 0, 0, img[pos.y][pos.x]); }
+    static s3d::Color readPixel(const KotsubuImageView& img, s3d::Point pos)   { return img[pos.y][pos.x]; }
+    static s3d::Color readPixel(const KotsubuSparseImage& img, s3d::Point pos) { return img.get(pos.x, pos.y); }
+
+    static void writePixel(s3d::Image& img, s3d::Point pos, const s3d::Color& col)         { img[pos.y][pos.x] = col; }
+    static void writePixel(KotsubuImage8& img, s3d::Point pos, const s3d::Color& col)      { img[pos.y][pos.x] = col.a; }
+    static void writePixel(KotsubuImageView& img, s3d::Point pos, const s3d::Color& col)   { img[pos.y][pos.x] = col; }
+    static void writePixel(KotsubuSparseImage& img, s3d::Point pos, const s3d::Color& col) { img.at(pos.x, pos.y) = col; }
+
+
+
+    // 【内部メソッド】描く前の色に線分の色を合成した色（8bitの点はアルファだけを合成する）
+    template <BlendMode Blend, class Surface>
+    static s3d::Color compose(const s3d::Color& under, const s3d::Color& col)
+    {
+        if constexpr (std::is_same_v<Surface, KotsubuImage8>) {
+            s3d::uint8 out = under.a;
+            kotsubu_detail::blendPixel<Blend>(out, col);
+            return s3d::Color(0, 0, 0, out);
+        }
+        else {
+            s3d::Color out = under;
+            kotsubu_detail::blendPixel<Blend>(out, col);
+            return out;
+        }
+    }
+
+
+
+    // 【内部メソッド】横のラン（両端を含む）をボードに通知する
+    void flushRun(KotsubuPixelBoard& board, s3d::Point runStart, s3d::int32 runEnd) const
+    {
+        if (runStart.x < 0) return;
+        board.markDirty(s3d::Rect(runStart.x, runStart.y, runEnd - runStart.x + 1, 1));
+    }
+};
@@ -0,0 +1,217 @@
+/**************************************************************************************************
+【ヘッダオンリー】kotsubu_simd v1.0
+
+・概要
+kotsubu_line_renderer.h の減衰する線分（アルファのグラデーション）を、SIMDでまとめて書くための内部関数群。
+連続する点のアルファを「初期値 + i * 増分」のベクトルで作り、色と合成して一度に格納する。
+x64はAVX2（8点ずつ。実行時にCPUを判定）とSSE2（4点ずつ。x64では常に使える）、ARMはNEON（4点ずつ）。
+いずれも使えない環境では1点ずつの処理になる。どの方式でも結果は同じ。
+
+・使い方（通常はkotsubu_line_renderer.hから使われるので、直接使う必要はない）
+kotsubu_detail::alphaRamp()(p, count, rgbBits, alpha, delta);   // 実行時に選ばれた方式で書く
+kotsubu_detail::setSimdLevel(kotsubu_detail::SimdLevel::Scalar); // 方式を固定する（計測や比較用）
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#   define KOTSUBU_SIMD_X86 1
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#   define KOTSUBU_SIMD_NEON 1
+#   include <arm_neon.h>
+#endif
+
+// GCCとClangは、AVX2の関数だけ個別に有効にする（MSVCは指定なしでAVX2の組み込み関数を使える）
+#if defined(KOTSUBU_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#   define KOTSUBU_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#   define KOTSUBU_TARGET_AVX2
+#endif
+
+
+
+namespace kotsubu_detail
+{
+    // 【内部型】SIMDの方式
+    enum class SimdLevel { Scalar, SSE2, AVX2, NEON };
+
+
+
+    // 【内部型】アルファのグラデーションを書く関数
+    // p[i] = rgbBits | (アルファ8bit << 24)、アルファ = (alpha + i * delta) の16.16固定小数点を四捨五入したもの
+    // alpha + i * delta は、すべてのiで 0 以上 255 << 16 以下であること
+    using AlphaRampFunc = void (*)(s3d::Color* p, s3d::int32 count, s3d::uint32 rgbBits,
+                                   s3d::int32 alpha, s3d::int32 delta);
+
+
+
+    // 【内部関数】色を32bitの並び（メモリ上のr, g, b, aの順）にする。アルファは0にする
+    inline s3d::uint32 toRGBBits(s3d::Color col)
+    {
+        col.a = 0;
+        s3d::uint32 bits;
+        std::memcpy(&bits, &col, sizeof(bits));
+        return bits;
+    }
+
+
+
+    // 【内部関数】1点ずつ（どの環境でも使える）
+    inline void alphaRampScalar(s3d::Color* p, s3d::int32 count, s3d::uint32 rgbBits,
+                                s3d::int32 alpha, s3d::int32 delta)
+    {
+        for (s3d::int32 i = 0; i < count; ++i, alpha += delta) {
+            const s3d::uint32 bits = rgbBits | (static_cast<s3d::uint32>((alpha + 0x8000) >> 16) << 24);
+            std::memcpy(static_cast<void*>(p + i), &bits, sizeof(bits));
+        }
+    }
+
+
+
+#if defined(KOTSUBU_SIMD_X86)
+    // 【内部関数】SSE2で4点ずつ
+    inline void alphaRampSSE2(s3d::Color* p, s3d::int32 count, s3d::uint32 rgbBits,
+                              s3d::int32 alpha, s3d::int32 delta)
+    {
+        const __m128i rgb   = _mm_set1_epi32(static_cast<int>(rgbBits));
+        const __m128i half  = _mm_set1_epi32(0x8000);
+        const __m128i step4 = _mm_set1_epi32(delta * 4);
+        __m128i       a     = _mm_setr_epi32(alpha, alpha + delta, alpha + delta * 2, alpha + delta * 3);
+
+        s3d::int32 i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const __m128i a8 = _mm_slli_epi32(_mm_srli_epi32(_mm_add_epi32(a, half), 16), 24);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_or_si128(a8, rgb));
+            a = _mm_add_epi32(a, step4);
+        }
+        alphaRampScalar(p + i, count - i, rgbBits, alpha + delta * i, delta);
+    }
+
+
+
+    // 【内部関数】AVX2で8点ずつ（CPUが対応しているときだけ呼ばれる）
+    KOTSUBU_TARGET_AVX2
+    inline void alphaRampAVX2(s3d::Color* p, s3d::int32 count, s3d::uint32 rgbBits,
+                              s3d::int32 alpha, s3d::int32 delta)
+    {
+        const __m256i rgb   = _mm256_set1_epi32(static_cast<int>(rgbBits));
+        const __m256i half  = _mm256_set1_epi32(0x8000);
+        const __m256i step8 = _mm256_set1_epi32(delta * 8);
+        __m256i       a     = _mm256_add_epi32(_mm256_set1_epi32(alpha),
+                                               _mm256_mullo_epi32(_mm256_set1_epi32(delta),
+                                                                  _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+        s3d::int32 i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256i a8 = _mm256_slli_epi32(_mm256_srli_epi32(_mm256_add_epi32(a, half), 16), 24);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), _mm256_or_si256(a8, rgb));
+            a = _mm256_add_epi32(a, step8);
+        }
+        alphaRampScalar(p + i, count - i, rgbBits, alpha + delta * i, delta);
+    }
+
+
+
+    // 【内部関数】CPUがAVX2に対応しているか（OSがAVXのレジスタを保存するかも含めて確認）
+    inline bool cpuHasAVX2()
+    {
+#   if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx     = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx) return false;
+        if ((_xgetbv(0) & 0x6) != 0x6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#   else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#   endif
+    }
+#endif
+
+
+
+#if defined(KOTSUBU_SIMD_NEON)
+    // 【内部関数】NEONで4点ずつ
+    inline void alphaRampNEON(s3d::Color* p, s3d::int32 count, s3d::uint32 rgbBits,
+                              s3d::int32 alpha, s3d::int32 delta)
+    {
+        const int32_t   init[4] = { alpha, alpha + delta, alpha + delta * 2, alpha + delta * 3 };
+        const uint32x4_t rgb   = vdupq_n_u32(rgbBits);
+        const int32x4_t  half  = vdupq_n_s32(0x8000);
+        const int32x4_t  step4 = vdupq_n_s32(delta * 4);
+        int32x4_t        a     = vld1q_s32(init);
+
+        s3d::int32 i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const uint32x4_t a8 = vshlq_n_u32(vshrq_n_u32(vreinterpretq_u32_s32(vaddq_s32(a, half)), 16), 24);
+            vst1q_u32(reinterpret_cast<uint32_t*>(p + i), vorrq_u32(a8, rgb));
+            a = vaddq_s32(a, step4);
+        }
+        alphaRampScalar(p + i, count - i, rgbBits, alpha + delta * i, delta);
+    }
+#endif
+
+
+
+    // 【内部関数】この環境で使える最も速い方式
+    inline SimdLevel detectSimdLevel()
+    {
+#if defined(KOTSUBU_SIMD_X86)
+        return cpuHasAVX2() ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#elif defined(KOTSUBU_SIMD_NEON)
+        return SimdLevel::NEON;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+
+
+    // 【内部関数】方式に対応する関数。この環境で使えない方式なら1点ずつの関数を返す
+    inline AlphaRampFunc alphaRampFunc(SimdLevel level)
+    {
+        switch (level) {
+#if defined(KOTSUBU_SIMD_X86)
+        case SimdLevel::SSE2: return alphaRampSSE2;
+        case SimdLevel::AVX2: return cpuHasAVX2() ? alphaRampAVX2 : alphaRampSSE2;
+#endif
+#if defined(KOTSUBU_SIMD_NEON)
+        case SimdLevel::NEON: return alphaRampNEON;
+#endif
+        default:              return alphaRampScalar;
+        }
+    }
+
+
+
+    // 【内部関数】選ばれている関数（最初の呼び出しでCPUを判定して選ぶ）
+    inline AlphaRampFunc& alphaRampSlot()
+    {
+        static AlphaRampFunc func = alphaRampFunc(detectSimdLevel());
+        return func;
+    }
+
+    inline AlphaRampFunc alphaRamp()
+    {
+        return alphaRampSlot();
+    }
+
+
+
+    // 【内部関数】方式を固定する（計測や、方式ごとの結果の比較用）
+    inline void setSimdLevel(SimdLevel level)
+    {
+        alphaRampSlot() = alphaRampFunc(level);
+    }
+}
@@ -0,0 +1,373 @@
+/**************************************************************************************************
+【ヘッダオンリークラス】kotsubu_stroke_layer v1.0
+
+・概要
+確定した線分（ストローク）を保持して、ボードに描くレイヤー（OpenSiv3D v0.6以降専用）
+イメージを64x64ドットのタイルに分け、タイルごとに掛かるストロークの一覧を持つ（一様グリッド）。
+ストロークを追加・変更・削除すると、掛かるタイルだけが書き直しの対象になり、
+render()はそのタイルだけを背景色に戻してから、掛かるストロークを追加した順番に描き直す。
+結果は、すべてのストロークを追加した順番に個別の関数（整数版）で描いた場合と同じになる。
+点に一番近いストロークの検索も、グリッドを近い順に調べるので全件を調べない。
+ボードの形式（8bit、疎なタイル、外部バッファ）に合わせたイメージに書く。
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_stroke_layer.h"
+KotsubuStrokeLayer layer;
+size_t id = layer.add(LineSegment{ startPos, endPos, ColorF(1.0), LineMode::AA });  // 番号は追加した順
+layer.set(id, LineSegment{ startPos, newEndPos, ColorF(1.0), LineMode::AA });        // 変更
+layer.remove(id);                                                                    // 削除
+メインループ
+    layer.render(board);                       // 変化のあったタイルだけを描き直す（clear()は要らない）
+    board.draw();
+    if (const auto hit = layer.hitTest(board.toImagePos(Cursor::Pos()), 4.0))    // 4ドット以内で一番近いもの
+        layer.remove(*hit);
+＜注意＞ レイヤーはボードのイメージ全体を受け持つ。ボードを別にclear()したら、invalidate()を呼ぶこと
+＜注意＞ 検索の対象は、イメージの範囲に掛かっているストロークだけ（グリッドは最初のrender()で作られる）
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_line_renderer.h"
+#include "kotsubu_tile_renderer.h"
+
+
+
+class KotsubuStrokeLayer
+{
+private:
+    // 【内部型】ストローク1本分
+    struct Stroke
+    {
+        LineSegment                segment;
+        kotsubu_detail::BatchEntry entry;  // 前準備の結果（描き直しのたびに作らない）
+        bool                       alive;
+    };
+
+    // 【内部フィールド】
+    s3d::Array<Stroke>                  mStrokes;     // 番号順（削除した番号は欠番のまま）
+    s3d::Array<s3d::Array<s3d::uint32>> mTiles;       // タイルごとの、掛かるストロークの番号（番号順）
+    s3d::Array<bool>                    mTileDirty;
+    s3d::Array<s3d::uint32>             mDirtyList;   // 書き直すタイルの番号
+    s3d::int32                          mWidth;       // グリッドを作ったときのイメージのサイズ
+    s3d::int32                          mHeight;
+    s3d::int32                          mTilesX;
+    s3d::int32                          mTilesY;
+    size_t                              mAliveCount;
+    s3d::Color                          mBackground;
+
+
+
+public:
+    // 【コンストラクタ】
+    explicit KotsubuStrokeLayer(s3d::Color background = s3d::Color(0, 0, 0, 0))
+    {
+        mWidth      = 0;
+        mHeight     = 0;
+        mTilesX     = 0;
+        mTilesY     = 0;
+        mAliveCount = 0;
+        mBackground = background;
+    }
+
+
+
+    // 【メソッド】ストロークを追加して、番号を返す（後から追加したものほど上に描かれる）
+    size_t add(const LineSegment& segment)
+    {
+        const size_t id = mStrokes.size();
+        mStrokes.push_back(Stroke{ segment, kotsubu_detail::makeBatchEntry(segment), true });
+        ++mAliveCount;
+        forEachTile(mStrokes[id].entry, [&](size_t tile) {
+            mTiles[tile].push_back(static_cast<s3d::uint32>(id));  // 一番大きい番号なので末尾でよい
+            markTile(tile);
+        });
+        return id;
+    }
+
+
+
+    // 【メソッド】ストロークを変更する（重なりの順番は変わらない）
+    void set(size_t id, const LineSegment& segment)
+    {
+        if (!isAlive(id)) return;
+        unlink(id);
+        mStrokes[id].segment = segment;
+        mStrokes[id].entry   = kotsubu_detail::makeBatchEntry(segment);
+        forEachTile(mStrokes[id].entry, [&](size_t tile) {
+            s3d::Array<s3d::uint32>& list = mTiles[tile];
+            list.insert(std::lower_bound(list.begin(), list.end(), static_cast<s3d::uint32>(id)),
+                        static_cast<s3d::uint32>(id));
+            markTile(tile);
+        });
+    }
+
+
+
+    // 【メソッド】ストロークを削除する
+    void remove(size_t id)
+    {
+        if (!isAlive(id)) return;
+        unlink(id);
+        mStrokes[id].alive = false;
+        --mAliveCount;
+    }
+
+
+
+    // 【メソッド】すべてのストロークを削除する（次のrender()でイメージ全体が背景色になる）
+    void clear()
+    {
+        mStrokes.clear();
+        mAliveCount = 0;
+        for (auto& list : mTiles) list.clear();
+        invalidate();
+    }
+
+
+
+    // 【メソッド】すべてのタイルを書き直しの対象にする
+    void invalidate()
+    {
+        for (size_t tile = 0; tile < mTiles.size(); ++tile)
+            markTile(tile);
+    }
+
+
+
+    // 【セッタ】背景色（ストロークの無いところの色）
+    void setBackground(s3d::Color background)
+    {
+        mBackground = background;
+        invalidate();
+    }
+
+
+
+    // 【ゲッタ】ストローク
+    bool isAlive(size_t id) const
+    {
+        return id < mStrokes.size() && mStrokes[id].alive;
+    }
+
+    const LineSegment& stroke(size_t id) const
+    {
+        return mStrokes[id].segment;
+    }
+
+    size_t count() const
+    {
+        return mAliveCount;
+    }
+
+
+
+    // 【メソッド】変化のあったタイルだけを描き直して、ボードに通知する
+    // タイルは背景色で塗ってから、掛かるストロークを番号順にタイルの範囲でクリップして描く。
+    // タイル同士は書き込み先が重ならないので、補助スレッドがあれば並列に描く。
+    // 書き込み先はボードの形式に合わせる（疎なイメージは、白紙のままでよいタイルを割り当てない）
+    void render(KotsubuPixelBoard& board)
+    {
+        KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+
+        kotsubu_detail::withBoardImage(board, [&](auto& img) {
+            if (img.width() != mWidth || img.height() != mHeight) rebuild(img.width(), img.height());
+            renderTiles(img);
+        });
+
+        for (const s3d::uint32 tile : mDirtyList) {
+            const kotsubu_detail::ClipRect clip = tileClip(tile);
+            board.markDirty(s3d::Rect(clip.left, clip.top, clip.right - clip.left + 1, clip.bottom - clip.top + 1));
+            mTileDirty[tile] = false;
+        }
+        mDirtyList.clear();
+    }
+
+
+
+    // 【メソッド】点（イメージ座標）に一番近いストロークを探す（maxDistanceドットより遠ければ無し）
+    // 距離は端点を結ぶ理想直線まで。同じ距離なら上に描かれているもの（番号の大きい方）を返す。
+    // 点を含むタイルから外側へ1周ずつ調べ、調べていないタイルまでの距離が見つけた距離を超えたら打ち切る
+    s3d::Optional<size_t> hitTest(s3d::Point pos, double maxDistance = 4.0) const
+    {
+        if (mTilesX == 0 || mAliveCount == 0) return s3d::none;
+
+        using kotsubu_detail::TileSize;
+        const s3d::int32 tx = std::clamp(floorTile(pos.x), 0, mTilesX - 1);
+        const s3d::int32 ty = std::clamp(floorTile(pos.y), 0, mTilesY - 1);
+        const s3d::int32 maxRing = std::max({ tx, ty, mTilesX - 1 - tx, mTilesY - 1 - ty });
+
+        double bestDist = maxDistance * maxDistance;
+        s3d::Optional<size_t> best;
+        for (s3d::int32 ring = 0; ring <= maxRing; ++ring) {
+            for (s3d::int32 y = ty - ring; y <= ty + ring; ++y) {
+                if (y < 0 || y >= mTilesY) continue;
+                const bool edgeRow = (y == ty - ring) || (y == ty + ring);
+                for (s3d::int32 x = tx - ring; x <= tx + ring; x += (edgeRow ? 1 : 2 * ring)) {
+                    if (x >= 0 && x < mTilesX) {
+                        for (const s3d::uint32 id : mTiles[static_cast<size_t>(y) * mTilesX + x]) {
+                            const double d = distanceSq(mStrokes[id].segment, pos);
+                            if (d < bestDist || (d == bestDist && best && id > *best)) { bestDist = d; best = id; }
+                        }
+                    }
+                    if (ring == 0) break;
+                }
+            }
+
+            // 調べた正方形の外にある点は、正方形の辺より遠い。ただし描いた点は理想直線から
+            // 最大で約1.5ドット（Wuやサブピクセルの端点の場合）ずれるので、その分を差し引く
+            const double margin = std::min({ pos.x - (tx - ring) * TileSize, (tx + ring + 1) * TileSize - pos.x,
+                                             pos.y - (ty - ring) * TileSize, (ty + ring + 1) * TileSize - pos.y }) - 2.0;
+            if (margin > 0.0 && margin * margin > bestDist) break;
+        }
+        return best;
+    }
+
+
+
+private:
+    // 【内部メソッド】イメージのサイズに合わせてグリッドを作り直す（すべてのタイルを書き直す）
+    void rebuild(s3d::int32 width, s3d::int32 height)
+    {
+        using kotsubu_detail::TileSize;
+        mWidth  = width;
+        mHeight = height;
+        mTilesX = (width  + TileSize - 1) / TileSize;
+        mTilesY = (height + TileSize - 1) / TileSize;
+        mTiles.assign(static_cast<size_t>(mTilesX) * mTilesY, s3d::Array<s3d::uint32>());
+        mTileDirty.assign(mTiles.size(), false);
+        mDirtyList.clear();
+
+        for (size_t id = 0; id < mStrokes.size(); ++id) {
+            if (!mStrokes[id].alive) continue;
+            forEachTile(mStrokes[id].entry, [&](size_t tile) {
+                mTiles[tile].push_back(static_cast<s3d::uint32>(id));
+            });
+        }
+        invalidate();
+    }
+
+
+
+    // 【内部メソッド】書き直すタイルを描く（render()の本体）
+    template <class Surface>
+    void renderTiles(Surface& img)
+    {
+        using namespace kotsubu_detail;
+        if (mDirtyList.empty()) return;
+
+        // 疎なイメージは、書くタイルを先に1スレッドで割り当てておく
+        // （ストロークが無く背景色が白紙なら、割り当てていないタイルはそのままでよい）
+        if constexpr (std::is_same_v<Surface, KotsubuSparseImage>) {
+            for (const s3d::uint32 tile : mDirtyList) {
+                const s3d::int32 tx = static_cast<s3d::int32>(tile % mTilesX);
+                const s3d::int32 ty = static_cast<s3d::int32>(tile / mTilesX);
+                if (!mTiles[tile].empty() || mBackground != KotsubuSparseImage::Blank || img.findTile(tx, ty))
+                    img.tile(tx, ty);
+            }
+        }
+
+        using Pixel = PixelOf<decltype(tileSurface(img, 0, 0))>;
+        const Pixel background = pixelValue<Pixel>(mBackground);
+        WorkerPool& pool = workerPool();
+        pool.parallelFor(mDirtyList.size(), pool.workerCount(), [&](size_t i) {
+            const size_t     tile = mDirtyList[i];
+            const s3d::int32 tx   = static_cast<s3d::int32>(tile % mTilesX);
+            const s3d::int32 ty   = static_cast<s3d::int32>(tile / mTilesX);
+            if constexpr (std::is_same_v<Surface, KotsubuSparseImage>) {
+                if (!img.findTile(tx, ty)) return;
+            }
+            const ClipRect clip = tileClip(tile);
+            auto&& surface = tileSurface(img, tx, ty);
+            using TileSurface = std::remove_reference_t<decltype(surface)>;
+            for (s3d::int32 y = clip.top; y <= clip.bottom; ++y)
+                std::fill_n(&surface[y][clip.left], clip.right - clip.left + 1, background);
+            KOTSUBU_BOARD_STATS_WRITTEN(static_cast<s3d::int64>(clip.right - clip.left + 1) * (clip.bottom - clip.top + 1));
+            for (const s3d::uint32 id : mTiles[tile])
+                batchDrawTable<TileSurface>[mStrokes[id].entry.bucket](surface, mStrokes[id].entry, clip);
+        });
+    }
+
+
+
+    // 【内部メソッド】ストロークを、掛かるタイルの一覧から外す（外したタイルは書き直す）
+    void unlink(size_t id)
+    {
+        forEachTile(mStrokes[id].entry, [&](size_t tile) {
+            s3d::Array<s3d::uint32>& list = mTiles[tile];
+            const auto it = std::lower_bound(list.begin(), list.end(), static_cast<s3d::uint32>(id));
+            if (it != list.end() && *it == id) list.erase(it);
+            markTile(tile);
+        });
+    }
+
+
+
+    // 【内部メソッド】線分が掛かるタイルごとにf(タイルの番号)を呼ぶ
+    // 帯（1行分のタイル）ごとに、線分が通るxの範囲を求める（kotsubu_tile_renderer.hの振り分けと同じ）
+    template <class F>
+    void forEachTile(const kotsubu_detail::BatchEntry& entry, F&& f) const
+    {
+        using namespace kotsubu_detail;
+        const LineSetup& ls = entry.ls;
+        if (mTilesX == 0) return;
+        const s3d::int32 margin = entry.wu ? 1 : 0;  // Wuの点は縦にも1ドットはみ出すことがある
+        const s3d::int32 top    = std::max(std::min(ls.startPos.y, ls.endPos.y) - margin, 0);
+        const s3d::int32 bottom = std::min(std::max(ls.startPos.y, ls.endPos.y) + margin, mHeight - 1);
+        for (s3d::int32 band = top / TileSize; band <= bottom / TileSize && top <= bottom; ++band) {
+            const ClipRect bandClip{ 0, band * TileSize, mWidth - 1, std::min((band + 1) * TileSize, mHeight) - 1 };
+            s3d::int32 lo, hi;
+            if (!clipXRange(ls, bandClip, lo, hi, entry.wu)) continue;
+            for (s3d::int32 tx = lo / TileSize; tx <= hi / TileSize; ++tx)
+                f(static_cast<size_t>(band) * mTilesX + tx);
+        }
+    }
+
+
+
+    // 【内部メソッド】タイルを書き直しの対象にする
+    void markTile(size_t tile)
+    {
+        if (mTileDirty[tile]) return;
+        mTileDirty[tile] = true;
+        mDirtyList.push_back(static_cast<s3d::uint32>(tile));
+    }
+
+
+
+    // 【内部メソッド】タイルの範囲（両端を含む）
+    kotsubu_detail::ClipRect tileClip(size_t tile) const
+    {
+        using kotsubu_detail::TileSize;
+        const s3d::int32 tx = static_cast<s3d::int32>(tile % mTilesX);
+        const s3d::int32 ty = static_cast<s3d::int32>(tile / mTilesX);
+        return kotsubu_detail::ClipRect{ tx * TileSize, ty * TileSize,
+                                         std::min((tx + 1) * TileSize, mWidth)  - 1,
+                                         std::min((ty + 1) * TileSize, mHeight) - 1 };
+    }
+
+
+
+    // 【内部メソッド】座標を含むタイルの位置（負の数でも切り捨てる）
+    static s3d::int32 floorTile(s3d::int32 v)
+    {
+        using kotsubu_detail::TileSize;
+        return (v >= 0) ? (v / TileSize) : -((-v + TileSize - 1) / TileSize);
+    }
+
+
+
+    // 【内部メソッド】点から線分（端点を結ぶ理想直線）までの距離の2乗
+    // 端点は固定小数点なので、点の中心を整数に合わせた座標に直す
+    static double distanceSq(const LineSegment& seg, s3d::Point pos)
+    {
+        const double ax = seg.startPos.x / 256.0 - 0.5, ay = seg.startPos.y / 256.0 - 0.5;
+        const double dx = seg.endPos.x / 256.0 - 0.5 - ax, dy = seg.endPos.y / 256.0 - 0.5 - ay;
+        const double px = pos.x - ax, py = pos.y - ay;
+        const double len = dx * dx + dy * dy;
+        const double t = (len > 0.0) ? std::clamp((px * dx + py * dy) / len, 0.0, 1.0) : 0.0;
+        const double ex = px - t * dx, ey = py - t * dy;
+        return ex * ex + ey * ey;
+    }
+};
@@ -0,0 +1,671 @@
+/**************************************************************************************************
+【ヘッダオンリー】kotsubu_stroke_recorder v1.0
+
+・概要
+描いた線分（ストローク）の記録と再生（OpenSiv3D v0.6以降専用）
+記録は小さなバイナリ形式で、先頭から順に書き足すだけ（書き出しながらファイルへ流せる）。
+ポインタを含まないので、ファイルをメモリマップしてそのまま読める。
+再生は命令バッファ（kotsubu_command_buffer.h）へ流し込むので、タイルに分けた並列のレンダリングになり、
+結果は記録した順番に個別の関数（整数版）で描いた場合と同じになる。
+KotsubuStrokeHistoryは、一定本数ごとにイメージのスナップショットを取り、
+アンドゥを「直前のスナップショットから、戻したい位置までの再生」で行う（O(スナップショット以降の本数)）。
+
+・形式（数値はリトルエンディアン）
+ヘッダ 8バイト   --- 'K' 'T' 'S' 'K'、版（1）、予約（0が3つ）
+記録（タグ1バイト＋続き）
+  タグのビット0～2 --- LineModeの番号（7はボード全体のクリア。続きは無い）
+  ビット3～4       --- BlendModeの番号
+  ビット5          --- 色が変わった（続きにr, g, b, aの4バイト）
+  ビット6          --- 割合が変わった（続きにdecaySectionRate, aaColorRateのdouble 2つ）
+  ビット7          --- 両端が点の中心（座標の差をドット単位で持つ。0なら1/256ドット単位）
+  続き             --- 色、割合（あれば）、始点と前の終点の差（x, y）、終点と始点の差（x, y）
+                       差はジグザグ変換した可変長整数（7ビットずつ、続きがあれば最上位ビットが1）
+つながった線を描くと始点の差は0になり、短い線分なら1本あたり5バイト程度になる
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_stroke_recorder.h"
+KotsubuStrokeWriter writer(U"session.kst");               // ファイルへ書き出す（64KBずつ書く）
+writer.add(LineSegment{ startPos, endPos, ColorF(1.0), LineMode::Decay, 0.5, 0.3 });
+writer.clear();                                           // ボード全体のクリアを記録
+writer.close();                                           // 残りを書いて閉じる（デストラクタでも閉じる）
+
+s3d::MemoryMappedFileView file(U"session.kst");           // メモリマップして読む（s3d::Blobなどのメモリでもよい）
+const auto mapped = file.map();
+KotsubuStrokeReader reader(mapped.data, mapped.size);
+KotsubuCommandBuffer commands(thumbnail);
+replayStrokes(reader, commands);                          // 全部を命令バッファへ流し込む
+commands.draw();                                          // まとめて描いてドロー
+
+KotsubuStrokeHistory history(board);                      // アンドゥ付きで描く（256本ごとにスナップショット）
+メインループ
+    if (MouseL.down()) mark = history.size();             // ドラッグの始まりの位置を覚えておく
+    history.add(LineSegment{ prevPos, pos, ColorF(1.0), LineMode::AA });
+    if (KeyZ.down()) history.undoTo(mark);                // ドラッグ1回分を取り消す
+    history.draw();                                       // board.draw()の代わり
+history.bytes();                                          // 記録の全体（ファイルと同じ形式）
+＜注意＞ KotsubuStrokeHistoryは、作ったときのボードの内容から始める。ボードのサイズや形式を変えたら作り直すこと。
+疎な記憶方式のボードでは、スナップショットを取らない（記録はできるが、undoTo()は何もしない）
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include <cstring>
+#include <limits>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_line_renderer.h"
+#include "kotsubu_command_buffer.h"
+
+
+
+// 【型】ストロークの記録の1件を読んだ結果
+// Stroke --- 線分（LineSegmentに入る）
+// Clear  --- ボード全体のクリア
+// End    --- 終わり
+// Error  --- 壊れている（ヘッダが違う、途中で切れている、知らないタグ）
+enum class StrokeRecord { Stroke, Clear, End, Error };
+
+
+
+namespace kotsubu_detail
+{
+    // 【内部定数】記録の形式
+    constexpr s3d::uint8 StrokeMagic[4]   = { 'K', 'T', 'S', 'K' };
+    constexpr s3d::uint8 StrokeVersion    = 1;
+    constexpr size_t     StrokeHeaderSize = 8;
+
+    constexpr s3d::uint8 StrokeTagMode       = 0x07;  // LineModeの番号
+    constexpr s3d::uint8 StrokeTagClear      = 0x07;  // ボード全体のクリア（タグ全体がこの値）
+    constexpr s3d::uint8 StrokeTagBlendShift = 3;     // BlendModeの番号の位置
+    constexpr s3d::uint8 StrokeTagColor      = 0x20;
+    constexpr s3d::uint8 StrokeTagRates      = 0x40;
+    constexpr s3d::uint8 StrokeTagCentered   = 0x80;
+
+
+
+    // 【内部型】記録の読み書きの状態（差や変化を求める元。書く側と読む側で同じ値から始める）
+    struct StrokeCodecState
+    {
+        FixedPoint prevEnd          = FixedPoint(0, 0);
+        s3d::Color col              = s3d::Color(0, 0, 0, 0);
+        double     decaySectionRate = 0.5;
+        double     aaColorRate      = 0.3;
+    };
+
+
+
+    // 【内部関数】ヘッダを書く
+    inline void putStrokeHeader(s3d::Array<s3d::uint8>& out)
+    {
+        out.insert(out.end(), std::begin(StrokeMagic), std::end(StrokeMagic));
+        out.push_back(StrokeVersion);
+        out.insert(out.end(), StrokeHeaderSize - 5, s3d::uint8(0));
+    }
+
+
+
+    // 【内部関数】ヘッダを確かめる
+    inline bool checkStrokeHeader(const s3d::uint8* data, size_t size)
+    {
+        return (size >= StrokeHeaderSize) && std::equal(std::begin(StrokeMagic), std::end(StrokeMagic), data) &&
+               (data[4] == StrokeVersion);
+    }
+
+
+
+    // 【内部関数】ジグザグ変換した可変長整数を書く（0, -1, 1, -2, ... の順に小さくなる）
+    inline void putVarint(s3d::Array<s3d::uint8>& out, s3d::int32 value)
+    {
+        s3d::uint32 z = (static_cast<s3d::uint32>(value) << 1) ^ static_cast<s3d::uint32>(value >> 31);
+        while (z >= 0x80) {
+            out.push_back(static_cast<s3d::uint8>(z | 0x80));
+            z >>= 7;
+        }
+        out.push_back(static_cast<s3d::uint8>(z));
+    }
+
+
+
+    // 【内部関数】ジグザグ変換した可変長整数を読む（途中で切れている、長すぎるならfalse）
+    inline bool getVarint(const s3d::uint8*& p, const s3d::uint8* end, s3d::int32& value)
+    {
+        s3d::uint32 z = 0;
+        for (s3d::uint32 shift = 0; shift < 35; shift += 7) {
+            if (p == end) return false;
+            const s3d::uint8 b = *p++;
+            z |= static_cast<s3d::uint32>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                value = static_cast<s3d::int32>(z >> 1) ^ -static_cast<s3d::int32>(z & 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+
+    // 【内部関数】doubleをリトルエンディアンの8バイトで書く・読む
+    inline void putDouble(s3d::Array<s3d::uint8>& out, double value)
+    {
+        s3d::uint64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; ++i)
+            out.push_back(static_cast<s3d::uint8>(bits >> (i * 8)));
+    }
+
+    inline double getDouble(const s3d::uint8*& p)
+    {
+        s3d::uint64 bits = 0;
+        for (int i = 0; i < 8; ++i)
+            bits |= static_cast<s3d::uint64>(p[i]) << (i * 8);
+        p += 8;
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+
+
+    // 【内部関数】線分の記録を書く（色と割合は変わったときだけ書く）
+    inline void putStroke(s3d::Array<s3d::uint8>& out, StrokeCodecState& st, const LineSegment& seg)
+    {
+        const s3d::Color col      = s3d::Color(seg.col);
+        const bool       newColor = (col.r != st.col.r) || (col.g != st.col.g) || (col.b != st.col.b) || (col.a != st.col.a);
+        const bool       newRates = (seg.decaySectionRate != st.decaySectionRate) || (seg.aaColorRate != st.aaColorRate);
+        const bool       centered = seg.startPos.isCentered() && seg.endPos.isCentered();
+
+        out.push_back(static_cast<s3d::uint8>(static_cast<s3d::uint8>(seg.mode) |
+                                              (static_cast<s3d::uint8>(seg.blend) << StrokeTagBlendShift) |
+                                              (newColor ? StrokeTagColor : 0) | (newRates ? StrokeTagRates : 0) |
+                                              (centered ? StrokeTagCentered : 0)));
+        if (newColor) {
+            out.insert(out.end(), { col.r, col.g, col.b, col.a });
+            st.col = col;
+        }
+        if (newRates) {
+            putDouble(out, seg.decaySectionRate);
+            putDouble(out, seg.aaColorRate);
+            st.decaySectionRate = seg.decaySectionRate;
+            st.aaColorRate      = seg.aaColorRate;
+        }
+
+        // 両端が点の中心なら、含まれる点の差（前の終点は、含まれる点にする）
+        if (centered) {
+            const s3d::Point prev = st.prevEnd.asPoint(), start = seg.startPos.asPoint(), end = seg.endPos.asPoint();
+            putVarint(out, start.x - prev.x);
+            putVarint(out, start.y - prev.y);
+            putVarint(out, end.x - start.x);
+            putVarint(out, end.y - start.y);
+        }
+        else {
+            putVarint(out, seg.startPos.x - st.prevEnd.x);
+            putVarint(out, seg.startPos.y - st.prevEnd.y);
+            putVarint(out, seg.endPos.x - seg.startPos.x);
+            putVarint(out, seg.endPos.y - seg.startPos.y);
+        }
+        st.prevEnd = seg.endPos;
+    }
+
+
+
+    // 【内部関数】記録を1件読む（線分ならsegに入る。pは次の記録へ進む）
+    inline StrokeRecord getRecord(const s3d::uint8*& p, const s3d::uint8* end, StrokeCodecState& st, LineSegment& seg)
+    {
+        if (p == end) return StrokeRecord::End;
+        const s3d::uint8* q   = p;
+        const s3d::uint8  tag = *q++;
+        if (tag == StrokeTagClear) {
+            p = q;
+            return StrokeRecord::Clear;
+        }
+        const s3d::uint8 mode  = tag & StrokeTagMode;
+        const s3d::uint8 blend = (tag >> StrokeTagBlendShift) & 0x03;
+        if ((mode >= LineModeCount) || (blend >= BlendModeCount)) return StrokeRecord::Error;
+
+        const size_t fixedBytes = ((tag & StrokeTagColor) ? 4 : 0) + ((tag & StrokeTagRates) ? 16 : 0);
+        if (static_cast<size_t>(end - q) < fixedBytes) return StrokeRecord::Error;
+        if (tag & StrokeTagColor) {
+            st.col = s3d::Color(q[0], q[1], q[2], q[3]);
+            q += 4;
+        }
+        if (tag & StrokeTagRates) {
+            st.decaySectionRate = getDouble(q);
+            st.aaColorRate      = getDouble(q);
+        }
+
+        s3d::int32 d[4];
+        for (auto& v : d)
+            if (!getVarint(q, end, v)) return StrokeRecord::Error;
+        if (tag & StrokeTagCentered) {
+            const s3d::Point start = st.prevEnd.asPoint() + s3d::Point(d[0], d[1]);
+            seg.startPos = FixedPoint(start);
+            seg.endPos   = FixedPoint(start + s3d::Point(d[2], d[3]));
+        }
+        else {
+            seg.startPos = FixedPoint(st.prevEnd.x + d[0], st.prevEnd.y + d[1]);
+            seg.endPos   = FixedPoint(seg.startPos.x + d[2], seg.startPos.y + d[3]);
+        }
+        seg.col              = st.col;
+        seg.mode             = static_cast<LineMode>(mode);
+        seg.blend            = static_cast<BlendMode>(blend);
+        seg.decaySectionRate = st.decaySectionRate;
+        seg.aaColorRate      = st.aaColorRate;
+        st.prevEnd = seg.endPos;
+        p = q;
+        return StrokeRecord::Stroke;
+    }
+}
+
+
+
+// 【クラス】ストロークの記録をファイルへ書き出す
+// 記録はメモリに貯め、64KBを超えたらファイルへ書く（close()、デストラクタで残りを書く）
+class KotsubuStrokeWriter
+{
+private:
+    // 【内部フィールド】
+    s3d::BinaryWriter                mFile;
+    s3d::Array<s3d::uint8>           mBuffer;  // まだ書いていない記録
+    kotsubu_detail::StrokeCodecState mState;
+    size_t                           mCount;   // 書いた記録の数
+
+    // この大きさを超えたらファイルへ書く
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+
+
+public:
+    // 【コンストラクタ】
+    KotsubuStrokeWriter()
+    {
+        mCount = 0;
+    }
+
+    explicit KotsubuStrokeWriter(s3d::FilePathView path) : KotsubuStrokeWriter()
+    {
+        open(path);
+    }
+
+    KotsubuStrokeWriter(const KotsubuStrokeWriter&)            = delete;
+    KotsubuStrokeWriter& operator=(const KotsubuStrokeWriter&) = delete;
+
+
+
+    // 【デストラクタ】残りを書いて閉じる
+    ~KotsubuStrokeWriter()
+    {
+        close();
+    }
+
+
+
+    // 【メソッド】ファイルを開いて（上書き）、ヘッダを書く。開けなければfalse
+    bool open(s3d::FilePathView path)
+    {
+        close();
+        if (!mFile.open(path)) return false;
+        mBuffer.clear();
+        mState = kotsubu_detail::StrokeCodecState();
+        mCount = 0;
+        kotsubu_detail::putStrokeHeader(mBuffer);
+        return true;
+    }
+
+
+
+    // 【ゲッタ】開いているか
+    bool isOpen() const
+    {
+        return mFile.isOpen();
+    }
+
+
+
+    // 【ゲッタ】書いた記録の数（線分とクリア）
+    size_t count() const
+    {
+        return mCount;
+    }
+
+
+
+    // 【メソッド】線分を記録する
+    void add(const LineSegment& segment)
+    {
+        if (!isOpen()) return;
+        kotsubu_detail::putStroke(mBuffer, mState, segment);
+        ++mCount;
+        if (mBuffer.size() >= ChunkSize) flush();
+    }
+
+
+
+    // 【メソッド】ボード全体のクリアを記録する
+    void clear()
+    {
+        if (!isOpen()) return;
+        mBuffer.push_back(kotsubu_detail::StrokeTagClear);
+        ++mCount;
+    }
+
+
+
+    // 【メソッド】貯めた記録をファイルへ書く
+    void flush()
+    {
+        if (!isOpen() || mBuffer.empty()) return;
+        mFile.write(mBuffer.data(), static_cast<s3d::int64>(mBuffer.size()));
+        mFile.flush();
+        mBuffer.clear();
+    }
+
+
+
+    // 【メソッド】残りを書いて閉じる
+    void close()
+    {
+        if (!isOpen()) return;
+        flush();
+        mFile.close();
+    }
+};
+
+
+
+// 【クラス】ストロークの記録を読む（メモリの上をそのまま読む。メモリはリーダーより長く生存させる）
+class KotsubuStrokeReader
+{
+private:
+    // 【内部フィールド】
+    const s3d::uint8*                mBegin;
+    const s3d::uint8*                mEnd;
+    const s3d::uint8*                mPos;
+    kotsubu_detail::StrokeCodecState mState;
+    size_t                           mCount;  // 読んだ記録の数
+    bool                             mValid;  // ヘッダが正しいか
+
+
+
+public:
+    // 【コンストラクタ】記録の全体（ヘッダから）。ヘッダが違えば、next()は最初からErrorを返す
+    KotsubuStrokeReader(const void* data, size_t size)
+    {
+        mBegin = static_cast<const s3d::uint8*>(data);
+        mEnd   = mBegin + size;
+        mValid = (data != nullptr) && kotsubu_detail::checkStrokeHeader(mBegin, size);
+        rewind();
+    }
+
+    explicit KotsubuStrokeReader(const s3d::Array<s3d::uint8>& bytes) : KotsubuStrokeReader(bytes.data(), bytes.size())
+    {}
+
+
+
+    // 【ゲッタ】ヘッダが正しいか
+    bool isValid() const
+    {
+        return mValid;
+    }
+
+
+
+    // 【ゲッタ】読んだ記録の数
+    size_t count() const
+    {
+        return mCount;
+    }
+
+
+
+    // 【ゲッタ】次に読む記録の位置（先頭からのバイト数）
+    size_t offset() const
+    {
+        return static_cast<size_t>(mPos - mBegin);
+    }
+
+
+
+    // 【メソッド】最初の記録に戻る
+    void rewind()
+    {
+        mPos   = mValid ? mBegin + kotsubu_detail::StrokeHeaderSize : mEnd;
+        mState = kotsubu_detail::StrokeCodecState();
+        mCount = 0;
+    }
+
+
+
+    // 【メソッド】次の記録を読む（Strokeならsegmentに入る）。End、Errorなら進まない
+    StrokeRecord next(LineSegment& segment)
+    {
+        if (!mValid) return StrokeRecord::Error;
+        const StrokeRecord record = kotsubu_detail::getRecord(mPos, mEnd, mState, segment);
+        if ((record == StrokeRecord::Stroke) || (record == StrokeRecord::Clear)) ++mCount;
+        return record;
+    }
+
+
+
+private:
+    // KotsubuStrokeHistoryは、スナップショットの位置から読み始める
+    friend class KotsubuStrokeHistory;
+
+    // 【内部メソッド】途中の位置から読み始める（位置と状態は、書いたときに覚えておいたもの）
+    void seek(size_t offset, const kotsubu_detail::StrokeCodecState& state, size_t count)
+    {
+        mPos   = mBegin + std::min(offset, static_cast<size_t>(mEnd - mBegin));
+        mState = state;
+        mCount = count;
+    }
+};
+
+
+
+// 【関数】記録を読んで、命令バッファへ流し込む（flush()はしない）
+// ストロークごとのメモリ確保は無い（命令バッファの配列は使い回される）。maxCount件まで読み、読んだ件数を返す。
+// クリアの記録はボード全体の矩形クリアになる（それより前の命令は、flush()のときに捨てられる）
+inline size_t replayStrokes(KotsubuStrokeReader& reader, KotsubuCommandBuffer& commands,
+                            size_t maxCount = std::numeric_limits<size_t>::max())
+{
+    LineSegment segment;
+    size_t count = 0;
+    for (; count < maxCount; ++count) {
+        const StrokeRecord record = reader.next(segment);
+        if      (record == StrokeRecord::Stroke) commands.line(segment);
+        else if (record == StrokeRecord::Clear)  commands.clearAll();
+        else                                     break;
+    }
+    return count;
+}
+
+
+
+// 【クラス】アンドゥ付きの記録（記録しながら描き、一定件数ごとにボードのスナップショットを取る）
+// アンドゥは、戻したい位置の手前の一番新しいスナップショットをボードに戻し、そこから記録を再生する
+class KotsubuStrokeHistory
+{
+private:
+    // 【内部型】スナップショット（記録のcount件目の直後のボードの内容と、その位置の読み書きの状態）
+    struct Snapshot
+    {
+        size_t                           count;
+        size_t                           offset;
+        kotsubu_detail::StrokeCodecState state;
+        s3d::Image                       img;   // RGBA8のとき（外部バッファのボードは、その写し）
+        KotsubuImage8                    img8;  // 8bitの形式のとき
+    };
+
+    // 【内部フィールド】
+    KotsubuPixelBoard*               mBoard;
+    KotsubuCommandBuffer             mCommands;
+    s3d::Array<s3d::uint8>           mBytes;      // 記録の全体（ヘッダから）
+    kotsubu_detail::StrokeCodecState mState;
+    size_t                           mCount;      // 記録の数
+    s3d::Array<Snapshot>             mSnapshots;  // 古い順
+    size_t                           mInterval;
+    size_t                           mMaxSnapshots;
+
+
+
+public:
+    // 【コンストラクタ】snapshotInterval件ごとにスナップショットを取り、maxSnapshots個まで持つ
+    // （超えたら古いものから捨てる。一番古いスナップショットより前へはアンドゥできない）
+    explicit KotsubuStrokeHistory(KotsubuPixelBoard& board, size_t snapshotInterval = 256, size_t maxSnapshots = 16)
+        : mCommands(board)
+    {
+        mBoard        = &board;
+        mCount        = 0;
+        mInterval     = std::max<size_t>(snapshotInterval, 1);
+        mMaxSnapshots = std::max<size_t>(maxSnapshots, 1);
+        kotsubu_detail::putStrokeHeader(mBytes);
+        takeSnapshot();
+    }
+
+
+
+    // 【メソッド】線分を記録して、描く命令を積む（draw()かflush()で描かれる）
+    void add(const LineSegment& segment)
+    {
+        kotsubu_detail::putStroke(mBytes, mState, segment);
+        mCommands.line(segment);
+        advance();
+    }
+
+
+
+    // 【メソッド】ボード全体のクリアを記録して、クリアの命令を積む
+    void clear()
+    {
+        mBytes.push_back(kotsubu_detail::StrokeTagClear);
+        mCommands.clearAll();
+        advance();
+    }
+
+
+
+    // 【ゲッタ】記録の数（線分とクリア）。undoTo()に渡す位置
+    size_t size() const
+    {
+        return mCount;
+    }
+
+
+
+    // 【ゲッタ】記録の全体（ファイルと同じ形式。KotsubuStrokeReaderで読める）
+    const s3d::Array<s3d::uint8>& bytes() const
+    {
+        return mBytes;
+    }
+
+
+
+    // 【メソッド】積んだ命令を描く
+    void flush(size_t threadCount = 0)
+    {
+        mCommands.flush(threadCount);
+    }
+
+
+
+    // 【メソッド】積んだ命令を描いてから、ボードをドローする（board.draw()の代わり）
+    void draw(size_t threadCount = 0)
+    {
+        mCommands.draw(threadCount);
+    }
+
+
+
+    // 【メソッド】記録をcount件目までに戻し、ボードもその時点の内容にする。戻した後の記録の数を返す
+    // 一番古いスナップショットより前には戻せない（そこまで戻す）。疎な記憶方式のボードでは何もしない
+    size_t undoTo(size_t count)
+    {
+        if ((count >= mCount) || mSnapshots.empty()) return mCount;
+
+        // 戻したい位置の手前で一番新しいスナップショット（無ければ一番古いもの）
+        size_t s = 0;
+        while ((s + 1 < mSnapshots.size()) && (mSnapshots[s + 1].count <= count)) ++s;
+        const Snapshot& snap = mSnapshots[s];
+        count = std::max(count, snap.count);
+        if (count >= mCount) return mCount;
+
+        // ボードを戻して、スナップショットの後ろから再生する
+        mCommands.discard();
+        KotsubuPixelBoard& board = *mBoard;
+        if      (board.is8bit())     board.mImg8 = snap.img8;
+        else if (board.isExternal()) copyRows(snap.img, board.mExternal);
+        else                         board.mImg  = snap.img;
+        board.markDirtyAll();
+
+        KotsubuStrokeReader reader(mBytes);
+        reader.seek(snap.offset, snap.state, snap.count);
+        replayStrokes(reader, mCommands, count - snap.count);
+        mCommands.flush();
+
+        // 記録を切り詰める
+        mBytes.resize(reader.offset());
+        mState = reader.mState;
+        mCount = count;
+        mSnapshots.resize(s + 1);
+        return mCount;
+    }
+
+
+
+    // 【メソッド】最後のcount件を取り消す
+    size_t undo(size_t count = 1)
+    {
+        return undoTo(mCount - std::min(count, mCount));
+    }
+
+
+
+private:
+    // 【内部メソッド】記録を1件進め、一定件数ごとにスナップショットを取る
+    void advance()
+    {
+        ++mCount;
+        if (mCount % mInterval == 0) takeSnapshot();
+    }
+
+
+
+    // 【内部メソッド】積んだ命令を描いてから、今のボードの内容と記録の位置を覚える（疎な記憶方式では取らない）
+    // いっぱいなら一番古いものを捨てる（イメージのメモリは新しいスナップショットで使い回す）
+    void takeSnapshot()
+    {
+        KotsubuPixelBoard& board = *mBoard;
+        if (board.isSparse()) return;
+        mCommands.flush();
+
+        Snapshot snap;
+        if (mSnapshots.size() >= mMaxSnapshots) {
+            snap = std::move(mSnapshots.front());
+            mSnapshots.erase(mSnapshots.begin());
+        }
+        snap.count  = mCount;
+        snap.offset = mBytes.size();
+        snap.state  = mState;
+        if (board.is8bit()) snap.img8 = board.mImg8;
+        else if (board.isExternal()) {
+            const KotsubuImageView& ext = board.mExternal;
+            snap.img.resize(static_cast<size_t>(ext.width()), static_cast<size_t>(ext.height()));
+            for (s3d::int32 y = 0; y < ext.height(); ++y)
+                std::copy_n(ext[y], ext.width(), snap.img[y]);
+        }
+        else {
+            snap.img = board.mImg;
+        }
+        mSnapshots.push_back(std::move(snap));
+    }
+
+
+
+    // 【内部関数】スナップショットを外部バッファへ書き戻す（行の間隔があるので1行ずつ）
+    static void copyRows(const s3d::Image& src, KotsubuImageView& dst)
+    {
+        const s3d::int32 w = std::min(src.width(), dst.width());
+        const s3d::int32 h = std::min(src.height(), dst.height());
+        for (s3d::int32 y = 0; y < h; ++y)
+            std::copy_n(src[y], w, dst[y]);
+    }
+};
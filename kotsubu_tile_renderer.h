@@ -0,0 +1,317 @@
+/**************************************************************************************************
+【ヘッダオンリー】kotsubu_tile_renderer v1.0
+
+・概要
+大量の線分を、複数のスレッドでまとめてレンダリングする関数群（OpenSiv3D v0.6以降専用）
+イメージを64x64ドットのタイルに分け、線分をクリップした結果で「掛かるタイル」に振り分けてから、
+タイルごとに並列に描く。1つのタイルは1つのスレッドだけが書くので、点の書き込みにロックは無い。
+タイルの中では線分をrenderLines()と同じ順番で描き、クリップしても点は変わらないので、
+結果はスレッドの数に関わらずrenderLines()とまったく同じになる（合成の方式、減衰の指定もそのまま使える）。
+
+・使い方
+#include <Siv3D.hpp>
+#include "kotsubu_tile_renderer.h"
+s3d::Array<LineSegment> segments;                       // renderLines()と同じ線分の配列
+segments << LineSegment{ startPos, endPos, ColorF(1.0), LineMode::Decay, 0.5, 0.3, BlendMode::Additive };
+renderLinesParallel(board, segments);                   // 使えるスレッドをすべて使う
+renderLinesParallel(board.mImg, segments, 4);           // スレッド数を指定（呼び出し元を含む。1ならrenderLines()と同じ）
+**************************************************************************************************/
+
+#pragma once
+#include <Siv3D.hpp>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "kotsubu_pixel_board.h"
+#include "kotsubu_line_renderer.h"
+
+
+
+namespace kotsubu_detail
+{
+    // 【内部定数】タイルの大きさ（ドット）
+    constexpr s3d::int32 TileSize = 64;
+
+
+
+    // 【内部クラス】補助スレッドの集まり（最初の利用時に作り、プログラムの終了まで使い回す）
+    // parallelFor()の仕事は番号の早い者勝ちで取り合うので、早く終わったスレッドが残りを引き受ける
+    // ＜注意＞ 仕事の受け渡しは1組しかないので、parallelFor()は呼び出し全体を排他にする（別のスレッドからの呼び出しは順番待ち）。
+    // 仕事の中からの呼び出し（入れ子）は、待ち合うと止まってしまうので、そのスレッドでそのまま順に実行する
+    class WorkerPool
+    {
+    public:
+        explicit WorkerPool(size_t workerCount)
+        {
+            for (size_t i = 0; i < workerCount; ++i)
+                mThreads.emplace_back([this, i] { isWorkerThread() = true; workerLoop(i); });
+        }
+
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mQuit = true;
+            }
+            mWake.notify_all();
+            for (auto& t : mThreads) t.join();
+        }
+
+        WorkerPool(const WorkerPool&)            = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        size_t workerCount() const { return mThreads.size(); }
+
+        // 0からcount - 1までのそれぞれについてjob(i)を呼び、すべて終わるまで待つ
+        // 呼び出し元のスレッドも加わり、補助スレッドはusedWorkers個まで使う
+        // 仕事の中から呼ばれたら、補助スレッドを使わずに順に実行する
+        void parallelFor(size_t count, size_t usedWorkers, const std::function<void(size_t)>& job)
+        {
+            if (usedWorkers == 0 || mThreads.empty() || count <= 1 || jobDepth() > 0) {
+                ++jobDepth();
+                for (size_t i = 0; i < count; ++i) job(i);
+                --jobDepth();
+                return;
+            }
+            // 補助スレッドは仕事の中でしか呼ばない（仕事の外で補助スレッドが呼ぶと、自分の終了を待って止まる）
+            assert(!isWorkerThread());
+
+            std::lock_guard<std::mutex> call(mCallMutex);
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mJob   = &job;
+                mCount = count;
+                mUsed  = std::min(usedWorkers, mThreads.size());
+                mDone  = 0;
+                mNext.store(0, std::memory_order_relaxed);
+                ++mGeneration;
+            }
+            mWake.notify_all();
+
+            runJob(job, count);
+
+            std::unique_lock<std::mutex> lock(mMutex);
+            mFinished.wait(lock, [this] { return mDone == mThreads.size(); });
+            mJob = nullptr;
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+            writtenPixels() += mWritten.exchange(0, std::memory_order_relaxed);  // 補助スレッドが書いた点の数を、呼び出し元へ移す
+#endif
+        }
+
+    private:
+        s3d::Array<std::thread>             mThreads;
+        std::mutex                          mCallMutex;  // parallelFor()の呼び出し全体の排他
+        std::mutex                          mMutex;
+        std::condition_variable             mWake;
+        std::condition_variable             mFinished;
+        const std::function<void(size_t)>*  mJob        = nullptr;
+        size_t                              mCount      = 0;
+        size_t                              mUsed       = 0;
+        size_t                              mDone       = 0;
+        size_t                              mGeneration = 0;
+        bool                                mQuit       = false;
+        std::atomic<size_t>                 mNext{ 0 };
+        std::atomic<s3d::int64>             mWritten{ 0 };  // 計測用。補助スレッドが書いた点の数（KOTSUBU_PIXEL_BOARD_STATS）
+
+        // 仕事を実行中のスレッドでの入れ子の深さ / 補助スレッドか（スレッドごと）
+        static size_t& jobDepth()
+        {
+            thread_local size_t depth = 0;
+            return depth;
+        }
+
+        static bool& isWorkerThread()
+        {
+            thread_local bool worker = false;
+            return worker;
+        }
+
+        void runJob(const std::function<void(size_t)>& job, size_t count)
+        {
+            ++jobDepth();
+            for (size_t i; (i = mNext.fetch_add(1, std::memory_order_relaxed)) < count; )
+                job(i);
+            --jobDepth();
+        }
+
+        // すべての補助スレッドが毎回の仕事に顔を出す（使わないスレッドはすぐ終了を報告する）
+        void workerLoop(size_t id)
+        {
+            size_t seen = 0;
+            std::unique_lock<std::mutex> lock(mMutex);
+            for (;;) {
+                mWake.wait(lock, [&] { return mQuit || mGeneration != seen; });
+                if (mQuit) return;
+                seen = mGeneration;
+
+                const std::function<void(size_t)>* job = mJob;
+                const size_t count = mCount;
+                const bool   use   = id < mUsed;
+                lock.unlock();
+                if (use) runJob(*job, count);
+#ifdef KOTSUBU_PIXEL_BOARD_STATS
+                mWritten.fetch_add(std::exchange(writtenPixels(), 0), std::memory_order_relaxed);
+#endif
+                lock.lock();
+
+                if (++mDone == mThreads.size()) mFinished.notify_one();
+            }
+        }
+    };
+
+
+
+    // 【内部関数】共有の補助スレッド（論理コア数 - 1 個）
+    inline WorkerPool& workerPool()
+    {
+        static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+
+
+    // 【内部型】タイルごとの振り分け結果（並べ替え後の線分の番号。番号順に並ぶ）
+    inline s3d::Array<s3d::Array<s3d::uint32>>& tileBins()
+    {
+        thread_local s3d::Array<s3d::Array<s3d::uint32>> bins;
+        return bins;
+    }
+
+
+
+    // 【内部関数】1行分のタイル（帯）に、線分を振り分ける
+    // 帯の範囲でクリップしたステップの範囲から、線分が通るxの範囲を求め、そこに掛かるタイルに入れる
+    template <class Surface>
+    inline void binBand(const s3d::Array<BatchEntry>& entries, const Surface& img, s3d::int32 band,
+                        s3d::int32 tilesX, s3d::Array<s3d::Array<s3d::uint32>>& bins)
+    {
+        const ClipRect bandClip{ 0, band * TileSize, img.width() - 1,
+                                 std::min((band + 1) * TileSize, img.height()) - 1 };
+        s3d::Array<s3d::uint32>* row = bins.data() + static_cast<size_t>(band) * tilesX;
+        for (s3d::int32 tx = 0; tx < tilesX; ++tx) row[tx].clear();
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const LineSetup& ls = entries[i].ls;
+
+            // 外接矩形が帯に掛からなければ飛ばす（疑似AAの点も外接矩形の中にある。Wuの点は縦に1ドットはみ出すことがある）
+            const s3d::int32 margin = entries[i].wu ? 1 : 0;
+            if (std::max(ls.startPos.y, ls.endPos.y) + margin < bandClip.top ||
+                std::min(ls.startPos.y, ls.endPos.y) - margin > bandClip.bottom) continue;
+
+            s3d::int32 lo, hi;
+            if (!clipXRange(ls, bandClip, lo, hi, entries[i].wu)) continue;
+
+            for (s3d::int32 tx = lo / TileSize; tx <= hi / TileSize; ++tx)
+                row[tx].push_back(static_cast<s3d::uint32>(i));
+        }
+    }
+
+
+
+    // 【内部関数】タイル(tx, ty)に書くときの書き込み先（s3d::ImageとKotsubuImage8はそのもの、疎なイメージはタイルの面）
+    template <class Surface>
+    inline Surface& tileSurface(Surface& img, s3d::int32, s3d::int32)
+    {
+        return img;
+    }
+
+    inline SparseTile tileSurface(KotsubuSparseImage& img, s3d::int32 tx, s3d::int32 ty)
+    {
+        static_assert(TileSize == KotsubuSparseImage::TileSize, "tile sizes must match");
+        return SparseTile{ img.tile(tx, ty), tx * TileSize, ty * TileSize };
+    }
+
+
+
+    // 【内部関数】タイルに分けた並列のレンダリング（renderLinesParallel()の本体）
+    // 書き込み先はs3d::Image、KotsubuImage8、KotsubuSparseImage（疎なイメージは、線分の掛かるタイルだけを割り当てる）
+    template <class Surface>
+    inline void drawLinesParallel(Surface& img, const LineSegment* segments, size_t count, size_t threadCount)
+    {
+        if (count == 0 || img.width() <= 0 || img.height() <= 0) return;
+
+        WorkerPool& pool = workerPool();
+        const size_t usedWorkers = std::min(pool.workerCount(), (threadCount == 0) ? pool.workerCount() : (threadCount - 1));
+
+        // 1スレッドだけなら、振り分けの無いrenderLines()で描く（結果は同じ）
+        if (usedWorkers == 0) {
+            drawLines(img, segments, count);
+            return;
+        }
+
+        // 前準備と、組ごとの並べ替え（renderLines()と同じ順番にする）
+        size_t bucketStart[BatchBucketCount + 1];
+        const s3d::Array<BatchEntry>& entries = prepareBatch(segments, count, bucketStart);
+
+        // 帯ごとに振り分ける（帯ごとに書き込み先のタイルが別なので、並列でもロックは要らない）
+        const s3d::int32 tilesX = (img.width()  + TileSize - 1) / TileSize;
+        const s3d::int32 tilesY = (img.height() + TileSize - 1) / TileSize;
+        s3d::Array<s3d::Array<s3d::uint32>>& bins = tileBins();
+        bins.resize(static_cast<size_t>(tilesX) * tilesY);
+        pool.parallelFor(tilesY, usedWorkers, [&](size_t band) {
+            binBand(entries, img, static_cast<s3d::int32>(band), tilesX, bins);
+        });
+
+        // 疎なイメージは、線分の掛かるタイルを先に1スレッドで割り当てておく（並列の間は読むだけになる）
+        if constexpr (std::is_same_v<Surface, KotsubuSparseImage>) {
+            for (size_t tile = 0; tile < bins.size(); ++tile)
+                if (!bins[tile].empty())
+                    img.tile(static_cast<s3d::int32>(tile % tilesX), static_cast<s3d::int32>(tile / tilesX));
+        }
+
+        // タイルごとに描く（タイルの範囲でクリップする）
+        pool.parallelFor(bins.size(), usedWorkers, [&](size_t tile) {
+            if (bins[tile].empty()) return;
+            const s3d::int32 tx = static_cast<s3d::int32>(tile % tilesX);
+            const s3d::int32 ty = static_cast<s3d::int32>(tile / tilesX);
+            const ClipRect clip{ tx * TileSize, ty * TileSize,
+                                 std::min((tx + 1) * TileSize, img.width())  - 1,
+                                 std::min((ty + 1) * TileSize, img.height()) - 1 };
+            auto&& surface = tileSurface(img, tx, ty);
+            using TileSurface = std::remove_reference_t<decltype(surface)>;
+            for (const s3d::uint32 i : bins[tile])
+                batchDrawTable<TileSurface>[entries[i].bucket](surface, entries[i], clip);
+        });
+    }
+}
+
+
+
+// 【関数】複数の線分を、タイルに分けて並列にレンダリング
+// 結果はrenderLines()とまったく同じ。threadCountは呼び出し元を含むスレッド数（0なら使えるだけ使う）
+// ＜注意＞ 線分が少ない、または短い場合は、振り分けの分だけrenderLines()より遅くなることがある
+inline void renderLinesParallel(s3d::Image& img, const LineSegment* segments, size_t count, size_t threadCount = 0)
+{
+    kotsubu_detail::drawLinesParallel(img, segments, count, threadCount);
+}
+
+inline void renderLinesParallel(s3d::Image& img, const s3d::Array<LineSegment>& segments, size_t threadCount = 0)
+{
+    renderLinesParallel(img, segments.data(), segments.size(), threadCount);
+}
+
+
+
+// 【関数】ボード版。レンダリングした範囲をボードに通知する（draw()で部分転送される）
+// 8bitの形式のボードでは、mImg8に色のアルファを値として書く。疎な記憶方式のボードでは、掛かるタイルにだけ書く
+inline void renderLinesParallel(KotsubuPixelBoard& board, const LineSegment* segments, size_t count,
+                                size_t threadCount = 0)
+{
+    KOTSUBU_BOARD_STATS_SCOPE(board, Render);
+    kotsubu_detail::withBoardImage(board, [&](auto& img) {
+        kotsubu_detail::drawLinesParallel(img, segments, count, threadCount);
+    });
+    for (size_t i = 0; i < count; ++i)
+        kotsubu_detail::markDirtySegment(board, segments[i].startPos, segments[i].endPos,
+                                         kotsubu_detail::isWuMode(segments[i].mode));
+}
+
+inline void renderLinesParallel(KotsubuPixelBoard& board, const s3d::Array<LineSegment>& segments,
+                                size_t threadCount = 0)
+{
+    renderLinesParallel(board, segments.data(), segments.size(), threadCount);
+}
@@ -0,0 +1,126 @@
+//
+//	kotsubu_gpu_line.frag
+//	KotsubuGpuLineRenderer（kotsubu_gpu_line_renderer.h）の線分を描くピクセルシェーダ
+//	Texture1 --- 線分表（1テクセルが32bitの1語。r, g, b, aの順に下位のバイトから。1本につき12語、1行に340本）
+//	頂点の色 --- r, gは線分の番号の下位12bitと上位、b, aは頂点の位置（ボードの座標。補間して点の位置にする）
+//	点が線分の点か疑似AAの点なら色を書き、そうでなければdiscardする（上書きでドローすること）。
+//	式はkotsubu_line_renderer.hの整数版と同じ（ステップkの移動回数は floor((e0 + k * eInc) / eMax)）
+//
+
+# version 410
+
+uniform sampler2D Texture1;
+
+layout(location = 0) in vec4 Color;
+layout(location = 1) in vec2 UV;
+
+layout(location = 0) out vec4 FragColor;
+
+const uint SegmentWords   = 12u;
+const uint SegmentsPerRow = 340u;
+const uint AlphaShift     = 16u;
+
+// 線分表の1語
+uint loadWord(uint index, uint word)
+{
+	vec4 texel = texelFetch(Texture1, ivec2((index % SegmentsPerRow) * SegmentWords + word, index / SegmentsPerRow), 0);
+	uvec4 b = uvec4(texel * 255.0 + 0.5);
+	return b.r | (b.g << 8) | (b.b << 16) | (b.a << 24);
+}
+
+// 64bitの整数（x: 下位32bit, y: 上位32bit）。32bit×32bitの積、32bitとの和、比較
+uvec2 mul64(uint a, uint b)
+{
+	uint aL = a & 0xFFFFu, aH = a >> 16, bL = b & 0xFFFFu, bH = b >> 16;
+	uint ll = aL * bL, lh = aL * bH, hl = aH * bL, hh = aH * bH;
+	uint mid = (ll >> 16) + (lh & 0xFFFFu) + (hl & 0xFFFFu);
+	return uvec2((ll & 0xFFFFu) | (mid << 16), hh + (lh >> 16) + (hl >> 16) + (mid >> 16));
+}
+
+uvec2 add64(uvec2 a, uint b)
+{
+	uint lo = a.x + b;
+	return uvec2(lo, a.y + ((lo < a.x) ? 1u : 0u));
+}
+
+bool less64(uvec2 a, uvec2 b)
+{
+	return (a.y < b.y) || ((a.y == b.y) && (a.x < b.x));
+}
+
+// ステップkまでの、もう一方の軸の移動回数。単精度で見積もってから、64bitの比較で直す（ずれは1以内）
+uint moves(uint k, uint e0, uint eInc, uint eMax)
+{
+	if (eMax == 0u) return 0u;
+	uvec2 total = add64(mul64(k, eInc), e0);
+	uint m = uint(max(floor((float(e0) + float(k) * float(eInc)) / float(eMax)), 0.0));
+	for (int i = 0; i < 3; ++i)
+	{
+		uvec2 lower = mul64(m, eMax);
+		if (less64(total, lower))						m -= 1u;
+		else if (!less64(total, add64(lower, eMax)))	m += 1u;
+	}
+	return m;
+}
+
+// 色の1語を、ストレートアルファの色にする
+vec4 unpackColor(uint bits)
+{
+	return vec4(float(bits & 0xFFu), float((bits >> 8) & 0xFFu), float((bits >> 16) & 0xFFu), float(bits >> 24)) / 255.0;
+}
+
+// 固定小数点のアルファを8bitにする（四捨五入） / 疑似AAの割合を掛けて8bitにする（四捨五入）
+uint fixedAlpha(uint alpha)
+{
+	return (alpha + (1u << (AlphaShift - 1u))) >> AlphaShift;
+}
+
+uint fixedAAAlpha(uint alpha, uint aaRate)
+{
+	return add64(mul64(alpha, aaRate), 0x80000000u).y;
+}
+
+void main()
+{
+	uint  index = uint(Color.r + 0.5) | (uint(Color.g + 0.5) << 12);
+	ivec2 pos   = ivec2(floor(Color.ba));
+
+	int  endMaj = int(loadWord(index, 0u));
+	int  endMin = int(loadWord(index, 1u));
+	uint flags  = loadWord(index, 2u);
+	uint last   = loadWord(index, 3u);
+	uint e0     = loadWord(index, 4u);
+	uint eInc   = loadWord(index, 5u);
+	uint eMax   = loadWord(index, 6u);
+	uint split  = loadWord(index, 7u);
+	uint col    = loadWord(index, 8u);
+	bool xMajor  = (flags & 1u) != 0u;
+	int  stepMaj = ((flags & 2u) != 0u) ? -1 : 1;
+	int  stepMin = ((flags & 4u) != 0u) ? -1 : 1;
+	uint mode    = (flags >> 4) & 3u;
+
+	// 基準軸の位置からステップを、ステップからその点の位置を求める
+	int k = ((xMajor ? pos.x : pos.y) - endMaj) * stepMaj;
+	if ((k < 0) || (uint(k) > last)) discard;
+	uint m = moves(uint(k), e0, eInc, eMax);
+	int  d = ((xMajor ? pos.y : pos.x) - (endMin + int(m) * stepMin)) * stepMin;
+
+	// 線分の点（分割点までは単色、その先は減衰）
+	uint alpha = (col >> 24) << AlphaShift;
+	uint fade  = loadWord(index, 10u);
+	if (d == 0)
+	{
+		if (uint(k) <= split) FragColor = unpackColor(col);
+		else                  FragColor = vec4(unpackColor(col).rgb, float(fixedAlpha(alpha - fade * (uint(k) - split))) / 255.0);
+		return;
+	}
+
+	// 疑似AAの点。ステップj - 1からjへ移るときの、移る前の行の次の点（d = -1）と、移った後の行の前の点（d = 1）
+	uint j = 0u;
+	if ((mode != 0u) && (d == -1) && (k >= 1) && (moves(uint(k - 1), e0, eInc, eMax) + 1u == m))				j = uint(k);
+	else if ((mode != 0u) && (d == 1) && (uint(k) < last) && (moves(uint(k + 1), e0, eInc, eMax) == m + 1u))	j = uint(k + 1);
+	else discard;
+
+	if (j <= split) FragColor = unpackColor(loadWord(index, 9u));
+	else            FragColor = vec4(unpackColor(col).rgb, float(fixedAAAlpha(alpha - fade * (j - split), loadWord(index, 11u))) / 255.0);
+}
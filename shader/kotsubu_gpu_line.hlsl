@@ -0,0 +1,129 @@
+//
+//	kotsubu_gpu_line.hlsl
+//	KotsubuGpuLineRenderer（kotsubu_gpu_line_renderer.h）の線分を描くピクセルシェーダ
+//	t1 --- 線分表（1テクセルが32bitの1語。r, g, b, aの順に下位のバイトから。1本につき12語、1行に340本）
+//	頂点の色 --- r, gは線分の番号の下位12bitと上位、b, aは頂点の位置（ボードの座標。補間して点の位置にする）
+//	点が線分の点か疑似AAの点なら色を返し、そうでなければdiscardする（上書きでドローすること）。
+//	式はkotsubu_line_renderer.hの整数版と同じ（ステップkの移動回数は floor((e0 + k * eInc) / eMax)）
+//
+
+Texture2D		g_texture1 : register(t1);
+
+namespace s3d
+{
+	struct PSInput
+	{
+		float4 position	: SV_POSITION;
+		float4 color	: COLOR0;
+		float2 uv		: TEXCOORD0;
+	};
+}
+
+static const uint SegmentWords   = 12;
+static const uint SegmentsPerRow = 340;
+static const uint AlphaShift     = 16;
+
+// 線分表の1語
+uint loadWord(uint index, uint word)
+{
+	const float4 texel = g_texture1.Load(int3((index % SegmentsPerRow) * SegmentWords + word, index / SegmentsPerRow, 0));
+	const uint4 b = (uint4)(texel * 255.0 + 0.5);
+	return b.r | (b.g << 8) | (b.b << 16) | (b.a << 24);
+}
+
+// 64bitの整数（x: 下位32bit, y: 上位32bit）。32bit×32bitの積、32bitとの和、比較
+uint2 mul64(uint a, uint b)
+{
+	const uint aL = a & 0xFFFF, aH = a >> 16, bL = b & 0xFFFF, bH = b >> 16;
+	const uint ll = aL * bL, lh = aL * bH, hl = aH * bL, hh = aH * bH;
+	const uint mid = (ll >> 16) + (lh & 0xFFFF) + (hl & 0xFFFF);
+	return uint2((ll & 0xFFFF) | (mid << 16), hh + (lh >> 16) + (hl >> 16) + (mid >> 16));
+}
+
+uint2 add64(uint2 a, uint b)
+{
+	const uint lo = a.x + b;
+	return uint2(lo, a.y + ((lo < a.x) ? 1 : 0));
+}
+
+bool less64(uint2 a, uint2 b)
+{
+	return (a.y < b.y) || ((a.y == b.y) && (a.x < b.x));
+}
+
+// ステップkまでの、もう一方の軸の移動回数。単精度で見積もってから、64bitの比較で直す（ずれは1以内）
+uint moves(uint k, uint e0, uint eInc, uint eMax)
+{
+	if (eMax == 0) return 0;
+	const uint2 total = add64(mul64(k, eInc), e0);
+	uint m = (uint)max(floor(((float)e0 + (float)k * (float)eInc) / (float)eMax), 0.0);
+	[unroll]
+	for (int i = 0; i < 3; ++i)
+	{
+		const uint2 lower = mul64(m, eMax);
+		if (less64(total, lower))					m -= 1;
+		else if (!less64(total, add64(lower, eMax)))	m += 1;
+	}
+	return m;
+}
+
+// 色の1語を、ストレートアルファの色にする
+float4 unpackColor(uint bits)
+{
+	return float4(bits & 0xFF, (bits >> 8) & 0xFF, (bits >> 16) & 0xFF, bits >> 24) / 255.0;
+}
+
+// 固定小数点のアルファを8bitにする（四捨五入） / 疑似AAの割合を掛けて8bitにする（四捨五入）
+uint fixedAlpha(uint alpha)
+{
+	return (alpha + (1u << (AlphaShift - 1))) >> AlphaShift;
+}
+
+uint fixedAAAlpha(uint alpha, uint aaRate)
+{
+	return add64(mul64(alpha, aaRate), 0x80000000).y;
+}
+
+float4 PS(s3d::PSInput input) : SV_TARGET
+{
+	const uint index = (uint)(input.color.r + 0.5) | ((uint)(input.color.g + 0.5) << 12);
+	const int2 pos   = (int2)floor(input.color.ba);
+
+	const int  endMaj = (int)loadWord(index, 0);
+	const int  endMin = (int)loadWord(index, 1);
+	const uint flags  = loadWord(index, 2);
+	const uint last   = loadWord(index, 3);
+	const uint e0     = loadWord(index, 4);
+	const uint eInc   = loadWord(index, 5);
+	const uint eMax   = loadWord(index, 6);
+	const uint split  = loadWord(index, 7);
+	const uint col    = loadWord(index, 8);
+	const bool xMajor  = (flags & 1) != 0;
+	const int  stepMaj = ((flags & 2) != 0) ? -1 : 1;
+	const int  stepMin = ((flags & 4) != 0) ? -1 : 1;
+	const uint mode    = (flags >> 4) & 3;
+
+	// 基準軸の位置からステップを、ステップからその点の位置を求める
+	const int k = ((xMajor ? pos.x : pos.y) - endMaj) * stepMaj;
+	if ((k < 0) || ((uint)k > last)) discard;
+	const uint m = moves(k, e0, eInc, eMax);
+	const int  d = ((xMajor ? pos.y : pos.x) - (endMin + (int)m * stepMin)) * stepMin;
+
+	// 線分の点（分割点までは単色、その先は減衰）
+	const uint alpha = (col >> 24) << AlphaShift;
+	const uint fade  = loadWord(index, 10);
+	if (d == 0)
+	{
+		if ((uint)k <= split) return unpackColor(col);
+		return float4(unpackColor(col).rgb, fixedAlpha(alpha - fade * ((uint)k - split)) / 255.0);
+	}
+
+	// 疑似AAの点。ステップj - 1からjへ移るときの、移る前の行の次の点（d = -1）と、移った後の行の前の点（d = 1）
+	uint j = 0;
+	if ((mode != 0) && (d == -1) && (k >= 1) && (moves(k - 1, e0, eInc, eMax) + 1 == m))					j = k;
+	else if ((mode != 0) && (d == 1) && ((uint)k < last) && (moves(k + 1, e0, eInc, eMax) == m + 1))	j = k + 1;
+	else discard;
+
+	if (j <= split) return unpackColor(loadWord(index, 9));
+	return float4(unpackColor(col).rgb, fixedAAAlpha(alpha - fade * (j - split), loadWord(index, 11)) / 255.0);
+}
@@ -0,0 +1,39 @@
+//
+//	kotsubu_image8.frag
+//	KotsubuPixelBoardの8bitの形式（Alpha8, Palette8）をドローするピクセルシェーダ
+//	Texture0 --- 4ドットずつ詰めたイメージ（1テクセルのr, g, b, aが横に並んだ4ドットの値）
+//	Texture1 --- 256x1のパレット（値の番号の色）
+//
+
+# version 410
+
+uniform sampler2D Texture0;
+uniform sampler2D Texture1;
+
+layout(location = 0) in vec4 Color;
+layout(location = 1) in vec2 UV;
+
+layout(location = 0) out vec4 FragColor;
+
+layout(std140) uniform PSConstants2D
+{
+	vec4 g_colorAdd;
+	vec4 g_sdfParam;
+	vec4 g_sdfOutlineColor;
+	vec4 g_sdfShadowColor;
+	vec4 g_internal;
+};
+
+void main()
+{
+	ivec2 size = textureSize(Texture0, 0);
+
+	// uvからドットの位置を求め、詰めたテクセルの中の1要素を取り出す
+	int x = min(int(UV.x * float(size.x * 4)), size.x * 4 - 1);
+	int y = min(int(UV.y * float(size.y)), size.y - 1);
+	vec4 texel = texelFetch(Texture0, ivec2(x / 4, y), 0);
+	int value = int(texel[x % 4] * 255.0 + 0.5);
+
+	vec4 color = texelFetch(Texture1, ivec2(value, 0), 0);
+	FragColor = (color * Color) + g_colorAdd;
+}
@@ -0,0 +1,44 @@
+//
+//	kotsubu_image8.hlsl
+//	KotsubuPixelBoardの8bitの形式（Alpha8, Palette8）をドローするピクセルシェーダ
+//	t0 --- 4ドットずつ詰めたイメージ（1テクセルのr, g, b, aが横に並んだ4ドットの値）
+//	t1 --- 256x1のパレット（値の番号の色）
+//
+
+Texture2D		g_texture0 : register(t0);
+Texture2D		g_texture1 : register(t1);
+SamplerState	g_sampler0 : register(s0);
+
+namespace s3d
+{
+	struct PSInput
+	{
+		float4 position	: SV_POSITION;
+		float4 color	: COLOR0;
+		float2 uv		: TEXCOORD0;
+	};
+}
+
+cbuffer PSConstants2D : register(b0)
+{
+	float4 g_colorAdd;
+	float4 g_sdfParam;
+	float4 g_sdfOutlineColor;
+	float4 g_sdfShadowColor;
+	float4 g_internal;
+}
+
+float4 PS(s3d::PSInput input) : SV_TARGET
+{
+	uint width, height;
+	g_texture0.GetDimensions(width, height);
+
+	// uvからドットの位置を求め、詰めたテクセルの中の1要素を取り出す
+	const uint x = min((uint)(input.uv.x * width * 4), width * 4 - 1);
+	const uint y = min((uint)(input.uv.y * height), height - 1);
+	const float4 texel = g_texture0.Load(int3(x / 4, y, 0));
+	const uint value = (uint)(texel[x % 4] * 255.0 + 0.5);
+
+	const float4 color = g_texture1.Load(int3(value, 0, 0));
+	return (color * input.color) + g_colorAdd;
+}